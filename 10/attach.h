@@ -0,0 +1,116 @@
+#ifndef ATTACH_H
+#define ATTACH_H
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "transport.h"
+#include "placement.h"
+
+// Подключение студента к экзамену. Все объекты синхронизации слотов teacher создаёт
+// при запуске, поэтому студенту остаётся открыть сегмент, отобразить его одним mmap
+// и получить каналы своего слота (register_slot): для unnamed/futex — ничего,
+// для named — открыть два семафора, для eventfd/pipe — одно подключение к teacher.
+// Отображение ленивое: студент трогает только заголовок, свой слот и свои объекты;
+// с --populate заранее загружаются только эти страницы, а не весь сегмент.
+
+struct ExamAttach {
+    SharedData *shm = nullptr;
+    size_t size = 0;
+    Transport *tr = nullptr;
+};
+
+enum AttachResult {
+    ATTACH_OK = 0,
+    ATTACH_NO_TEACHER,   // сегмента нет
+    ATTACH_FAILED,       // причина в errno
+    ATTACH_INCOMPATIBLE  // чужой сегмент или другая раскладка (segment_check)
+};
+
+// Заголовок сегмента size байт. Пустая строка — сегмент подходит этой сборке
+inline std::string segment_check(const SharedData *shm, size_t size) {
+    uint32_t magic = __atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE);
+    if (magic != SEGMENT_MAGIC) return "bad magic " + std::to_string(magic);
+    if (shm->version != SEGMENT_VERSION) {
+        return "segment version " + std::to_string(shm->version) + ", expected " + std::to_string(SEGMENT_VERSION);
+    }
+    if (shm->header_size != sizeof(SharedData) || shm->slot_size != sizeof(StudentSlot)) {
+        return "layout header=" + std::to_string(shm->header_size) + " slot=" + std::to_string(shm->slot_size)
+               + ", expected " + std::to_string(sizeof(SharedData)) + "/" + std::to_string(sizeof(StudentSlot));
+    }
+    if (shm->protocol != PROTO_V1 && shm->protocol != PROTO_V2) return "protocol " + std::to_string(shm->protocol);
+    if (shm->capacity <= 0 || shm->capacity > SLOT_MASK_BITS
+        || sizeof(SharedData) + (size_t)shm->capacity * sizeof(StudentSlot) > size || shm->sync_offset > size) {
+        return "segment of " + std::to_string(size) + " bytes is too small";
+    }
+    return "";
+}
+
+// Загрузить страницы, на которые попадает [addr, addr + len)
+inline void prefault_range(void *addr, size_t len) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t lo = (uintptr_t)addr & ~(page - 1);
+    prefault((void *)lo, (uintptr_t)addr + len - lo, page);
+}
+
+// why: причина ATTACH_INCOMPATIBLE
+inline AttachResult exam_attach(ExamAttach &a, bool populate, std::string *why = nullptr) {
+    int fd = shm_open(exam_name(SHM_NAME).c_str(), O_RDWR, 0666);
+    // teacher --huge кладёт сегмент в hugetlbfs
+    if (fd < 0) fd = open(exam_name(HUGE_SHM_PATH).c_str(), O_RDWR);
+    if (fd < 0) return ATTACH_NO_TEACHER;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return ATTACH_FAILED;
+    }
+    if ((size_t)st.st_size < sizeof(SharedData)) {
+        close(fd);
+        errno = EINVAL;
+        return ATTACH_FAILED;
+    }
+    a.size = st.st_size;
+    void *p = mmap(nullptr, a.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return ATTACH_FAILED;
+    a.shm = (SharedData *)p;
+    if (populate) prefault_range(a.shm, sizeof(SharedData));
+
+    // сегмент только что создан (magic == 0): teacher ещё инициализирует его
+    for (int i = 0; i < 100 && __atomic_load_n(&a.shm->magic, __ATOMIC_ACQUIRE) == 0; ++i) usleep(10000);
+    std::string bad = segment_check(a.shm, a.size);
+    if (!bad.empty()) {
+        if (why) *why = bad;
+        return ATTACH_INCOMPATIBLE;
+    }
+
+    // транспорт выбирает teacher; его объекты лежат по смещению sync_offset
+    a.tr = make_transport(a.shm->transport);
+    if (!a.tr || a.shm->sync_offset > a.size) {
+        errno = EINVAL;
+        return ATTACH_FAILED;
+    }
+    if (!a.tr->attach(a.shm, (char *)a.shm + a.shm->sync_offset)) return ATTACH_FAILED;
+    return ATTACH_OK;
+}
+
+// Слот уже RESERVED: получить его каналы
+inline bool exam_attach_slot(ExamAttach &a, int slot, bool populate) {
+    if (!a.tr->register_slot(slot)) return false;
+    if (populate) prefault_range(&a.shm->slots[slot], sizeof(StudentSlot));
+    return true;
+}
+
+inline void exam_detach(ExamAttach &a) {
+    if (a.tr) { a.tr->detach(); delete a.tr; a.tr = nullptr; }
+    if (a.shm) { munmap(a.shm, a.size); a.shm = nullptr; }
+}
+
+#endif // ATTACH_H
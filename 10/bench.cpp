@@ -0,0 +1,2168 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <csignal>
+#include <cerrno>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/statvfs.h>
+#include <map>
+#include <set>
+#include <dirent.h>
+#include <linux/perf_event.h>
+
+#include "common.h"
+#include "segment_log.h"
+#include "sock_proto.h"
+#include "transport.h"
+#include "slot_table.h"
+#include "placement.h"
+#include "attach.h"
+#include "trace.h"
+#include "reclaim.h"
+
+using namespace std;
+
+// Замеры для режимов из 10/. Запускается из каталога, где собраны teacher/student/observer.
+
+static const char *BENCH_OUT = "/tmp/exam_bench_observer.out";
+static const char *BENCH_SEG_DIR = "/tmp/exam_bench_segments";
+
+double now_sec() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double percentile(vector<double> &v, double p) {
+    if (v.empty()) return 0;
+    sort(v.begin(), v.end());
+    size_t i = (size_t)(p * (v.size() - 1));
+    return v[i];
+}
+
+double cpu_seconds(const rusage &ru) {
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6
+         + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+off_t file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : 0;
+}
+
+// Запускает ./observer с stdout в BENCH_OUT, прогоняет через FIFO `mb` мегабайт строк лога
+// и возвращает процессорное время наблюдателя (user + sys).
+double observer_cpu(bool splice_mode, int mb) {
+    unlink(BENCH_OUT);
+
+    pid_t child = fork();
+    if (child == 0) {
+        int out = open(BENCH_OUT, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(out, STDOUT_FILENO);
+        close(out);
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDERR_FILENO);
+        if (splice_mode) execl("./observer", "observer", "--splice", (char *)nullptr);
+        else execl("./observer", "observer", (char *)nullptr);
+        _exit(127);
+    }
+
+    // ждём, пока наблюдатель откроет FIFO на чтение
+    int fd = -1;
+    for (int i = 0; i < 100 && fd < 0; ++i) {
+        fd = open(FIFO_NAME, O_WRONLY | O_NONBLOCK);
+        if (fd < 0) usleep(20000);
+    }
+    if (fd < 0) {
+        perror("open fifo");
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, 0);
+
+    // строки того же вида и размера, что пишет teacher
+    char line[64];
+    int len = snprintf(line, sizeof(line), "[TEACHER] Checking PID=%d ticket=%d\n", 123456, 42);
+    off_t total = (off_t)mb * 1024 * 1024;
+    off_t written = 0;
+    while (written < total) {
+        ssize_t w = write(fd, line, len);
+        if (w <= 0) break;
+        written += w;
+    }
+    close(fd);
+
+    // наблюдатель дописывает остаток; в copy-режиме вывод больше входа из-за префиксов
+    for (int i = 0; i < 500 && file_size(BENCH_OUT) < written; ++i) usleep(10000);
+
+    kill(child, SIGINT);
+    int status = 0;
+    rusage ru{};
+    wait4(child, &status, 0, &ru);
+    unlink(BENCH_OUT);
+    return cpu_seconds(ru);
+}
+
+int bench_observer(int mb) {
+    if (mkfifo(FIFO_NAME, 0666) == -1 && errno != EEXIST) {
+        perror("mkfifo");
+        return 1;
+    }
+
+    printf("%-8s %10s %12s\n", "mode", "cpu_s", "cpu_ms/MB");
+    const char *names[] = {"copy", "splice"};
+    for (int m = 0; m < 2; ++m) {
+        double cpu = observer_cpu(m == 1, mb);
+        if (cpu < 0) return 1;
+        printf("%-8s %10.3f %12.3f\n", names[m], cpu, cpu * 1000.0 / mb);
+    }
+    return 0;
+}
+
+void remove_segments(const string &dir) {
+    for (uint64_t seq : seg_list(dir)) unlink(seg_path(dir, seq).c_str());
+    rmdir(dir.c_str());
+}
+
+// Запись `mb` мегабайт строк от `students` разных pid в сегменты и поиск истории случайных pid
+int bench_segments(int mb, int students) {
+    remove_segments(BENCH_SEG_DIR);
+    SegmentWriter w;
+    if (!w.open_dir(BENCH_SEG_DIR, SEG_DEFAULT_SIZE)) return 1;
+
+    srand(42);
+    char line[96];
+    uint64_t total = (uint64_t)mb << 20, bytes = 0, records = 0;
+    int64_t ts = seg_now_ns();
+    double t0 = now_sec();
+    while (bytes < total) {
+        int pid = 100000 + rand() % students;
+        int len = snprintf(line, sizeof(line), "[STUDENT %d] Received grade: %d", pid, 3 + rand() % 3);
+        if (!w.append(ts++, pid, line, len)) return 1;
+        bytes += len;
+        records++;
+    }
+    w.close_all();
+    double write_s = now_sec() - t0;
+
+    printf("write: %llu records, %.1f MB in %.3f s -> %.1f MB/s, %.2f M rec/s, %zu segments\n",
+           (unsigned long long)records, bytes / 1048576.0, write_s,
+           bytes / 1048576.0 / write_s, records / write_s / 1e6, seg_list(BENCH_SEG_DIR).size());
+
+    vector<double> lat;
+    size_t found = 0;
+    for (int i = 0; i < 200; ++i) {
+        vector<SegHit> hits;
+        double q0 = now_sec();
+        seg_query_pid(BENCH_SEG_DIR, 100000 + rand() % students, hits);
+        lat.push_back((now_sec() - q0) * 1e3);
+        found += hits.size();
+    }
+    printf("pid lookup: avg %.1f records, p50 %.3f ms, p99 %.3f ms\n",
+           (double)found / lat.size(), percentile(lat, 0.5), percentile(lat, 0.99));
+
+    lat.clear();
+    for (int i = 0; i < 200; ++i) {
+        vector<SegHit> hits;
+        // случайная точка внутри записанного интервала: ts росли на 1 нс на запись
+        int64_t from = ts - (int64_t)(rand() % records) - 1;
+        double q0 = now_sec();
+        seg_query_time(BENCH_SEG_DIR, from, from + 1000, hits);
+        lat.push_back((now_sec() - q0) * 1e3);
+    }
+    printf("time range (1000 records): p50 %.3f ms, p99 %.3f ms\n", percentile(lat, 0.5), percentile(lat, 0.99));
+
+    remove_segments(BENCH_SEG_DIR);
+    return 0;
+}
+
+// Запускает программу с stdout/stderr в /dev/null (или stdout в файл out)
+pid_t spawn(const vector<string> &args, const char *out = nullptr) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        int out_fd = out ? open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644) : null_fd;
+        dup2(out_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        vector<char *> argv;
+        for (const string &a : args) argv.push_back(const_cast<char *>(a.c_str()));
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+void stop(pid_t pid, rusage *ru = nullptr) {
+    kill(pid, SIGINT);
+    wait4(pid, nullptr, 0, ru);
+}
+
+void raise_fd_limit() {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+// Результат прогона: время жизни каждого студента (от fork до завершения) и общее время
+struct RunStats {
+    vector<double> lat_ms;
+    double total_s = 0;
+};
+
+// Преподаватель + n процессов-студентов, время подготовки и проверки нулевое
+RunStats run_processes(const vector<string> &teacher, const vector<string> &student, int n,
+                       const char *teacher_out = nullptr, rusage *teacher_ru = nullptr) {
+    RunStats st;
+    pid_t t = spawn(teacher, teacher_out);
+    usleep(300000);
+
+    map<pid_t, double> started;
+    double t0 = now_sec();
+    for (int i = 0; i < n; ++i) started[spawn(student)] = now_sec();
+    while (!started.empty()) {
+        pid_t p = waitpid(-1, nullptr, 0);
+        if (p < 0) break;
+        auto it = started.find(p);
+        if (it == started.end()) continue;
+        st.lat_ms.push_back((now_sec() - it->second) * 1e3);
+        started.erase(it);
+    }
+    st.total_s = now_sec() - t0;
+    stop(t, teacher_ru);
+    return st;
+}
+
+// Один процесс держит n соединений: все регистрируются сразу, затем ждут оценку.
+// Задержка — от отправки REGISTER до получения GRADE (включает ожидание в очереди).
+RunStats run_connections(const SockAddr &a, int n, int &rejected) {
+    RunStats st;
+    rejected = 0;
+    vector<int> fds;
+    for (int i = 0; i < n; ++i) {
+        int fd = sock_connect(a);
+        if (fd < 0) {
+            perror("connect");
+            break;
+        }
+        fds.push_back(fd);
+    }
+
+    int ep = epoll_create1(0);
+    vector<double> sent(fds.size());
+    double t0 = now_sec();
+    for (size_t i = 0; i < fds.size(); ++i) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u32 = (uint32_t)i;
+        epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev);
+        sent[i] = now_sec();
+        sock_send(fds[i], make_msg(MSG_REGISTER, 1000000 + (int)i, 1 + (int)i % 100));
+    }
+
+    size_t done = 0;
+    epoll_event events[256];
+    while (done < fds.size()) {
+        int k = epoll_wait(ep, events, 256, 10000);
+        if (k <= 0) break;
+        for (int j = 0; j < k; ++j) {
+            uint32_t i = events[j].data.u32;
+            Msg m;
+            if (sock_recv(fds[i], m) && m.type == MSG_GRADE) {
+                st.lat_ms.push_back((now_sec() - sent[i]) * 1e3);
+                sock_send(fds[i], make_msg(MSG_ACK));
+            } else {
+                rejected++;
+            }
+            epoll_ctl(ep, EPOLL_CTL_DEL, fds[i], nullptr);
+            close(fds[i]);
+            done++;
+        }
+    }
+    st.total_s = now_sec() - t0;
+    close(ep);
+    return st;
+}
+
+void print_stats(const char *name, int n, RunStats &st) {
+    printf("%-22s %7d %10.1f %10.3f %10.3f\n", name, n,
+           st.total_s > 0 ? st.lat_ms.size() / st.total_s : 0.0,
+           percentile(st.lat_ms, 0.5), percentile(st.lat_ms, 0.99));
+}
+
+// Сравнение разделяемой памяти и сокетов: n процессов-студентов на каждый транспорт,
+// затем conns одновременных соединений из одного процесса
+int bench_socket(int n, int conns) {
+    raise_fd_limit();
+    string ns = to_string(n), cs = to_string(conns);
+
+    printf("%-22s %7s %10s %10s %10s\n", "path", "n", "students/s", "p50_ms", "p99_ms");
+
+    RunStats shm = run_processes({"./teacher", to_string(min(n, 1024)), "--grade-ms", "0"},
+                                 {"./student", "--prep-ms", "0"}, n);
+    print_stats("shm processes", n, shm);
+
+    RunStats un = run_processes({"./sock_teacher", ns, "--unix", "--grade-ms", "0"},
+                                {"./sock_student", "--unix", "--prep-ms", "0"}, n);
+    print_stats("unix processes", n, un);
+
+    RunStats tcp = run_processes({"./sock_teacher", ns, "--tcp", "--grade-ms", "0"},
+                                 {"./sock_student", "--tcp", "--prep-ms", "0"}, n);
+    print_stats("tcp processes", n, tcp);
+
+    int rejected = 0;
+    pid_t t = spawn({"./sock_teacher", cs, "--unix", "--grade-ms", "0"});
+    usleep(300000);
+    RunStats uc = run_connections(sock_addr_unix(SOCK_PATH), conns, rejected);
+    stop(t);
+    print_stats("unix connections", conns, uc);
+    if (rejected) printf("  rejected/failed: %d\n", rejected);
+
+    t = spawn({"./sock_teacher", cs, "--tcp", "--grade-ms", "0"});
+    usleep(300000);
+    RunStats tc = run_connections(sock_addr_tcp(SOCK_PORT), conns, rejected);
+    stop(t);
+    print_stats("tcp connections", conns, tc);
+    if (rejected) printf("  rejected/failed: %d\n", rejected);
+    return 0;
+}
+
+// teacher --loop uring|epoll: n студентов, затем статистика системных вызовов из лога teacher
+int bench_loop(int n) {
+    const char *out = "/tmp/exam_bench_teacher.out";
+    printf("%-10s %7s %10s %s\n", "backend", "n", "students/s", "teacher stats");
+    for (const char *be : {"uring", "epoll"}) {
+        pid_t t = spawn({"./teacher", to_string(min(n, 1024)), "--grade-ms", "0", "--loop", be}, out);
+        usleep(300000);
+
+        double t0 = now_sec();
+        vector<pid_t> students;
+        for (int i = 0; i < n; ++i) students.push_back(spawn({"./student", "--prep-ms", "0"}));
+        for (pid_t p : students) waitpid(p, nullptr, 0);
+        double total = now_sec() - t0;
+        stop(t);
+
+        string stats = "-";
+        FILE *f = fopen(out, "r");
+        char line[256];
+        while (f && fgets(line, sizeof(line), f)) {
+            const char *p = strstr(line, "Loop stats: ");
+            if (p) {
+                stats = p + strlen("Loop stats: ");
+                if (!stats.empty() && stats.back() == '\n') stats.pop_back();
+            }
+        }
+        if (f) fclose(f);
+        printf("%-10s %7d %10.1f %s\n", be, n, n / total, stats.c_str());
+    }
+    unlink(out);
+    return 0;
+}
+
+// Транспорты teacher <-> student: ping-pong grade/ack между двумя процессами,
+// поток post_queue -> wait_queue, стоимость lock/unlock без конкуренции
+// и полный прогон teacher + n студентов на каждом транспорте
+int bench_transport(int n, int rounds) {
+    printf("%-8s %10s %10s %12s %10s %11s\n", "backend", "rtt_p50_us", "rtt_p99_us", "queue_ops/s", "lock_ns",
+           "students/s");
+    for (int kind = 0; kind < TR_COUNT; ++kind) {
+        Transport *tr = make_transport(kind);
+        size_t off = (sizeof(SharedData) + sizeof(StudentSlot) + 63) & ~(size_t)63;
+        size_t size = off + tr->area_size(1);
+        SharedData *shm = (SharedData *)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (shm == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        shm->capacity = 1;
+        if (!tr->create(shm, (char *)shm + off, 1) || !tr->register_slot(0) || !tr->open_slot(0)) {
+            perror(tr->name());
+            return 1;
+        }
+
+        // дочерний процесс наследует все объекты: и семафоры, и дескрипторы
+        pid_t child = fork();
+        if (child == 0) {
+            for (int i = 0; i < rounds; ++i) {
+                tr->wait_grade(0, -1);
+                tr->post_ack(0);
+            }
+            for (int i = 0; i < rounds; ++i) tr->post_queue();
+            _exit(0);
+        }
+
+        vector<double> rtt;
+        rtt.reserve(rounds);
+        for (int i = 0; i < rounds; ++i) {
+            double t0 = now_sec();
+            tr->post_grade(0);
+            while (tr->wait_ack(0) != 1) {}
+            rtt.push_back((now_sec() - t0) * 1e6);
+        }
+        double q0 = now_sec();
+        for (int i = 0; i < rounds; ++i) {
+            while (tr->wait_queue() != 1) {}
+        }
+        double queue_ops = rounds / (now_sec() - q0);
+        waitpid(child, nullptr, 0);
+
+        double l0 = now_sec();
+        for (int i = 0; i < rounds; ++i) {
+            tr->lock();
+            tr->unlock();
+        }
+        double lock_ns = (now_sec() - l0) * 1e9 / rounds;
+
+        tr->destroy();
+        delete tr;
+        munmap(shm, size);
+
+        RunStats run = run_processes({"./teacher", to_string(min(n, 1024)), "--grade-ms", "0",
+                                      "--transport", TRANSPORT_NAMES[kind]},
+                                     {"./student", "--prep-ms", "0"}, n);
+        printf("%-8s %10.2f %10.2f %12.0f %10.0f %11.1f\n", TRANSPORT_NAMES[kind],
+               percentile(rtt, 0.5), percentile(rtt, 0.99), queue_ops, lock_ns,
+               run.total_s > 0 ? run.lat_ms.size() / run.total_s : 0.0);
+    }
+    return 0;
+}
+
+// futex-транспорт, ping-pong grade/ack при разных бюджетах опроса перед futex.
+// spun/blocked — доля ожиданий, закончившихся опросом, у teacher (ack) и студента (grade)
+int bench_spin(int rounds) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("online CPUs: %ld%s\n", cpus, cpus < 2 ? " (spinning cannot help: the partner needs the same CPU)" : "");
+    printf("%-10s %10s %10s %10s %12s %12s\n", "spin", "rtt_p50_us", "rtt_p99_us", "rtt_avg_us", "ack_spun_%",
+           "grade_spun_%");
+    const pair<const char *, int> modes[] = {{"0", 0}, {"100", 100}, {"1000", 1000}, {"adaptive", SPIN_ADAPTIVE}};
+    for (auto &m : modes) {
+        FutexTransport tr;
+        size_t off = (sizeof(SharedData) + sizeof(StudentSlot) + 63) & ~(size_t)63;
+        size_t size = off + tr.area_size(1) + sizeof(uint64_t) * 2;
+        SharedData *shm = (SharedData *)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (shm == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        shm->capacity = 1;
+        shm->spin = m.second;
+        tr.create(shm, (char *)shm + off, 1);
+        uint64_t *child_stats = (uint64_t *)((char *)shm + off + tr.area_size(1));
+
+        pid_t child = fork();
+        if (child == 0) {
+            for (int i = 0; i < rounds; ++i) {
+                tr.wait_grade(0, -1);
+                tr.post_ack(0);
+            }
+            child_stats[0] = tr.grade_spin.spun;
+            child_stats[1] = tr.grade_spin.blocked;
+            _exit(0);
+        }
+
+        vector<double> rtt;
+        rtt.reserve(rounds);
+        double sum = 0;
+        for (int i = 0; i < rounds; ++i) {
+            double t0 = now_sec();
+            tr.post_grade(0);
+            while (tr.wait_ack(0) != 1) {}
+            rtt.push_back((now_sec() - t0) * 1e6);
+            sum += rtt.back();
+        }
+        waitpid(child, nullptr, 0);
+
+        auto pct = [](uint64_t a, uint64_t b) { return a + b ? 100.0 * a / (a + b) : 0.0; };
+        printf("%-10s %10.2f %10.2f %10.2f %12.1f %12.1f\n", m.first, percentile(rtt, 0.5), percentile(rtt, 0.99),
+               sum / rounds, pct(tr.ack_spin.spun, tr.ack_spin.blocked), pct(child_stats[0], child_stats[1]));
+        munmap(shm, size);
+    }
+    return 0;
+}
+
+// Счётчик промахов dTLB (чтение) своего процесса; -1, если perf_event недоступен
+int open_dtlb_counter() {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+long minor_faults() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_minflt;
+}
+
+enum PlacementKind { PL_ANON_4K, PL_ANON_POPULATE, PL_ANON_THP, PL_HUGETLB, PL_SHM, PL_SHM_POPULATE };
+
+// Отобразить mb мегабайт указанным способом; size — фактический размер
+void *placement_map(PlacementKind k, size_t &size) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void *p = MAP_FAILED;
+    switch (k) {
+        case PL_ANON_4K:
+            p = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if (p != MAP_FAILED) madvise(p, size, MADV_NOHUGEPAGE);
+            break;
+        case PL_ANON_POPULATE:
+            p = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, size, MADV_NOHUGEPAGE);
+                prefault(p, size, 4096);
+            }
+            break;
+        case PL_ANON_THP:
+            // выравнивание на 2 МБ, иначе THP достанется не всем страницам
+            size = round_huge(size);
+            p = mmap(nullptr, size + HUGE_PAGE, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if (p != MAP_FAILED) {
+                char *a = (char *)round_huge((size_t)p);
+                if (a > (char *)p) munmap(p, a - (char *)p);
+                munmap(a + size, (char *)p + HUGE_PAGE - a);
+                p = a;
+                madvise(p, size, MADV_HUGEPAGE);
+            }
+            break;
+        case PL_HUGETLB:
+            size = round_huge(size);
+            p = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            break;
+        case PL_SHM:
+        case PL_SHM_POPULATE: {
+            const char *name = "/exam_bench_placement";
+            int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0600);
+            if (fd < 0) return nullptr;
+            shm_unlink(name);
+            if (ftruncate(fd, size) == 0) {
+                p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | (k == PL_SHM_POPULATE ? MAP_POPULATE : 0), fd, 0);
+            }
+            close(fd);
+            break;
+        }
+    }
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+// Сегмент с разной подложкой: время отображения (с MAP_POPULATE — вместе с page faults),
+// первый проход по страницам, затем случайный обход страниц по цепочке (латентность
+// зависимого чтения, включая промахи TLB)
+int bench_placement(int mb, long steps) {
+    static const char *names[] = {"4k lazy", "4k populate", "thp madvise", "hugetlb", "shm lazy", "shm populate"};
+    printf("THP enabled=%s shmem_enabled=%s\n", sysfs_choice("/sys/kernel/mm/transparent_hugepage/enabled").c_str(),
+           sysfs_choice("/sys/kernel/mm/transparent_hugepage/shmem_enabled").c_str());
+    int dtlb = open_dtlb_counter();
+    if (dtlb < 0) printf("dTLB counter unavailable (perf_event_open: %s)\n", strerror(errno));
+    printf("%-13s %9s %9s %9s %11s %10s %12s\n", "backing", "map_ms", "touch_ms", "faults", "chase_ns", "p99_ns",
+           "dtlb_miss/op");
+
+    for (int k = PL_ANON_4K; k <= PL_SHM_POPULATE; ++k) {
+        size_t size = (size_t)mb << 20;
+        double t0 = now_sec();
+        long f0 = minor_faults();
+        char *base = (char *)placement_map((PlacementKind)k, size);
+        double map_ms = (now_sec() - t0) * 1e3;
+        if (!base) {
+            printf("%-13s unavailable (%s)\n", names[k], strerror(errno));
+            continue;
+        }
+
+        // первый проход: записать в каждую страницу номер следующей (цикл Саттоло)
+        size_t pages = size / 4096;
+        vector<uint32_t> next(pages);
+        for (size_t i = 0; i < pages; ++i) next[i] = (uint32_t)i;
+        srand(1);
+        for (size_t i = pages - 1; i > 0; --i) swap(next[i], next[(size_t)rand() % i]);
+        double t1 = now_sec();
+        for (size_t i = 0; i < pages; ++i) *(uint32_t *)(base + i * 4096 + (i % 64) * 64) = next[i];
+        double touch_ms = (now_sec() - t1) * 1e3;
+        long faults = minor_faults() - f0;
+
+        if (dtlb >= 0) {
+            ioctl(dtlb, PERF_EVENT_IOC_RESET, 0);
+            ioctl(dtlb, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        vector<double> lat;
+        uint32_t cur = 0;
+        const long batch = 1000;
+        for (long b = 0; b < steps / batch; ++b) {
+            double s0 = now_sec();
+            for (long i = 0; i < batch; ++i) cur = *(volatile uint32_t *)(base + (size_t)cur * 4096 + (cur % 64) * 64);
+            lat.push_back((now_sec() - s0) * 1e9 / batch);
+        }
+        long long misses = -1;
+        if (dtlb >= 0) {
+            ioctl(dtlb, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(dtlb, &misses, sizeof(misses)) != sizeof(misses)) misses = -1;
+        }
+        double avg = 0;
+        for (double v : lat) avg += v;
+        avg /= lat.empty() ? 1 : lat.size();
+
+        char miss_s[32] = "-";
+        if (misses >= 0) snprintf(miss_s, sizeof(miss_s), "%.3f", (double)misses / (steps / batch * batch));
+        printf("%-13s %9.2f %9.2f %9ld %11.1f %10.1f %12s\n", names[k], map_ms, touch_ms, faults, avg,
+               percentile(lat, 0.99), miss_s);
+        munmap(base, size);
+    }
+    if (dtlb >= 0) close(dtlb);
+    return 0;
+}
+
+// Несколько экзаменов одновременно (--exam bench<k>): n студентов на экзамен,
+// суммарная пропускная способность при росте числа экзаменов
+int bench_exams(int n, int max_exams) {
+    printf("%-6s %9s %10s %10s %10s\n", "exams", "students", "students/s", "p50_ms", "p99_ms");
+    for (int e = 1; e <= max_exams; e *= 2) {
+        vector<pid_t> teachers;
+        for (int k = 0; k < e; ++k) {
+            teachers.push_back(spawn({"./teacher", "64", "--grade-ms", "0", "--transport", "futex",
+                                      "--exam", "bench" + to_string(k)}));
+        }
+        usleep(300000 + 10000 * e);
+
+        map<pid_t, double> started;
+        RunStats st;
+        double t0 = now_sec();
+        for (int i = 0; i < n * e; ++i) {
+            started[spawn({"./student", "--prep-ms", "0", "--exam", "bench" + to_string(i % e)})] = now_sec();
+        }
+        while (!started.empty()) {
+            pid_t p = waitpid(-1, nullptr, 0);
+            if (p < 0) break;
+            auto it = started.find(p);
+            if (it == started.end()) continue;
+            st.lat_ms.push_back((now_sec() - it->second) * 1e3);
+            started.erase(it);
+        }
+        st.total_s = now_sec() - t0;
+        for (pid_t t : teachers) stop(t);
+        printf("%-6d %9d %10.1f %10.3f %10.3f\n", e, n * e, st.lat_ms.size() / st.total_s,
+               percentile(st.lat_ms, 0.5), percentile(st.lat_ms, 0.99));
+    }
+    return 0;
+}
+
+// teacher --rooms M: n студентов при проверке grade_ms; сводка по комнатам из лога teacher
+int bench_rooms(int n, int max_rooms, int grade_ms) {
+    const char *out = "/tmp/exam_bench_rooms.out";
+    printf("%-6s %-6s %10s %10s  %s\n", "rooms", "route", "students/s", "p99_ms", "per room graded/stolen");
+    for (const char *route : {"hash", "fill"}) {
+        for (int m = 1; m <= max_rooms; m *= 2) {
+            vector<string> args = {"./teacher", "256", "--grade-ms", to_string(grade_ms), "--rooms", to_string(m),
+                                   "--route", route};
+            pid_t t = spawn(args, out);
+            usleep(300000);
+            map<pid_t, double> started;
+            vector<double> lat;
+            double t0 = now_sec();
+            for (int i = 0; i < n; ++i) started[spawn({"./student", "--prep-ms", "0"})] = now_sec();
+            while (!started.empty()) {
+                pid_t p = waitpid(-1, nullptr, 0);
+                if (p < 0) break;
+                auto it = started.find(p);
+                if (it == started.end()) continue;
+                lat.push_back((now_sec() - it->second) * 1e3);
+                started.erase(it);
+            }
+            double total = now_sec() - t0;
+            stop(t);
+
+            string rooms;
+            FILE *f = fopen(out, "r");
+            char line[256];
+            while (f && fgets(line, sizeof(line), f)) {
+                int k;
+                unsigned long long g, st;
+                const char *p = strstr(line, "Room stats: room=");
+                if (p && sscanf(p, "Room stats: room=%d graded=%llu stolen=%llu", &k, &g, &st) == 3) {
+                    rooms += " " + to_string(g) + "/" + to_string(st);
+                }
+            }
+            if (f) fclose(f);
+            printf("%-6d %-6s %10.1f %10.1f %s\n", m, route, n / total, percentile(lat, 0.99), rooms.c_str());
+        }
+    }
+    unlink(out);
+    return 0;
+}
+
+// Один цикл регистрации студента: занять свободный слот, забрать его как teacher, освободить
+template <class SlotsT>
+__attribute__((noinline)) double slot_cycle_ns(SharedData *shm, int rounds) {
+    double t0 = now_sec();
+    for (int r = 0; r < rounds; ++r) {
+        int i = SlotsT::reserve(shm);
+        SlotsT::publish(shm, i);
+        int j = SlotsT::take_waiting(shm);
+        SlotsT::release(shm, j);
+    }
+    return (now_sec() - t0) * 1e9 / rounds;
+}
+
+template <int Capacity>
+void slot_cycle_row(int rounds) {
+    size_t size = sizeof(SharedData) + Capacity * sizeof(StudentSlot);
+    SharedData *shm = (SharedData *)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED) {
+        perror("slot table");
+        return;
+    }
+    shm->capacity = Capacity;
+    slot_table_init(shm, Capacity);
+    // худший случай для обхода: занято всё, кроме последнего слота
+    for (int i = 0; i < Capacity - 1; ++i) {
+        Slots<Capacity>::publish(shm, Slots<Capacity>::reserve(shm));
+        Slots<Capacity>::take_waiting(shm);
+    }
+    double generic = slot_cycle_ns<GenericSlots>(shm, rounds);
+    double special = slot_cycle_ns<Slots<Capacity>>(shm, rounds);
+    printf("%9d %11.1f %11.1f %8.2fx\n", Capacity, generic, special, generic / special);
+    munmap(shm, size);
+}
+
+// Специализированный teacher (битовые маски constexpr-размера) против --generic:
+// цикл слота в одном процессе и полный прогон n студентов
+int bench_policy(int n, int rounds) {
+    printf("%9s %11s %11s %9s\n", "capacity", "generic_ns", "special_ns", "speedup");
+    slot_cycle_row<64>(rounds);
+    slot_cycle_row<1024>(rounds);
+
+    printf("\n%-22s %7s %10s %10s %10s\n", "teacher", "n", "students/s", "p50_ms", "p99_ms");
+    for (const char *t : {"unnamed", "futex"}) {
+        for (bool generic : {true, false}) {
+            vector<string> args = {"./teacher", to_string(min(n, SLOT_MASK_BITS)), "--grade-ms", "0", "--transport", t};
+            if (generic) args.push_back("--generic");
+            RunStats st = run_processes(args, {"./student", "--prep-ms", "0"}, n);
+            print_stats((string(t) + (generic ? " generic" : " special")).c_str(), n, st);
+        }
+    }
+    return 0;
+}
+
+static const int SLOT_RUN_MAX = 256;
+
+// Читатель таблицы во время прогона slots (bench snapshot)
+enum SlotReader {
+    READER_NONE,
+    READER_SCAN,       // обход без проверки номеров: может увидеть pid одной регистрации и ticket другой
+    READER_SNAPSHOT,   // table_snapshot
+    READER_LOCKED      // обход под тем же lock, что и переходы (только locked)
+};
+
+static const char *READER_NAMES[] = {"none", "scan", "snapshot", "locked"};
+
+// Общая память прогона slots: счётчики и проверка, что у слота один владелец
+struct SlotRun {
+    std::atomic<long> published, taken, cancelled, errors;
+    std::atomic<int> stop;                            // читателю: прогон закончен
+    std::atomic<long> snaps, consistent, torn;       // снимки читателя, согласованные, слоты с чужим ticket
+    std::atomic<int> holders[SLOT_MASK_BITS];
+    FSem queue;                  // публикации для teacher
+    FSem done[SLOT_RUN_MAX];     // проверенные регистрации студента p
+    FSem ack[SLOT_RUN_MAX];      // студент p забрал результат, слот можно освобождать
+    FSem freed;                  // освобождённые слоты для студентов без места
+};
+
+struct SlotRunResult {
+    double secs = 0;
+    long published = 0, taken = 0, cancelled = 0, errors = 0;
+    long snaps = 0, consistent = 0, torn = 0;
+    string broken;   // пусто, если инварианты выполнены
+    vector<double> lat;
+};
+
+// students процессов по rounds регистраций против одного процесса-teacher на таблице
+// из Capacity слотов. locked — переходы под общим futex-lock, как до CAS;
+// cancel — каждый 4-й студент пытается уйти сразу после публикации.
+// reader — отдельный процесс, который всё время прогона читает таблицу целиком.
+template <int Capacity>
+SlotRunResult slot_run(int students, int rounds, bool locked, bool cancel, int reader = READER_NONE) {
+    SlotRunResult res;
+    FutexTransport sync;
+    size_t off = (sizeof(SharedData) + Capacity * sizeof(StudentSlot) + 63) & ~(size_t)63;
+    size_t size = off + sync.area_size(Capacity);
+    size_t run_size = sizeof(SlotRun) + (size_t)students * rounds * sizeof(double);
+    SharedData *shm = (SharedData *)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    SlotRun *run = (SlotRun *)mmap(nullptr, run_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED || run == MAP_FAILED || !sync.create(shm, (char *)shm + off, Capacity)) {
+        perror("slot run");
+        res.broken = "setup";
+        return res;
+    }
+    double *samples = (double *)(run + 1);
+    shm->capacity = Capacity;
+    slot_table_init(shm, Capacity);
+    auto lock = [&] { if (locked) sync.lock(); };
+    auto unlock = [&] { if (locked) sync.unlock(); };
+    typedef Slots<Capacity> S;
+    long total = (long)students * rounds;
+
+    double t0 = now_sec();
+    pid_t teacher = fork();
+    if (teacher == 0) {
+        while (run->taken + run->cancelled < total) {
+            fsem_wait(&run->queue, 100);
+            lock();
+            int i = S::take_waiting(shm);
+            unlock();
+            if (i < 0) continue;
+            if (run->holders[i].fetch_add(1) != 0) run->errors++;
+            int p = shm->slots[i].pid;
+            bool valid = p >= 0 && p < students && shm->slots[i].ticket == p;
+            if (!valid) run->errors++;
+            run->holders[i].fetch_sub(1);
+            // как teacher: освободить слот только после ack, иначе отмена студента
+            // может попасть в чужую регистрацию того же слота
+            if (valid) {
+                fsem_post(&run->done[p]);
+                while (fsem_wait(&run->ack[p], -1) != 1) {}
+            }
+            lock();
+            S::release(shm, i);
+            unlock();
+            fsem_post(&run->freed);
+            run->taken++;
+        }
+        _exit(0);
+    }
+
+    pid_t rd = reader == READER_NONE ? -1 : fork();
+    if (rd == 0) {
+        TableSnapshot snap;
+        snap.slots.resize(Capacity);
+        while (!run->stop) {
+            if (reader == READER_SNAPSHOT) {
+                if (table_snapshot(shm, Capacity, snap)) run->consistent++;
+            } else {
+                if (reader == READER_LOCKED) sync.lock();
+                for (int i = 0; i < Capacity; ++i) {
+                    SlotView &v = snap.slots[i];
+                    v.word = shm->slots[i].word.load(std::memory_order_acquire);
+                    v.pid = shm->slots[i].pid;
+                    v.ticket = shm->slots[i].ticket;
+                }
+                if (reader == READER_LOCKED) sync.unlock();
+            }
+            for (const SlotView &v : snap.slots) {
+                if ((v.state() == SLOT_WAITING || v.state() == SLOT_PROCESSING) && v.ticket != v.pid) run->torn++;
+            }
+            run->snaps++;
+        }
+        _exit(0);
+    }
+
+    vector<pid_t> kids;
+    for (int p = 0; p < students; ++p) {
+        pid_t c = fork();
+        if (c == 0) {
+            for (int r = 0; r < rounds; ++r) {
+                double s0 = now_sec();
+                int i;
+                for (;;) {
+                    lock();
+                    i = S::reserve(shm);
+                    unlock();
+                    if (i >= 0) break;
+                    fsem_wait(&run->freed, 10);
+                }
+                if (run->holders[i].fetch_add(1) != 0) run->errors++;
+                shm->slots[i].pid = p;
+                shm->slots[i].ticket = (int16_t)p;
+                run->holders[i].fetch_sub(1);
+                lock();
+                S::publish(shm, i);
+                unlock();
+                samples[(size_t)p * rounds + r] = (now_sec() - s0) * 1e9;
+                run->published++;
+                fsem_post(&run->queue);
+                if (cancel && r % 4 == 0) {
+                    sched_yield();
+                    lock();
+                    bool ok = slot_cancel(shm, i);
+                    unlock();
+                    if (ok) {
+                        run->cancelled++;
+                        continue;
+                    }
+                }
+                while (fsem_wait(&run->done[p], -1) != 1) {}
+                fsem_post(&run->ack[p]);
+            }
+            _exit(0);
+        }
+        if (c > 0) kids.push_back(c);
+    }
+    for (pid_t c : kids) waitpid(c, nullptr, 0);
+    int status = 0;
+    waitpid(teacher, &status, 0);
+    res.secs = now_sec() - t0;
+    run->stop = 1;
+    if (rd > 0) waitpid(rd, nullptr, 0);
+    res.snaps = run->snaps;
+    res.consistent = run->consistent;
+    res.torn = run->torn;
+
+    res.published = run->published;
+    res.taken = run->taken;
+    res.cancelled = run->cancelled;
+    res.errors = run->errors;
+    if ((int)kids.size() != students) res.broken += " fork";
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) res.broken += " teacher";
+    if (res.errors) res.broken += " ownership";
+    if (res.published != total || res.published != res.taken + res.cancelled) res.broken += " counts";
+    for (int i = 0; i < Capacity; ++i) {
+        if (slot_state(shm, i) != SLOT_EMPTY) {
+            res.broken += " state";
+            break;
+        }
+    }
+    for (int w = 0; w < SLOT_MASK_WORDS; ++w) {
+        unsigned long long full = w < Capacity / 64 ? ~0ull : 0;
+        if (shm->free_mask[w] != full || shm->wait_mask[w] != 0) {
+            res.broken += " masks";
+            break;
+        }
+    }
+    if (active_students(shm) != 0) res.broken += " active";
+    res.lat.assign(samples, samples + total);
+
+    sync.destroy();
+    munmap(run, run_size);
+    munmap(shm, size);
+    return res;
+}
+
+// Проверка инвариантов CAS-переходов под нагрузкой и сравнение с общим lock при 64 и P
+// одновременных студентах
+int bench_slots(int students, int rounds) {
+    SlotRunResult st = slot_run<64>(students, rounds, false, true);
+    printf("stress: %d students x %d rounds, 64 slots, cancel every 4th: published=%ld taken=%ld "
+           "cancelled=%ld ownership_errors=%ld invariants=%s\n",
+           students, rounds, st.published, st.taken, st.cancelled, st.errors,
+           st.broken.empty() ? "ok" : ("BROKEN:" + st.broken).c_str());
+
+    printf("\n%-8s %9s %12s %10s %10s\n", "slots", "students", "cycles/s", "p50_ns", "p99_ns");
+    vector<int> counts = {64};
+    if (students != 64) counts.push_back(students);
+    bool ok = st.broken.empty();
+    for (int n : counts) {
+        for (bool locked : {true, false}) {
+            SlotRunResult r = slot_run<SLOT_MASK_BITS>(n, rounds, locked, false);
+            ok = ok && r.broken.empty();
+            double p50 = percentile(r.lat, 0.5), p99 = percentile(r.lat, 0.99);
+            printf("%-8s %9d %12.0f %10.0f %10.0f%s\n", locked ? "locked" : "cas", n, r.published / r.secs,
+                   p50, p99, r.broken.empty() ? "" : (" BROKEN:" + r.broken).c_str());
+        }
+    }
+    return ok ? 0 : 1;
+}
+
+// Влияние читателя таблицы на пропускную способность студентов и teacher: без читателя,
+// обход без проверки номеров, table_snapshot и обход под общим lock (при locked-переходах)
+int bench_snapshot(int students, int rounds) {
+    printf("%-7s %-9s %9s %12s %10s %10s %10s %11s %6s\n", "slots", "reader", "students", "cycles/s", "p50_ns",
+           "p99_ns", "snaps/s", "consistent", "torn");
+    bool ok = true;
+    for (bool locked : {false, true}) {
+        for (int reader : {READER_NONE, READER_SCAN, READER_SNAPSHOT, READER_LOCKED}) {
+            if (reader == READER_LOCKED && !locked) continue;
+            SlotRunResult r = slot_run<SLOT_MASK_BITS>(students, rounds, locked, false, reader);
+            ok = ok && r.broken.empty();
+            // torn у snapshot — ошибка протокола
+            if (reader == READER_SNAPSHOT && r.torn) ok = false;
+            string cons = reader == READER_SNAPSHOT ? to_string(r.snaps ? 100 * r.consistent / r.snaps : 0) + "%" : "-";
+            printf("%-7s %-9s %9d %12.0f %10.0f %10.0f %10.0f %11s %6ld%s\n", locked ? "locked" : "cas",
+                   READER_NAMES[reader], students, r.published / r.secs, percentile(r.lat, 0.5), percentile(r.lat, 0.99),
+                   r.snaps / r.secs, cons.c_str(), r.torn, r.broken.empty() ? "" : (" BROKEN:" + r.broken).c_str());
+        }
+    }
+    return ok ? 0 : 1;
+}
+
+// Слот до упаковки (для сравнения): 148 байт, имена семафоров хранились в слоте,
+// teacher заполнял каждый слот при запуске
+struct WideSlot {
+    pid_t pid;
+    int ticket;
+    int grade;
+    int grade_ms;
+    std::atomic<int> state;
+    char grade_sem_name[64];
+    char ack_sem_name[64];
+};
+
+struct LayoutResult {
+    double setup_ms = 0, scan_ms = 0, warm_ns = 0, touch_ms = 0;
+    long setup_faults = 0, scan_faults = 0, touch_faults = 0;
+};
+
+// n слотов Slot в новом сегменте /dev/shm: создание (wide — с прежним циклом
+// инициализации), первый обход слов состояния, повторный обход и регистрация touch
+// случайных студентов
+template <class Slot, class Init, class Touch>
+LayoutResult layout_run(size_t n, int touch, Init init, Touch reg) {
+    LayoutResult res;
+    string name = exam_name("/exam_bench_layout");
+    size_t size = n * sizeof(Slot);
+    double t0 = now_sec();
+    long f0 = minor_faults();
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+    Slot *slots = nullptr;
+    if (fd >= 0 && ftruncate(fd, size) == 0) {
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) slots = (Slot *)p;
+    }
+    if (fd >= 0) close(fd);
+    shm_unlink(name.c_str());
+    if (!slots) {
+        perror("layout segment");
+        return res;
+    }
+    for (size_t i = 0; i < n; ++i) init(slots[i], i);
+    res.setup_ms = (now_sec() - t0) * 1e3;
+    res.setup_faults = minor_faults() - f0;
+
+    long empty = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        f0 = minor_faults();
+        double s0 = now_sec();
+        for (size_t i = 0; i < n; ++i) empty += slot_state_of(*(volatile uint32_t *)&slots[i]) == SLOT_EMPTY;
+        double secs = now_sec() - s0;
+        if (pass == 0) {
+            res.scan_ms = secs * 1e3;
+            res.scan_faults = minor_faults() - f0;
+        } else {
+            res.warm_ns = secs * 1e9 / n;
+        }
+    }
+    if (empty != 2 * (long)n) fprintf(stderr, "layout: %ld of %zu slots not empty\n", 2 * (long)n - empty, n);
+
+    srand(1);
+    f0 = minor_faults();
+    double s0 = now_sec();
+    for (int k = 0; k < touch; ++k) reg(slots[(size_t)rand() % n], 1000 + k);
+    res.touch_ms = (now_sec() - s0) * 1e3;
+    res.touch_faults = minor_faults() - f0;
+    munmap(slots, size);
+    return res;
+}
+
+struct WideInit {
+    void operator()(WideSlot &s, size_t) const {
+        s.state = SLOT_EMPTY;
+        s.pid = 0;
+        s.ticket = 0;
+        s.grade = 0;
+        s.grade_ms = -1;
+        s.grade_sem_name[0] = '\0';
+        s.ack_sem_name[0] = '\0';
+    }
+};
+
+struct WideTouch {
+    void operator()(WideSlot &s, int pid) const {
+        s.pid = pid;
+        s.ticket = 1 + pid % 100;
+        s.grade_ms = -1;
+        s.state = SLOT_WAITING;
+    }
+};
+
+struct CompactInit {
+    void operator()(StudentSlot &, size_t) const {}
+};
+
+struct CompactTouch {
+    void operator()(StudentSlot &s, int pid) const {
+        s.pid = pid;
+        s.ticket = (int16_t)(1 + pid % 100);
+        s.grade_ms = -1;
+        s.word.store(slot_next(s.word.load(std::memory_order_relaxed), SLOT_WAITING), std::memory_order_release);
+    }
+};
+
+// Таблица из n слотов в прежнем (148 байт, цикл инициализации) и компактном (16 байт,
+// обнуление ядром) представлении
+int bench_layout(size_t n, int touch) {
+    printf("%-8s %5s %8s %10s %9s %10s %9s %10s %9s %10s\n", "layout", "bytes", "MB", "setup_ms", "faults",
+           "scan_ms", "faults", "warm_ns", "touch_ms", "faults");
+    LayoutResult w = layout_run<WideSlot>(n, touch, WideInit{}, WideTouch{});
+    LayoutResult c = layout_run<StudentSlot>(n, touch, CompactInit{}, CompactTouch{});
+    const char *names[] = {"wide", "compact"};
+    size_t sizes[] = {sizeof(WideSlot), sizeof(StudentSlot)};
+    LayoutResult *rs[] = {&w, &c};
+    for (int k = 0; k < 2; ++k) {
+        LayoutResult &r = *rs[k];
+        printf("%-8s %5zu %8.1f %10.1f %9ld %10.1f %9ld %10.2f %9.2f %10ld\n", names[k], sizes[k],
+               n * sizes[k] / 1048576.0, r.setup_ms, r.setup_faults, r.scan_ms, r.scan_faults, r.warm_ns, r.touch_ms,
+               r.touch_faults);
+    }
+    return 0;
+}
+
+int count_lines(const char *path, const char *needle) {
+    FILE *f = fopen(path, "r");
+    char line[512];
+    int n = 0;
+    while (f && fgets(line, sizeof(line), f)) {
+        if (strstr(line, needle)) n++;
+    }
+    if (f) fclose(f);
+    return n;
+}
+
+struct AttachSample {
+    double us;
+    long faults;
+};
+
+// Подключение студента (attach.h) в отдельном процессе без exec: от shm_open до
+// полученных каналов своего слота, и page faults за это время. Затем n настоящих
+// процессов ./student на том же транспорте: общее время и сколько проверено.
+int bench_attach(int n) {
+    const char *out = "/tmp/exam_bench_attach.out";
+    printf("%-8s %7s %10s %10s %7s %9s %11s %7s\n", "backend", "n", "attach_p50", "attach_p99", "faults",
+           "total_s", "students/s", "graded");
+    AttachSample *samples = (AttachSample *)mmap(nullptr, n * sizeof(AttachSample), PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (samples == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    for (int kind : {TR_NAMED_SEM, TR_UNNAMED_SEM, TR_FUTEX, TR_EVENTFD}) {
+        vector<string> teacher = {"./teacher", to_string(SLOT_MASK_BITS), "--grade-ms", "0",
+                                  "--transport", TRANSPORT_NAMES[kind]};
+        pid_t t = spawn(teacher);
+        usleep(300000);
+        for (int i = 0; i < n; ++i) {
+            pid_t c = fork();
+            if (c == 0) {
+                rusage r0{}, r1{};
+                getrusage(RUSAGE_SELF, &r0);
+                double t0 = now_sec();
+                ExamAttach a;
+                int slot = -1;
+                if (exam_attach(a, false) == ATTACH_OK) {
+                    slot = Slots<SLOT_MASK_BITS>::reserve(a.shm);
+                    if (slot >= 0 && !exam_attach_slot(a, slot, false)) slot = -2;
+                }
+                double t1 = now_sec();
+                getrusage(RUSAGE_SELF, &r1);
+                samples[i] = {slot >= 0 ? (t1 - t0) * 1e6 : -1, r1.ru_minflt - r0.ru_minflt};
+                if (slot >= 0) slot_unreserve(a.shm, slot);
+                exam_detach(a);
+                _exit(0);
+            }
+            waitpid(c, nullptr, 0);
+        }
+        stop(t);
+
+        vector<double> us;
+        double faults = 0;
+        for (int i = 0; i < n; ++i) {
+            if (samples[i].us < 0) continue;
+            us.push_back(samples[i].us);
+            faults += samples[i].faults;
+        }
+        if (us.empty()) {
+            printf("%-8s attach failed\n", TRANSPORT_NAMES[kind]);
+            continue;
+        }
+        faults /= us.size();
+
+        RunStats run = run_processes(teacher, {"./student", "--prep-ms", "0"}, n, out);
+        printf("%-8s %7d %10.1f %10.1f %7.1f %9.2f %11.1f %7d\n", TRANSPORT_NAMES[kind], n,
+               percentile(us, 0.5), percentile(us, 0.99), faults, run.total_s,
+               run.total_s > 0 ? run.lat_ms.size() / run.total_s : 0.0, count_lines(out, "Grade="));
+    }
+    munmap(samples, n * sizeof(AttachSample));
+    unlink(out);
+    return 0;
+}
+
+// Цена трассы (teacher --trace): r пар прогонов по n студентов без трассы и с ней,
+// медиана пропускной способности и размер трассы на студента
+int bench_trace(int n, int r) {
+    vector<double> rate[2];
+    off_t bytes = 0;
+    for (int k = 0; k < r; ++k) {
+        // порядок чередуется, чтобы дрейф машины не ложился на один вариант
+        for (int j = 0; j < 2; ++j) {
+            int on = (j + k) % 2;
+            vector<string> teacher = {"./teacher", "64", "--grade-ms", "0", "--transport", "futex"};
+            if (on) teacher.push_back("--trace");
+            RunStats st = run_processes(teacher, {"./student", "--prep-ms", "0"}, n);
+            rate[on].push_back(st.total_s > 0 ? st.lat_ms.size() / st.total_s : 0);
+            if (on) bytes = file_size(TRACE_NAME);
+        }
+    }
+    double off = percentile(rate[0], 0.5), on = percentile(rate[1], 0.5);
+    printf("%-6s %7s %11s %11s\n", "trace", "n", "students/s", "bytes/stud");
+    printf("%-6s %7d %11.1f %11s\n", "off", n, off, "-");
+    printf("%-6s %7d %11.1f %11.1f\n", "on", n, on, (double)bytes / n);
+    printf("overhead %.2f%% (median of %d runs each)\n", off > 0 ? (off - on) / off * 100 : 0.0, r);
+    unlink(TRACE_NAME);
+    return 0;
+}
+
+// Завершение экзамена: e экзаменов (--exam shut<k>) по n / e слотов, все n студентов
+// ждут оценку (проверка одного студента на экзамен длится дольше замера), затем SIGINT
+// всем teacher. Процессорное время оповещения (самый медленный teacher, по его логу)
+// и время от сигнала до выхода студентов: p50, p99 и последнего.
+int bench_shutdown(int n, int e) {
+    printf("%-8s %7s %6s %8s %10s %9s %9s %10s %10s\n", "backend", "n", "exams", "reg_s", "notify_cpu",
+           "exit_p50", "exit_p99", "all_exited", "teachers");
+    int cap = (n + e - 1) / e;
+    for (int kind : {TR_NAMED_SEM, TR_UNNAMED_SEM, TR_FUTEX, TR_EVENTFD}) {
+        vector<pid_t> teachers;
+        for (int k = 0; k < e; ++k) {
+            string out = "/tmp/exam_bench_shutdown." + to_string(k) + ".out";
+            teachers.push_back(spawn({"./teacher", to_string(cap), "--grade-ms", "600000", "--transport",
+                                      TRANSPORT_NAMES[kind], "--exam", "shut" + to_string(k)}, out.c_str()));
+        }
+        usleep(300000 + 10000 * e);
+
+        vector<ExamAttach> exams(e);
+        bool ok = true;
+        for (int k = 0; k < e; ++k) {
+            set_exam_id(("shut" + to_string(k)).c_str());
+            if (exam_attach(exams[k], false) != ATTACH_OK) ok = false;
+        }
+        exam_id().clear();
+
+        map<pid_t, bool> students;
+        double t0 = now_sec();
+        for (int i = 0; i < n && ok; ++i) {
+            students[spawn({"./student", "--prep-ms", "0", "--exam", "shut" + to_string(i % e)})] = true;
+        }
+        // все зарегистрированы: сумма active по экзаменам; ушедшие раньше времени — ошибка
+        long waiting = 0;
+        while (ok && waiting < n && now_sec() - t0 < 300) {
+            usleep(50000);
+            waiting = 0;
+            for (int k = 0; k < e; ++k) waiting += active_students(exams[k].shm);
+        }
+        double reg = now_sec() - t0;
+        for (ExamAttach &a : exams) exam_detach(a);
+
+        vector<double> exit_ms;
+        double teachers_ms = 0;
+        size_t left = teachers.size();
+        double s0 = now_sec();
+        for (pid_t t : teachers) kill(t, SIGINT);
+        while (!students.empty() || left > 0) {
+            pid_t p = waitpid(-1, nullptr, 0);
+            if (p < 0) break;
+            double ms = (now_sec() - s0) * 1e3;
+            if (students.erase(p)) exit_ms.push_back(ms);
+            else if (find(teachers.begin(), teachers.end(), p) != teachers.end()) {
+                left--;
+                teachers_ms = ms;
+            }
+        }
+        // время оповещения по логу teacher (у старых версий строки нет)
+        long notify_us = -1;
+        for (int k = 0; k < e; ++k) {
+            string out = "/tmp/exam_bench_shutdown." + to_string(k) + ".out";
+            FILE *f = fopen(out.c_str(), "r");
+            char line[256];
+            long us;
+            while (f && fgets(line, sizeof(line), f)) {
+                const char *p = strstr(line, "notified in ");
+                if (p && sscanf(p, "notified in %ld", &us) == 1) notify_us = max(notify_us, us);
+            }
+            if (f) fclose(f);
+            unlink(out.c_str());
+        }
+        if (!ok || waiting < n) {
+            printf("%-8s only %ld of %d students waiting\n", TRANSPORT_NAMES[kind], waiting, n);
+            continue;
+        }
+        double all = exit_ms.empty() ? 0 : *max_element(exit_ms.begin(), exit_ms.end());
+        printf("%-8s %7d %6d %8.1f %10s %9.1f %9.1f %10.1f %10.1f\n", TRANSPORT_NAMES[kind], n, e, reg,
+               notify_us < 0 ? "-" : to_string(notify_us).c_str(), percentile(exit_ms, 0.5), percentile(exit_ms, 0.99), all, teachers_ms);
+    }
+    return 0;
+}
+
+// observer --aggregate: mb мегабайт строк жизненного цикла студентов (как пишут student и
+// teacher) через FIFO в три режима наблюдателя — эхо, разбор с memchr и с SSE2.
+// Процессорное время наблюдателя и проверка счётчиков его итоговой строки
+int bench_aggregate(int mb) {
+    if (mkfifo(FIFO_NAME, 0666) == -1 && errno != EEXIST) {
+        perror("mkfifo");
+        return 1;
+    }
+    // один студент — 7 строк, оценка 3 + i % 3, билет 1 + i % 100
+    string block;
+    for (int i = 0; i < 4096; ++i) {
+        char b[512];
+        int pid = 100000 + i;
+        int n = snprintf(b, sizeof(b),
+                         "[STUDENT %d] Preparing 2s, ticket=%d\n[STUDENT %d] Registered in slot %d\n"
+                         "[TEACHER] Checking PID=%d ticket=%d\n[TEACHER] Grade=%d PID=%d\n"
+                         "[STUDENT %d] Received grade: %d\n[STUDENT %d] Preparing 1s, ticket=%d\n"
+                         "[STUDENT %d] No free slots, leaving\n",
+                         pid, 1 + i % 100, pid, i % 64, pid, 1 + i % 100, 3 + i % 3, pid, pid, 3 + i % 3,
+                         pid + 500000, 1 + i % 100, pid + 500000);
+        block.append(b, n);
+    }
+    off_t total = (off_t)mb * 1024 * 1024;
+    long rounds = total / (off_t)block.size() + 1;
+    long students = rounds * 4096;
+
+    const char *names[] = {"copy", "memchr", "sse2"};
+    printf("%-8s %10s %12s %14s %s\n", "mode", "cpu_s", "cpu_ms/MB", "lines/cpu_s", "check");
+    for (int m = 0; m < 3; ++m) {
+        unlink(BENCH_OUT);
+        pid_t child = fork();
+        if (child == 0) {
+            int out = open(BENCH_OUT, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            dup2(out, STDOUT_FILENO);
+            close(out);
+            int null_fd = open("/dev/null", O_WRONLY);
+            dup2(null_fd, STDERR_FILENO);
+            if (m == 0) execl("./observer", "observer", (char *)nullptr);
+            else if (m == 1) execl("./observer", "observer", "--aggregate", "--scalar-scan", (char *)nullptr);
+            else execl("./observer", "observer", "--aggregate", (char *)nullptr);
+            _exit(127);
+        }
+        int fd = -1;
+        for (int i = 0; i < 100 && fd < 0; ++i) {
+            fd = open(FIFO_NAME, O_WRONLY | O_NONBLOCK);
+            if (fd < 0) usleep(20000);
+        }
+        if (fd < 0) {
+            perror("open fifo");
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+            return 1;
+        }
+        fcntl(fd, F_SETFL, 0);
+        for (long r = 0; r < rounds; ++r) {
+            if (write(fd, block.data(), block.size()) != (ssize_t)block.size()) break;
+        }
+        // ждём, пока наблюдатель вычитает FIFO
+        int unread = 1;
+        for (int i = 0; i < 1000 && unread > 0; ++i) {
+            if (ioctl(fd, FIONREAD, &unread) < 0) break;
+            if (unread > 0) usleep(10000);
+        }
+        usleep(200000);
+        close(fd);
+
+        kill(child, SIGINT);
+        rusage ru{};
+        wait4(child, nullptr, 0, &ru);
+        double cpu = cpu_seconds(ru);
+
+        string check = "-";
+        if (m > 0) {
+            unsigned long long lines = 0, st = 0, checked = 0, graded = 0, received = 0;
+            FILE *f = fopen(BENCH_OUT, "r");
+            char buf[512];
+            while (f && fgets(buf, sizeof(buf), f)) {
+                const char *a = strstr(buf, "Aggregate: ");
+                if (a) sscanf(a, "Aggregate: lines=%llu students=%llu checked=%llu graded=%llu received=%llu",
+                              &lines, &st, &checked, &graded, &received);
+            }
+            if (f) fclose(f);
+            bool ok = lines == (unsigned long long)students * 7 && st == (unsigned long long)students * 2
+                      && graded == (unsigned long long)students && received == graded;
+            check = (ok ? "ok " : "MISMATCH ") + to_string(graded) + " graded";
+        }
+        printf("%-8s %10.3f %12.3f %14.0f %s\n", names[m], cpu, cpu * 1000.0 / mb,
+               cpu > 0 ? students * 7 / cpu : 0.0, check.c_str());
+    }
+    unlink(BENCH_OUT);
+    return 0;
+}
+
+// teacher --loop с перекрытием проверок: n студентов, проверка g мс, одна сессия и o сессий
+// одновременно на eventfd-транспорте, для io_uring и epoll
+int bench_overlap(int n, int o, int g) {
+    const char *out = "/tmp/exam_bench_teacher.out";
+    printf("%-8s %8s %7s %10s %10s %s\n", "backend", "overlap", "n", "students/s", "p50_ms", "teacher stats");
+    for (const char *be : {"uring", "epoll"}) {
+        for (int ov : {1, o}) {
+            vector<string> teacher = {"./teacher", to_string(min(max(n, o), 1024)), "--grade-ms", to_string(g),
+                                      "--loop", be, "--transport", "eventfd", "--overlap", to_string(ov)};
+            RunStats st = run_processes(teacher, {"./student", "--prep-ms", "0"}, n, out);
+
+            string stats = "-";
+            FILE *f = fopen(out, "r");
+            char line[256];
+            while (f && fgets(line, sizeof(line), f)) {
+                const char *p = strstr(line, "Loop stats: ");
+                if (p) {
+                    stats = p + strlen("Loop stats: ");
+                    if (!stats.empty() && stats.back() == '\n') stats.pop_back();
+                }
+            }
+            if (f) fclose(f);
+            printf("%-8s %8d %7d %10.1f %10.1f %s\n", be, ov, n, st.total_s > 0 ? n / st.total_s : 0.0,
+                   percentile(st.lat_ms, 0.5), stats.c_str());
+            if (ov == o) break;
+        }
+    }
+    unlink(out);
+    return 0;
+}
+
+// Команда cmd управляющему сокету teacher: раз, если interval_us == 0, иначе каждые
+// interval_us до SIGKILL. Ответы считаются в served (общая анонимная страница)
+pid_t spawn_admin_client(const string &cmd, int interval_us, long *served) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, exam_name(ADMIN_SOCK_NAME).c_str(), sizeof(addr.sun_path) - 1);
+    string line = cmd + "\n";
+    char buf[512];
+    while (true) {
+        int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool ok = s >= 0 && connect(s, (sockaddr *)&addr, sizeof(addr)) == 0
+                  && send(s, line.data(), line.size(), MSG_NOSIGNAL) == (ssize_t)line.size();
+        while (ok && read(s, buf, sizeof(buf)) > 0) {}
+        if (s >= 0) close(s);
+        if (ok) {
+            __atomic_fetch_add(served, 1, __ATOMIC_RELAXED);
+            if (interval_us == 0) _exit(0);
+        }
+        usleep(ok ? interval_us : 10000);
+    }
+}
+
+// Управляющий сокет не должен задевать проверку: R прогонов по N студентов без
+// запросов, с stats каждую миллисекунду и с set log quiet, медиана пропускной способности
+int bench_admin(int n, int runs) {
+    long *served = static_cast<long *>(mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    if (served == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    vector<string> teacher = {"./teacher", "64", "--grade-ms", "0", "--transport", "futex"};
+    vector<string> student = {"./student", "--prep-ms", "0"};
+    struct Case {
+        const char *name;
+        const char *cmd;
+        int interval_us;
+    };
+    const Case cases[] = {{"idle", nullptr, 0}, {"stats/1ms", "stats", 1000}, {"log quiet", "set log quiet", 0}};
+    printf("%-10s %7s %10s %10s %10s %10s\n", "admin", "n", "students/s", "p50_ms", "p99_ms", "queries/s");
+    for (const Case &c : cases) {
+        vector<double> rate, p50, p99, qps;
+        for (int r = 0; r < runs; ++r) {
+            *served = 0;
+            pid_t client = c.cmd ? spawn_admin_client(c.cmd, c.interval_us, served) : -1;
+            RunStats st = run_processes(teacher, student, n);
+            if (client > 0) {
+                kill(client, SIGKILL);
+                waitpid(client, nullptr, 0);
+            }
+            rate.push_back(n / st.total_s);
+            p50.push_back(percentile(st.lat_ms, 0.5));
+            p99.push_back(percentile(st.lat_ms, 0.99));
+            qps.push_back(c.interval_us ? *served / st.total_s : 0);
+        }
+        printf("%-10s %7d %10.1f %10.2f %10.2f %10.0f\n", c.name, n, percentile(rate, 0.5), percentile(p50, 0.5),
+               percentile(p99, 0.5), percentile(qps, 0.5));
+    }
+    munmap(served, 4096);
+    return 0;
+}
+
+// --protocol 1 и 2 на каждом транспорте: медиана R прогонов по N студентов.
+// csw/student — добровольные переключения контекста teacher на одного студента
+int bench_protocol(int n, int runs) {
+    printf("%-8s %5s %10s %10s %10s %12s %12s\n", "backend", "proto", "students/s", "p50_ms", "p99_ms",
+           "csw/student", "cpu_us/stud");
+    for (int kind = 0; kind < TR_COUNT; ++kind) {
+        for (int proto : {PROTO_V1, PROTO_V2}) {
+            vector<string> teacher = {"./teacher", to_string(min(n, 1024)), "--grade-ms", "0",
+                                      "--transport", TRANSPORT_NAMES[kind], "--protocol", to_string(proto)};
+            vector<double> rate, p50, p99, csw, cpu;
+            for (int r = 0; r < runs; ++r) {
+                rusage ru{};
+                RunStats st = run_processes(teacher, {"./student", "--prep-ms", "0"}, n, nullptr, &ru);
+                rate.push_back(n / st.total_s);
+                p50.push_back(percentile(st.lat_ms, 0.5));
+                p99.push_back(percentile(st.lat_ms, 0.99));
+                csw.push_back((double)ru.ru_nvcsw / n);
+                cpu.push_back(cpu_seconds(ru) * 1e6 / n);
+            }
+            printf("%-8s %5d %10.1f %10.2f %10.2f %12.2f %12.1f\n", TRANSPORT_NAMES[kind], proto,
+                   percentile(rate, 0.5), percentile(p50, 0.5), percentile(p99, 0.5), percentile(csw, 0.5),
+                   percentile(cpu, 0.5));
+        }
+    }
+    return 0;
+}
+
+// Объекты экзамена ID в /dev/shm (сегмент, именованные семафоры) и сокеты в /tmp.
+// FIFO лога не считается: teacher его не удаляет намеренно
+int count_exam_objects(const string &id) {
+    int n = 0;
+    string suffix = "." + id;
+    for (const char *dir : {"/dev/shm", "/tmp"}) {
+        DIR *d = opendir(dir);
+        while (dirent *e = d ? readdir(d) : nullptr) {
+            string name = e->d_name;
+            if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0
+                || (name.compare(0, 5, "exam_") != 0 && name.compare(0, 9, "sem.exam_") != 0)) {
+                continue;
+            }
+            struct stat st;
+            if (stat((string(dir) + "/" + name).c_str(), &st) == 0 && !S_ISFIFO(st.st_mode)) n++;
+        }
+        if (d) closedir(d);
+    }
+    return n;
+}
+
+enum ChaosFault {
+    FAULT_NONE = 0,
+    FAULT_KILL,      // SIGKILL студентам в каждом состоянии слота
+    FAULT_DELAY,     // teacher: SIGSTOP на 5 мс каждые 20 мс
+    FAULT_SUSPEND,   // teacher: SIGSTOP на 500 мс после четверти студентов
+    FAULT_FIFO,      // FIFO лога заполнен, читатель его не читает
+    FAULT_EXHAUST,   // слотов в 8 раз меньше, чем студентов, все приходят сразу
+    FAULT_COUNT
+};
+static const char *FAULT_NAMES[FAULT_COUNT] = {"none", "kill", "delay", "suspend", "fifo", "exhaust"};
+
+struct ChaosResult {
+    int graded = 0, killed = 0, stuck = 0;
+    int kills[SLOT_RESERVED + 1] = {};   // по состоянию слота в момент SIGKILL
+    vector<double> lat_ms;               // выжившие студенты, от запуска до выхода
+    vector<double> recovery_ms;          // от конца отказа до выхода следующего студента
+    double total_s = 0;
+    int leaked_slots = 0, leaked_objects = 0;
+    bool teacher_killed = false;         // не завершился по SIGINT за 5 с
+};
+
+// Один прогон: teacher args + N студентов экзамена "chaos" под отказом f.
+// Студенты, не вышедшие за timeout_s, — stuck; после них teacher получает SIGINT
+ChaosResult chaos_run(const vector<string> &args, ChaosFault f, int n, int timeout_s) {
+    ChaosResult r;
+    const char *out = "/tmp/exam_bench_chaos.out";
+    int objects = count_exam_objects("chaos");
+    int cap = f == FAULT_EXHAUST ? max(1, n / 8) : min(n, 1024);
+
+    // заполнить FIFO до запуска teacher: он откроет его на запись без блокировки
+    int fifo_rd = -1;
+    if (f == FAULT_FIFO) {
+        string fifo = exam_name(FIFO_NAME);
+        if (mkfifo(fifo.c_str(), 0666) == -1 && errno != EEXIST) perror("mkfifo");
+        fifo_rd = open(fifo.c_str(), O_RDONLY | O_NONBLOCK);
+        int wr = open(fifo.c_str(), O_WRONLY | O_NONBLOCK);
+        char junk[4096];
+        memset(junk, '.', sizeof(junk));
+        while (wr >= 0 && write(wr, junk, sizeof(junk)) > 0) {}
+        if (wr >= 0) close(wr);
+    }
+
+    vector<string> teacher = {"./teacher", to_string(cap), "--grade-ms", "2", "--exam", "chaos"};
+    teacher.insert(teacher.end(), args.begin(), args.end());
+    pid_t t = spawn(teacher, out);
+    usleep(300000);
+    ExamAttach a;
+    if (exam_attach(a, false) != ATTACH_OK) {
+        perror("attach");
+        stop(t);
+        if (fifo_rd >= 0) close(fifo_rd);
+        r.teacher_killed = true;
+        return r;
+    }
+
+    map<pid_t, double> started;
+    set<pid_t> victims;
+    double t0 = now_sec();
+    for (int i = 0; i < n; ++i) started[spawn({"./student", "--prep-ms", "0", "--exam", "chaos"})] = now_sec();
+
+    int quota = max(1, n / 50);
+    vector<pid_t> owner(cap, 0);   // pid, виденный в слоте после публикации
+    double fault_end = -1, last_done = t0, next_stop = t0 + 0.02, cont_at = 0;
+    bool stopped = false, suspended = false;
+    while (!started.empty() && now_sec() - t0 < timeout_s) {
+        pid_t p;
+        while ((p = waitpid(-1, nullptr, WNOHANG)) > 0) {
+            auto it = started.find(p);
+            if (it == started.end()) continue;
+            double now = now_sec();
+            if (!victims.count(p)) {
+                r.lat_ms.push_back((now - it->second) * 1e3);
+                last_done = now;
+                if (fault_end >= 0) r.recovery_ms.push_back((now - fault_end) * 1e3);
+                fault_end = -1;
+            }
+            started.erase(it);
+        }
+
+        double now = now_sec();
+        if (f == FAULT_KILL) {
+            for (int i = 0; i < cap; ++i) {
+                StudentSlot &s = a.shm->slots[i];
+                uint32_t w = s.word.load(std::memory_order_acquire);
+                pid_t pid = __atomic_load_n(&s.pid, __ATOMIC_RELAXED);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                int st = slot_state_of(w);
+                if (s.word.load(std::memory_order_relaxed) != w || st == SLOT_EMPTY || st == SLOT_ERROR) continue;
+                // в RESERVED pid ещё может быть от прежнего владельца слота
+                if (st != SLOT_RESERVED) owner[i] = pid;
+                else if (pid == owner[i]) continue;
+                if (r.kills[st] >= quota || !started.count(pid) || victims.count(pid)) continue;
+                kill(pid, SIGKILL);
+                victims.insert(pid);
+                r.kills[st]++;
+                r.killed++;
+                fault_end = now;
+            }
+        } else if (f == FAULT_DELAY) {
+            if (!stopped && now >= next_stop) {
+                kill(t, SIGSTOP);
+                stopped = true;
+                cont_at = now + 0.005;
+            } else if (stopped && now >= cont_at) {
+                kill(t, SIGCONT);
+                stopped = false;
+                fault_end = now;
+                next_stop = now + 0.015;
+            }
+        } else if (f == FAULT_SUSPEND) {
+            if (!suspended && !stopped && (int)r.lat_ms.size() >= n / 4) {
+                kill(t, SIGSTOP);
+                stopped = suspended = true;
+                cont_at = now + 0.5;
+            } else if (stopped && now >= cont_at) {
+                kill(t, SIGCONT);
+                stopped = false;
+                fault_end = now;
+            }
+        }
+        usleep(1000);
+    }
+    if (stopped) kill(t, SIGCONT);
+    r.total_s = last_done - t0;
+    for (auto &e : started) {
+        if (!victims.count(e.first)) r.stuck++;
+    }
+
+    // занятый слот без живого владельца — утечка. teacher забирает их раз в REAP_PERIOD_MS,
+    // RESERVED — на втором обходе; запас — на шаг tick (100 мс)
+    for (double w0 = now_sec(); now_sec() - w0 < (2 * REAP_PERIOD_MS + 500) / 1000.0;) {
+        r.leaked_slots = 0;
+        for (int i = 0; i < cap; ++i) {
+            int st = slot_state(a.shm, i);
+            pid_t pid = a.shm->slots[i].pid;
+            if (st != SLOT_EMPTY && !(started.count(pid) && !victims.count(pid))) r.leaked_slots++;
+        }
+        if (r.leaked_slots == 0) break;
+        usleep(50000);
+    }
+    exam_detach(a);
+
+    kill(t, SIGINT);
+    bool teacher_done = false;
+    for (double s0 = now_sec(); now_sec() - s0 < 5 && !teacher_done;) {
+        if (waitpid(t, nullptr, WNOHANG) == t) teacher_done = true;
+        else usleep(10000);
+    }
+    if (!teacher_done) {
+        kill(t, SIGKILL);
+        waitpid(t, nullptr, 0);
+        r.teacher_killed = true;
+    }
+    // оставшиеся студенты уходят по shutdown за секунду
+    for (double s0 = now_sec(); !started.empty();) {
+        pid_t p = waitpid(-1, nullptr, WNOHANG);
+        if (p > 0) started.erase(p);
+        else if (now_sec() - s0 > 5) {
+            for (auto &e : started) kill(e.first, SIGKILL);
+        } else {
+            usleep(10000);
+        }
+    }
+    if (fifo_rd >= 0) close(fifo_rd);
+
+    r.graded = count_lines(out, "Grade=");
+    r.leaked_objects = count_exam_objects("chaos") - objects;
+    unlink(out);
+    return r;
+}
+
+// Отказы под нагрузкой: для каждой конфигурации teacher — прогон без отказа и по прогону
+// на каждый отказ. recovery — худшее время от конца отказа до выхода следующего студента
+int bench_chaos(int n, int timeout_s) {
+    struct Config {
+        const char *name;
+        vector<string> args;
+    };
+    const Config configs[] = {
+        {"serve", {"--transport", "futex"}},
+        {"serve-v2", {"--transport", "futex", "--protocol", "2"}},
+        {"loop", {"--loop", "epoll", "--transport", "eventfd", "--overlap", "4"}},
+        {"rooms-v2", {"--rooms", "4", "--transport", "futex", "--protocol", "2"}},
+    };
+    set_exam_id("chaos");
+    printf("%-9s %-8s %5s %6s %11s %5s %6s %10s %8s %8s %10s %6s %7s\n", "teacher", "fault", "n", "graded",
+           "killed:RWPD", "stuck", "nogr", "students/s", "p50_ms", "p99_ms", "recov_ms", "slots", "objects");
+    for (const Config &c : configs) {
+        for (int f = 0; f < FAULT_COUNT; ++f) {
+            ChaosResult r = chaos_run(c.args, (ChaosFault)f, n, timeout_s);
+            char kills[32];
+            snprintf(kills, sizeof(kills), "%d:%d/%d/%d/%d", r.killed, r.kills[SLOT_RESERVED], r.kills[SLOT_WAITING],
+                     r.kills[SLOT_PROCESSING], r.kills[SLOT_DONE]);
+            string recov = r.recovery_ms.empty() ? "-" : to_string((long)*max_element(r.recovery_ms.begin(),
+                                                                                       r.recovery_ms.end()));
+            printf("%-9s %-8s %5d %6d %11s %5d %6d %10.1f %8.1f %8.1f %10s %6d %6d%s\n", c.name, FAULT_NAMES[f], n,
+                   r.graded, kills, r.stuck, max(0, n - r.killed - r.stuck - r.graded),
+                   r.total_s > 0 ? r.lat_ms.size() / r.total_s : 0.0, percentile(r.lat_ms, 0.5),
+                   percentile(r.lat_ms, 0.99), recov.c_str(), r.leaked_slots, r.leaked_objects,
+                   r.teacher_killed ? " teacher-killed" : "");
+            fflush(stdout);
+        }
+    }
+    exam_id().clear();
+    return 0;
+}
+
+// VmRSS процесса, кБ (из /proc/<pid>/status)
+long rss_kb(pid_t pid) {
+    FILE *f = fopen(("/proc/" + to_string(pid) + "/status").c_str(), "r");
+    char line[256];
+    long kb = -1;
+    while (f && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %ld", &kb) == 1) break;
+    }
+    if (f) fclose(f);
+    return kb;
+}
+
+int count_fds(pid_t pid) {
+    DIR *d = opendir(("/proc/" + to_string(pid) + "/fd").c_str());
+    int n = 0;
+    while (dirent *e = d ? readdir(d) : nullptr) n += e->d_name[0] != '.';
+    if (d) closedir(d);
+    return n;
+}
+
+long shm_used_kb() {
+    struct statvfs vf;
+    if (statvfs("/dev/shm", &vf) < 0) return -1;
+    return (long)((vf.f_blocks - vf.f_bfree) * vf.f_frsize / 1024);
+}
+
+static const int SOAK_EXAMS = 4;
+
+// Долгий прогон: когорты по N студентов одна за другой, S секунд. В каждой когорте каждый
+// двадцатый студент получает SIGKILL в случайный момент первых 50 мс. Каждые K когорт
+// teacher убивается SIGKILL между когортами и запускается с другим ID экзамена (soak0..3):
+// объекты упавшего должен убрать reclaim при запуске следующего. Строка — на каждого teacher
+// (при K = 0 — на 10 когорт): RSS и fd teacher, объекты экзаменов soak*, занятые /dev/shm,
+// слоты без владельца после когорты
+int bench_soak(int seconds, int n, int k) {
+    const char *out = "/tmp/exam_bench_soak.out";
+    vector<string> student = {"./student", "--prep-ms", "0", "--exam", ""};
+    auto objects = [] {
+        int sum = 0;
+        for (int i = 0; i < SOAK_EXAMS; ++i) sum += count_exam_objects("soak" + to_string(i));
+        return sum;
+    };
+    printf("%8s %8s %8s %8s %6s %5s %10s %8s %4s %7s %6s %7s %9s\n", "time_s", "cohorts", "students", "graded",
+           "killed", "stuck", "students/s", "rss_kb", "fds", "objects", "slots", "shm_kb", "reclaimed");
+
+    srand((unsigned)getpid());
+    int gen = 0, cohorts = 0;
+    long students = 0, graded = 0, killed = 0, stuck = 0, reclaimed = 0;
+    long rows = 0, first_rss = -1, first_fds = 0, first_objects = 0, first_shm = 0;
+    long last_rss = 0, last_fds = 0, last_objects = 0, last_shm = 0, max_slots = 0;
+    double t0 = now_sec();
+    while (now_sec() - t0 < seconds) {
+        string id = "soak" + to_string(gen++ % SOAK_EXAMS);
+        set_exam_id(id.c_str());
+        student.back() = id;
+        pid_t t = spawn({"./teacher", to_string(min(n, 1024)), "--grade-ms", "0", "--transport", "named",
+                         "--exam", id}, out);
+        usleep(300000);
+        ExamAttach a;
+        if (exam_attach(a, false) != ATTACH_OK) {
+            perror("attach");
+            stop(t);
+            break;
+        }
+
+        double r0 = now_sec();
+        long r_students = 0, leaked = 0;
+        for (int c = 0; (k == 0 ? c < 10 : c < k) && now_sec() - t0 < seconds; ++c, ++cohorts) {
+            map<pid_t, double> left;     // pid -> момент SIGKILL (0 — не жертва)
+            for (int i = 0; i < n; ++i) {
+                left[spawn(student)] = i % 20 == 19 ? now_sec() + (rand() % 50) / 1000.0 : 0;
+            }
+            students += n;
+            r_students += n;
+            double c0 = now_sec();
+            while (!left.empty() && now_sec() - c0 < 30) {
+                pid_t p;
+                while ((p = waitpid(-1, nullptr, WNOHANG)) > 0) left.erase(p);
+                double now = now_sec();
+                for (auto &e : left) {
+                    if (e.second > 0 && now >= e.second) {
+                        kill(e.first, SIGKILL);
+                        e.second = 0;
+                        killed++;
+                    }
+                }
+                usleep(1000);
+            }
+            stuck += left.size();
+            for (auto &e : left) kill(e.first, SIGKILL);
+            for (auto &e : left) waitpid(e.first, nullptr, 0);
+
+            // слоты убитых студентов teacher освобождает за один-два обхода reap
+            int busy = 0;
+            for (double w0 = now_sec(); now_sec() - w0 < (2 * REAP_PERIOD_MS + 500) / 1000.0; usleep(50000)) {
+                busy = 0;
+                for (int i = 0; i < a.shm->capacity; ++i) busy += slot_state(a.shm, i) != SLOT_EMPTY;
+                if (busy == 0) break;
+            }
+            leaked += busy;
+        }
+        double r_s = now_sec() - r0;
+
+        long rss = rss_kb(t), shm_kb = shm_used_kb();
+        int fds = count_fds(t), objs = objects();
+        exam_detach(a);
+        if (k > 0) {
+            kill(t, SIGKILL);
+            waitpid(t, nullptr, 0);
+        } else {
+            stop(t);
+        }
+        int g = count_lines(out, "Grade="), rc = count_lines(out, "stale objects");
+        graded += g;
+        reclaimed += rc;
+        max_slots = max(max_slots, leaked);
+        if (rows++ == 0) {
+            first_rss = rss;
+            first_fds = fds;
+            first_objects = objs;
+            first_shm = shm_kb;
+        }
+        last_rss = rss;
+        last_fds = fds;
+        last_objects = objs;
+        last_shm = shm_kb;
+        printf("%8.0f %8d %8ld %8ld %6ld %5ld %10.1f %8ld %4d %7d %6ld %7ld %9d\n", now_sec() - t0, cohorts, students,
+               graded, killed, stuck, r_students / r_s, rss, fds, objs, leaked, shm_kb, rc);
+        fflush(stdout);
+    }
+    // последний teacher (после SIGKILL) убирает следующий запуск: здесь — без ожидания
+    pid_t busy = 0;
+    vector<string> lines;
+    exam_id().clear();
+    reclaim_stale(student.back(), busy, lines);
+    unlink(out);
+    printf("growth: rss %+ld kB, fds %+ld, objects %+ld, shm %+ld kB; stuck %ld, max leaked slots %ld, "
+           "reclaimed %ld times, %d left\n", last_rss - first_rss, last_fds - first_fds, last_objects - first_objects,
+           last_shm - first_shm, stuck, max_slots, reclaimed, objects());
+    return 0;
+}
+
+void usage() {
+    cerr << "Usage: ./bench <mode> [args]\n"
+         << "  observer [MB]   CPU per MB: copy loop vs splice (default 64 MB)\n"
+         << "  segments [MB]   segment log write throughput and lookup latency (default 1024 MB)\n"
+         << "  socket [N] [C]  shm vs unix vs tcp with N student processes, then C connections\n"
+         << "                  from one process (default 500, 10000)\n"
+         << "  loop [N]        teacher --loop uring vs epoll: syscalls per graded student (default 500)\n"
+         << "  transport [N] [R]  named/unnamed sem, futex, eventfd, pipe: R ping-pong rounds and\n"
+         << "                  N student processes per backend (default 500, 100000)\n"
+         << "  policy [N] [R]  specialized vs --generic teacher: R slot cycles in one process,\n"
+         << "                  then N student processes (default 500, 1000000)\n"
+         << "  spin [R]        futex grade/ack round trip with spin budget 0, fixed and adaptive\n"
+         << "                  (default 200000)\n"
+         << "  placement [MB]  4k / populate / THP / hugetlb / shm: fault cost, page-chase latency\n"
+         << "                  and dTLB misses over an MB-sized segment (default 512)\n"
+         << "  exams [N] [E]   1, 2, 4 .. E concurrent exams with N students each: aggregate\n"
+         << "                  throughput (default 200, 32)\n"
+         << "  rooms [N] [M] [G]  teacher --rooms 1, 2 .. M, route hash and fill, grading G ms:\n"
+         << "                  aggregate and per-room throughput (default 400, 8, 5)\n"
+         << "  attach [N]      student attach latency and page faults per transport, then N student\n"
+         << "                  processes against teacher 1024 (default 10000)\n"
+         << "  slots [P] [R]   CAS slot transitions: invariant stress with P student processes,\n"
+         << "                  then locked vs CAS at 64 and P students, R rounds each (default 128, 2000)\n"
+         << "  shutdown [N] [E]  N waiting students over E exams, SIGINT to the teachers: time until\n"
+         << "                  every student has exited, per transport (default 10000, 10)\n"
+         << "  trace [N] [R]   teacher with and without --trace: R runs of N students each,\n"
+         << "                  median throughput and trace bytes per student (default 2000, 10)\n"
+         << "  aggregate [MB]  observer echo vs --aggregate with memchr and SSE2 line scanning:\n"
+         << "                  CPU per MB and lines per CPU second (default 256 MB)\n"
+         << "  overlap [N] [O] [G]  teacher --loop with 1 and O grading sessions in flight, eventfd\n"
+         << "                  transport, grading G ms: throughput and latency (default 400, 64, 50)\n"
+         << "  snapshot [P] [R]  slot table readers during P students x R rounds: none, plain scan,\n"
+         << "                  seqlock snapshot and locked scan; writer throughput (default 64, 2000)\n"
+         << "  layout [N] [T]  slot table of N slots, old 148-byte slots with an init loop vs compact\n"
+         << "                  16-byte slots zeroed lazily: setup, scans, T registrations (default 1000000, 1000)\n"
+         << "  admin [N] [R]   teacher with an idle admin socket, stats every 1 ms and log quiet:\n"
+         << "                  median throughput over R runs of N students (default 2000, 5)\n"
+         << "  protocol [N] [R]  grade/ack (v1) vs one-transition handoff (v2) per transport: median\n"
+         << "                  throughput, latency and teacher context switches over R runs (default 2000, 5)\n"
+         << "  chaos [N] [T]   fault injection with N students per run: SIGKILL students by slot state,\n"
+         << "                  SIGSTOP the teacher, full log FIFO, exhausted slots; throughput, tail latency,\n"
+         << "                  recovery and leaked slots/objects, T s per run at most (default 400, 15)\n"
+         << "  soak [S] [N] [K]  cohorts of N students for S seconds, every 20th SIGKILLed, teacher\n"
+         << "                  SIGKILLed and restarted every K cohorts (0 = never): RSS, fds, leaked\n"
+         << "                  slots and IPC objects over time (default 60, 200, 10)\n";
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    string mode = argv[1];
+
+    if (mode == "observer") {
+        int mb = argc > 2 ? atoi(argv[2]) : 64;
+        if (mb <= 0) {
+            cerr << "MB must be > 0\n";
+            return 1;
+        }
+        return bench_observer(mb);
+    }
+
+    if (mode == "segments") {
+        int mb = argc > 2 ? atoi(argv[2]) : 1024;
+        if (mb <= 0) {
+            cerr << "MB must be > 0\n";
+            return 1;
+        }
+        return bench_segments(mb, 10000);
+    }
+
+    if (mode == "socket") {
+        int n = argc > 2 ? atoi(argv[2]) : 500;
+        int c = argc > 3 ? atoi(argv[3]) : 10000;
+        if (n <= 0 || c <= 0) {
+            cerr << "N and C must be > 0\n";
+            return 1;
+        }
+        return bench_socket(n, c);
+    }
+
+    if (mode == "loop") {
+        int n = argc > 2 ? atoi(argv[2]) : 500;
+        if (n <= 0) {
+            cerr << "N must be > 0\n";
+            return 1;
+        }
+        return bench_loop(n);
+    }
+
+    if (mode == "transport") {
+        int n = argc > 2 ? atoi(argv[2]) : 500;
+        int r = argc > 3 ? atoi(argv[3]) : 100000;
+        if (n <= 0 || r <= 0) {
+            cerr << "N and R must be > 0\n";
+            return 1;
+        }
+        return bench_transport(n, r);
+    }
+
+    if (mode == "policy") {
+        int n = argc > 2 ? atoi(argv[2]) : 500;
+        int r = argc > 3 ? atoi(argv[3]) : 1000000;
+        if (n <= 0 || r <= 0) {
+            cerr << "N and R must be > 0\n";
+            return 1;
+        }
+        return bench_policy(n, r);
+    }
+
+    if (mode == "spin") {
+        int r = argc > 2 ? atoi(argv[2]) : 200000;
+        if (r <= 0) {
+            cerr << "R must be > 0\n";
+            return 1;
+        }
+        return bench_spin(r);
+    }
+
+    if (mode == "placement") {
+        int mb = argc > 2 ? atoi(argv[2]) : 512;
+        if (mb <= 0) {
+            cerr << "MB must be > 0\n";
+            return 1;
+        }
+        return bench_placement(mb, 5000000);
+    }
+
+    if (mode == "exams") {
+        int n = argc > 2 ? atoi(argv[2]) : 200;
+        int e = argc > 3 ? atoi(argv[3]) : 32;
+        if (n <= 0 || e <= 0) {
+            cerr << "N and E must be > 0\n";
+            return 1;
+        }
+        return bench_exams(n, e);
+    }
+
+    if (mode == "rooms") {
+        int n = argc > 2 ? atoi(argv[2]) : 400;
+        int m = argc > 3 ? atoi(argv[3]) : 8;
+        int g = argc > 4 ? atoi(argv[4]) : 5;
+        if (n <= 0 || m <= 0 || g < 0) {
+            cerr << "N and M must be > 0, G >= 0\n";
+            return 1;
+        }
+        return bench_rooms(n, m, g);
+    }
+
+    if (mode == "attach") {
+        int n = argc > 2 ? atoi(argv[2]) : 10000;
+        if (n <= 0) {
+            cerr << "N must be > 0\n";
+            return 1;
+        }
+        raise_fd_limit();
+        return bench_attach(n);
+    }
+
+    if (mode == "slots") {
+        int p = argc > 2 ? atoi(argv[2]) : 128;
+        int r = argc > 3 ? atoi(argv[3]) : 2000;
+        if (p <= 0 || p > SLOT_RUN_MAX || r <= 0 || r >= (1 << 20)) {
+            cerr << "P must be 1.." << SLOT_RUN_MAX << ", R 1.." << (1 << 20) - 1 << "\n";
+            return 1;
+        }
+        return bench_slots(p, r);
+    }
+
+    if (mode == "shutdown") {
+        int n = argc > 2 ? atoi(argv[2]) : 10000;
+        int e = argc > 3 ? atoi(argv[3]) : 10;
+        if (n <= 0 || e <= 0 || e > n || (n + e - 1) / e > SLOT_MASK_BITS) {
+            cerr << "N and E must be > 0, E <= N, N / E <= " << SLOT_MASK_BITS << "\n";
+            return 1;
+        }
+        raise_fd_limit();
+        return bench_shutdown(n, e);
+    }
+
+    if (mode == "trace") {
+        int n = argc > 2 ? atoi(argv[2]) : 2000;
+        int r = argc > 3 ? atoi(argv[3]) : 10;
+        if (n <= 0 || r <= 0) {
+            cerr << "N and R must be > 0\n";
+            return 1;
+        }
+        return bench_trace(n, r);
+    }
+
+    if (mode == "aggregate") {
+        int mb = argc > 2 ? atoi(argv[2]) : 256;
+        if (mb <= 0) {
+            cerr << "MB must be > 0\n";
+            return 1;
+        }
+        return bench_aggregate(mb);
+    }
+
+    if (mode == "overlap") {
+        int n = argc > 2 ? atoi(argv[2]) : 400;
+        int o = argc > 3 ? atoi(argv[3]) : 64;
+        int g = argc > 4 ? atoi(argv[4]) : 50;
+        if (n <= 0 || o <= 0 || o > 1024 || g < 0) {
+            cerr << "N must be > 0, O 1..1024, G >= 0\n";
+            return 1;
+        }
+        return bench_overlap(n, o, g);
+    }
+
+    if (mode == "snapshot") {
+        int p = argc > 2 ? atoi(argv[2]) : 64;
+        int r = argc > 3 ? atoi(argv[3]) : 2000;
+        if (p <= 0 || p > SLOT_RUN_MAX || r <= 0 || r >= (1 << 20)) {
+            cerr << "P must be 1.." << SLOT_RUN_MAX << ", R 1.." << (1 << 20) - 1 << "\n";
+            return 1;
+        }
+        return bench_snapshot(p, r);
+    }
+
+    if (mode == "layout") {
+        long n = argc > 2 ? atol(argv[2]) : 1000000;
+        int t = argc > 3 ? atoi(argv[3]) : 1000;
+        if (n <= 0 || t < 0) {
+            cerr << "N must be > 0, T >= 0\n";
+            return 1;
+        }
+        return bench_layout((size_t)n, t);
+    }
+
+    if (mode == "admin") {
+        int n = argc > 2 ? atoi(argv[2]) : 2000;
+        int r = argc > 3 ? atoi(argv[3]) : 5;
+        if (n <= 0 || r <= 0) {
+            cerr << "N and R must be > 0\n";
+            return 1;
+        }
+        return bench_admin(n, r);
+    }
+
+    if (mode == "protocol") {
+        int n = argc > 2 ? atoi(argv[2]) : 2000;
+        int r = argc > 3 ? atoi(argv[3]) : 5;
+        if (n <= 0 || r <= 0) {
+            cerr << "N and R must be > 0\n";
+            return 1;
+        }
+        return bench_protocol(n, r);
+    }
+
+    if (mode == "chaos") {
+        int n = argc > 2 ? atoi(argv[2]) : 400;
+        int t = argc > 3 ? atoi(argv[3]) : 15;
+        if (n <= 0 || t <= 0) {
+            cerr << "N and T must be > 0\n";
+            return 1;
+        }
+        return bench_chaos(n, t);
+    }
+
+    if (mode == "soak") {
+        int s = argc > 2 ? atoi(argv[2]) : 60;
+        int n = argc > 3 ? atoi(argv[3]) : 200;
+        int k = argc > 4 ? atoi(argv[4]) : 10;
+        if (s <= 0 || n <= 0 || k < 0) {
+            cerr << "S and N must be > 0, K >= 0\n";
+            return 1;
+        }
+        return bench_soak(s, n, k);
+    }
+
+    usage();
+    return 1;
+}
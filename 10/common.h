@@ -1,34 +1,153 @@
 #ifndef COMMON_H
 #define COMMON_H
 
-static const char *SHM_NAME   = "/exam_shm";
-static const char *MUTEX_NAME = "/exam_mutex";
-static const char *QUEUE_NAME = "/exam_queue";
-static const char *FIFO_NAME  = "/tmp/exam_log";
+#include <cstdint>
+#include <string>
+#include <atomic>
+
+inline constexpr const char *SHM_NAME   = "/exam_shm";
+inline constexpr const char *MUTEX_NAME = "/exam_mutex";
+inline constexpr const char *QUEUE_NAME = "/exam_queue";
+inline constexpr const char *FIFO_NAME  = "/tmp/exam_log";
+// раздача дескрипторов студентам для транспортов eventfd/pipe
+inline constexpr const char *FD_SOCK_NAME = "/tmp/exam_fds";
+// управляющий сокет teacher (./examctl)
+inline constexpr const char *ADMIN_SOCK_NAME = "/tmp/exam_admin";
+
+// Несколько экзаменов на одной машине (--exam ID): к именам сегмента, семафоров,
+// FIFO и сокетов добавляется ".ID". Без --exam имена прежние.
+inline std::string &exam_id() {
+    static std::string id;
+    return id;
+}
+
+inline bool set_exam_id(const char *id) {
+    std::string s = id;
+    if (s.empty() || s.size() > 32) return false;
+    for (char c : s) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+        if (!ok) return false;
+    }
+    exam_id() = s;
+    return true;
+}
+
+inline std::string exam_name(const char *base) {
+    return exam_id().empty() ? std::string(base) : std::string(base) + "." + exam_id();
+}
+
+// Убрать "--exam ID" из argv до разбора остальных флагов; false — недопустимый ID
+inline bool take_exam_arg(int &argc, char *argv[]) {
+    int out = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--exam" && i + 1 < argc) {
+            if (!set_exam_id(argv[++i])) return false;
+            continue;
+        }
+        argv[out++] = argv[i];
+    }
+    argc = out;
+    return true;
+}
 
 enum SlotState {
     SLOT_EMPTY = 0,
     SLOT_WAITING,
     SLOT_PROCESSING,
-    SLOT_DONE,
-    SLOT_ERROR
+    SLOT_DONE,        // протокол 2: оценка в слове, слот у студента, освобождает он
+    SLOT_ERROR,       // протокол 2: студент ушёл во время проверки, слот освобождает teacher
+    SLOT_RESERVED     // студент занял слот и заполняет его, teacher его ещё не видит
 };
 
+// Переходы состояния — CAS по слову word (slot_table.h):
+// EMPTY -> RESERVED -> WAITING (студент), WAITING -> PROCESSING -> EMPTY (teacher),
+// WAITING -> EMPTY (студент уходит, не дождавшись). Кто выиграл CAS, тот владеет слотом.
+// Протокол 2: PROCESSING -> DONE (teacher, оценка в слове) -> EMPTY (студент).
+// Каждый переход увеличивает номер в старших битах слова: по нему читатели без lock
+// отличают согласованный снимок от прочитанного во время перехода (table_snapshot).
+// 16 байт, четыре слота в строке кэша. Нули — пустой слот: сегмент создаётся заново
+// и обнуляется ядром при первом обращении к странице, цикла инициализации нет.
+// pid/ticket/grade_ms студент пишет до публикации, grade — teacher до post_grade.
+// Имена семафоров слота не хранятся, а выводятся из номера (NamedSemTransport::slot_sem_name).
 struct StudentSlot {
+    std::atomic<uint32_t> word;   // SlotState в битах 0..2, оценка (DONE) в 3..7, номер перехода — в старших 24
     pid_t pid;
-    int ticket;
-    int grade;
-    SlotState state;
+    int32_t grade_ms;         // время проверки, заданное студентом (replay); -1 — решает teacher
+    int16_t ticket;           // 1..100
+    int8_t grade;             // 3..5, -1 — экзамен завершён без оценки
+    uint8_t reserved;
+};
+
+static_assert(sizeof(StudentSlot) == 16, "compact slot layout");
+
+inline int slot_state_of(uint32_t w) {
+    return (int)(w & 0x7);
+}
 
-    char grade_sem_name[64];
-    char ack_sem_name[64];
+inline int slot_grade_of(uint32_t w) {
+    return (int)(w >> 3 & 0x1F);
+}
+
+// битовые маски слотов рассчитаны на максимальную вместимость teacher
+static const int SLOT_MASK_BITS = 1024;
+static const int SLOT_MASK_WORDS = SLOT_MASK_BITS / 64;
+
+// Число студентов в слотах: счётчик разбит на части по строке кэша, часть = слот % ACTIVE_SHARDS
+static const int ACTIVE_SHARDS = 16;
+
+struct alignas(64) ActiveShard {
+    std::atomic<long> value;
+};
+
+// Заголовок сегмента: студент подключается, только если magic, версия раскладки и размеры
+// совпадают с его сборкой. magic teacher пишет последним, после инициализации сегмента.
+// Версия 2: pid владельца (owner)
+static const uint32_t SEGMENT_MAGIC = 0x4D415845;   // "EXAM"
+static const uint16_t SEGMENT_VERSION = 2;
+
+// Протокол передачи оценки. 1: grade и ack через транспорт, слот освобождает teacher
+// после ack. 2: оценка в слове слота, одно пробуждение студента, ack нет (slot_hand_back)
+enum GradeProtocol {
+    PROTO_V1 = 1,
+    PROTO_V2 = 2
 };
 
 struct SharedData {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t protocol;    // GradeProtocol
+    uint32_t header_size; // sizeof(SharedData)
+    uint32_t slot_size;   // sizeof(StudentSlot)
+    pid_t owner;          // teacher: по нему reclaim.h отличает сегмент упавшего teacher
     int capacity;
     bool shutdown;
-    int active_students;
+    // увеличивается при завершении экзамена; студенты futex ждут оценку и это слово вместе
+    uint32_t shutdown_gen;
+    int transport;        // TransportKind, выбирается teacher
+    size_t sync_offset;   // смещение области транспорта от начала сегмента
+    int spin;             // опрос перед futex для grade/ack: 0, бюджет или -1 (адаптивный)
+    int rooms;            // 0 — одна общая очередь, иначе число комнат (rooms.h)
+    int route;            // RouteKind: как студент выбирает комнату
+    size_t rooms_offset;  // смещение массива Room от начала сегмента
+    int trace;            // 1 — teacher и студенты пишут интервалы в TRACE_NAME (trace.h)
+    int record;           // 1 — запись нагрузки в RECORD_NAME (replay.h)
+    int closed;           // 1 — приём закрыт (examctl drain): новые студенты уходят
+    // бит i — слот i, возможно, свободен / ждёт проверки. Подсказки для поиска:
+    // владение слотом решает только CAS по state
+    unsigned long long free_mask[SLOT_MASK_WORDS];
+    unsigned long long wait_mask[SLOT_MASK_WORDS];
+    ActiveShard active[ACTIVE_SHARDS];
     StudentSlot slots[];
 };
 
+inline void active_add(SharedData *shm, int slot, long delta) {
+    shm->active[slot % ACTIVE_SHARDS].value.fetch_add(delta, std::memory_order_relaxed);
+}
+
+inline long active_students(SharedData *shm) {
+    long sum = 0;
+    for (int i = 0; i < ACTIVE_SHARDS; ++i) sum += shm->active[i].value.load(std::memory_order_relaxed);
+    return sum;
+}
+
 #endif // COMMON_H
\ No newline at end of file
@@ -0,0 +1,402 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <map>
+#include <utility>
+#include <ctime>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <linux/io_uring.h>
+
+// Цикл событий преподавателя (teacher --loop uring|epoll).
+// Операции: чтение eventfd по готовности (watch), готовность fd без чтения (poll: signalfd,
+// каналы fd-транспорта), одноразовые таймеры (сколько угодно одновременно) и запись лога.
+// Записи копятся за итерацию и уходят одной пачкой: в io_uring — вместе с остальными
+// заявками одним io_uring_enter, в epoll — одним write на дескриптор.
+// Если io_uring недоступен (старое ядро, seccomp), используется epoll.
+// Короткая запись дописывается; полный FIFO (EAGAIN) и ошибки записи теряют строки,
+// их объём копится в write_lost. Ошибка чтения или poll, кроме прерывания, возвращается
+// из wait как -1 с errno: иначе заявка не перевзводится и цикл молча перестаёт её видеть.
+
+enum LoopBackend {
+    LOOP_EPOLL = 0,
+    LOOP_URING
+};
+
+struct LoopEvent {
+    uint64_t tag;     // ненулевой, меньше 2^32
+    uint64_t value;   // для fd — прочитанное значение eventfd
+};
+
+struct EventLoop {
+    LoopBackend backend = LOOP_EPOLL;
+    uint64_t syscalls = 0;
+    uint64_t write_lost = 0;   // байты, не дошедшие до получателя
+    int write_errno = 0;       // первая ошибка записи
+
+    // записи: накопленные данные и признак записи «в полёте» (для io_uring)
+    struct Pending {
+        std::string buf;
+        std::string inflight;
+        bool busy = false;
+    };
+    std::map<int, Pending> writes;
+
+    // epoll: таймеры в порядке срока, timerfd взведён на ближайший
+    int epfd = -1;
+    int timer_fd = -1;
+    std::multimap<uint64_t, uint64_t> timers;   // срок (нс, CLOCK_MONOTONIC) -> tag
+
+    // io_uring
+    int ring_fd = -1;
+    void *sq_ptr = nullptr, *cq_ptr = nullptr;
+    size_t sq_size = 0, cq_size = 0, sqes_size = 0;
+    unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+    unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+    unsigned sq_entries = 0;
+    io_uring_sqe *sqes = nullptr;
+    io_uring_cqe *cqes = nullptr;
+    unsigned to_submit = 0;
+    std::map<uint64_t, uint64_t> read_bufs;
+    std::map<uint64_t, __kernel_timespec> timeouts;   // до завершения таймера с этим tag
+    std::map<uint64_t, std::pair<int, bool>> armed;    // tag -> (fd, poll_only), для перевзвода
+    int failed = 0;                                    // ошибка заявки, вернуть из следующего wait
+
+    static const uint64_t WRITE_TAG = 1ull << 63;
+    // epoll: событие готовности без чтения fd (poll)
+    static const uint64_t POLL_ONLY = 1ull << 62;
+
+    bool init(LoopBackend want) {
+        if (want == LOOP_URING && uring_init(64)) {
+            backend = LOOP_URING;
+            return true;
+        }
+        backend = LOOP_EPOLL;
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (epfd < 0 || timer_fd < 0) return false;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = 0;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, timer_fd, &ev);
+        return true;
+    }
+
+    const char *name() const { return backend == LOOP_URING ? "io_uring" : "epoll"; }
+
+    // Одно событие, когда fd станет читаемым (eventfd прочитывается целиком)
+    void watch(int fd, uint64_t tag) {
+        arm_fd(fd, tag, false);
+    }
+
+    // Одно событие готовности fd на чтение; данные читает вызывающий
+    void poll(int fd, uint64_t tag) {
+        arm_fd(fd, tag, true);
+    }
+
+    void arm_fd(int fd, uint64_t tag, bool poll_only) {
+        if (backend == LOOP_URING) armed[tag] = {fd, poll_only};
+        if (backend == LOOP_URING && poll_only) {
+            io_uring_sqe *sqe = get_sqe();
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = fd;
+            sqe->poll32_events = POLLIN;
+            sqe->user_data = tag;
+            return;
+        }
+        if (backend == LOOP_URING) {
+            io_uring_sqe *sqe = get_sqe();
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)&read_bufs[tag];
+            sqe->len = sizeof(uint64_t);
+            sqe->user_data = tag;
+            return;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.u64 = tag | ((uint64_t)(uint32_t)fd << 32) | (poll_only ? POLL_ONLY : 0);
+        syscalls++;
+        if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) < 0 && errno == ENOENT) {
+            syscalls++;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    // Одноразовый таймер через ms; tag взведённых одновременно таймеров должны различаться
+    void timer(uint64_t tag, int ms) {
+        if (backend == LOOP_URING) {
+            __kernel_timespec &ts = timeouts[tag];
+            ts.tv_sec = ms / 1000;
+            ts.tv_nsec = (ms % 1000) * 1000000L;
+            io_uring_sqe *sqe = get_sqe();
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->addr = (uint64_t)&ts;
+            sqe->len = 1;
+            sqe->user_data = tag;
+            return;
+        }
+        uint64_t at = mono_ns() + (uint64_t)ms * 1000000ull;
+        bool earliest = timers.empty() || at < timers.begin()->first;
+        timers.insert({at, tag});
+        if (earliest) arm_timerfd();
+    }
+
+    static uint64_t mono_ns() {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    // timerfd на ближайший срок (уже прошедший срок сработает сразу)
+    void arm_timerfd() {
+        itimerspec its{};
+        if (!timers.empty()) {
+            uint64_t at = timers.begin()->first;
+            its.it_value.tv_sec = at / 1000000000ull;
+            its.it_value.tv_nsec = at % 1000000000ull;
+            if (at == 0) its.it_value.tv_nsec = 1;
+        }
+        syscalls++;
+        timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, nullptr);
+    }
+
+    void write(int fd, const std::string &s) {
+        writes[fd].buf += s;
+    }
+
+    void write_failed(size_t n, int err) {
+        write_lost += n;
+        if (!write_errno) write_errno = err;
+    }
+
+    // Записать буфер сразу (epoll и выход): короткая запись дописывается
+    void write_now(int fd, std::string &buf) {
+        size_t done = 0;
+        while (done < buf.size()) {
+            syscalls++;
+            ssize_t w = ::write(fd, buf.data() + done, buf.size() - done);
+            if (w > 0) {
+                done += (size_t)w;
+                continue;
+            }
+            if (w < 0 && errno == EINTR) continue;
+            write_failed(buf.size() - done, w < 0 ? errno : EIO);
+            break;
+        }
+        buf.clear();
+    }
+
+    // Отправить накопленное и дождаться хотя бы одного события
+    int wait(LoopEvent *out, int max) {
+        if (backend == LOOP_URING) return uring_wait(out, max);
+
+        for (auto &kv : writes) {
+            if (!kv.second.buf.empty()) write_now(kv.first, kv.second.buf);
+        }
+
+        epoll_event evs[16];
+        syscalls++;
+        int n = epoll_wait(epfd, evs, max < 16 ? max : 16, -1);
+        if (n < 0) return errno == EINTR ? 0 : -1;
+        int k = 0;
+        for (int i = 0; i < n; ++i) {
+            uint64_t value = 0;
+            if (evs[i].data.u64 == 0) {
+                syscalls++;
+                ::read(timer_fd, &value, sizeof(value));
+                // все истёкшие таймеры; не поместившиеся в out сработают на следующей итерации
+                uint64_t now = mono_ns();
+                while (!timers.empty() && timers.begin()->first <= now && k < max - (n - i - 1)) {
+                    out[k++] = LoopEvent{timers.begin()->second, 1};
+                    timers.erase(timers.begin());
+                }
+                arm_timerfd();
+            } else if (evs[i].data.u64 & POLL_ONLY) {
+                out[k++] = LoopEvent{evs[i].data.u64 & 0xFFFFFFFFu, 1};
+            } else {
+                int fd = (int)(evs[i].data.u64 >> 32);
+                syscalls++;
+                ::read(fd, &value, sizeof(value));
+                out[k++] = LoopEvent{evs[i].data.u64 & 0xFFFFFFFFu, value};
+            }
+        }
+        return k;
+    }
+
+    // Дописать то, что ещё не ушло (при выходе)
+    void drain() {
+        for (auto &kv : writes) {
+            Pending &p = kv.second;
+            // запись в полёте завершится сама, её данные ещё в inflight
+            if (!p.buf.empty()) write_now(kv.first, p.buf);
+        }
+    }
+
+    void close_all() {
+        drain();
+        if (backend == LOOP_URING) {
+            if (sqes) munmap(sqes, sqes_size);
+            if (cq_ptr && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+            if (sq_ptr) munmap(sq_ptr, sq_size);
+            if (ring_fd >= 0) close(ring_fd);
+        } else {
+            if (timer_fd >= 0) close(timer_fd);
+            if (epfd >= 0) close(epfd);
+        }
+    }
+
+private:
+    bool uring_init(unsigned entries) {
+        io_uring_params p{};
+        ring_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (ring_fd < 0) return false;
+
+        sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            if (cq_size > sq_size) sq_size = cq_size;
+            cq_size = sq_size;
+        }
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) {
+            sq_ptr = nullptr;
+            close(ring_fd);
+            ring_fd = -1;
+            return false;
+        }
+        cq_ptr = sq_ptr;
+        if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+            cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if (cq_ptr == MAP_FAILED) {
+                cq_ptr = nullptr;
+                munmap(sq_ptr, sq_size);
+                close(ring_fd);
+                ring_fd = -1;
+                return false;
+            }
+        }
+        sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        void *s = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) {
+            if (cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+            munmap(sq_ptr, sq_size);
+            close(ring_fd);
+            ring_fd = -1;
+            return false;
+        }
+        sqes = (io_uring_sqe *)s;
+
+        char *sq = (char *)sq_ptr, *cq = (char *)cq_ptr;
+        sq_head = (unsigned *)(sq + p.sq_off.head);
+        sq_tail = (unsigned *)(sq + p.sq_off.tail);
+        sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+        sq_array = (unsigned *)(sq + p.sq_off.array);
+        sq_entries = p.sq_entries;
+        cq_head = (unsigned *)(cq + p.cq_off.head);
+        cq_tail = (unsigned *)(cq + p.cq_off.tail);
+        cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    int enter(unsigned submit, unsigned min_complete) {
+        syscalls++;
+        int r = (int)syscall(__NR_io_uring_enter, ring_fd, submit, min_complete,
+                             min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (r >= 0) to_submit -= (unsigned)r < submit ? (unsigned)r : submit;
+        return r;
+    }
+
+    io_uring_sqe *get_sqe() {
+        unsigned tail = *sq_tail;
+        if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) enter(to_submit, 0);
+        unsigned idx = tail & *sq_mask;
+        io_uring_sqe *sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array[idx] = idx;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        to_submit++;
+        return sqe;
+    }
+
+    // Не больше одной записи «в полёте» на fd, чтобы строки лога не перемешивались
+    void queue_writes() {
+        for (auto &kv : writes) {
+            Pending &p = kv.second;
+            if (p.busy || p.buf.empty()) continue;
+            p.inflight.swap(p.buf);
+            p.buf.clear();
+            p.busy = true;
+            io_uring_sqe *sqe = get_sqe();
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = kv.first;
+            sqe->addr = (uint64_t)p.inflight.data();
+            sqe->len = (uint32_t)p.inflight.size();
+            sqe->off = (uint64_t)-1;
+            sqe->user_data = WRITE_TAG | (uint32_t)kv.first;
+        }
+    }
+
+    int uring_wait(LoopEvent *out, int max) {
+        if (failed) {
+            errno = failed;
+            failed = 0;
+            return -1;
+        }
+        int k = 0;
+        while (k == 0 && !failed) {
+            queue_writes();
+            int r = enter(to_submit, 1);
+            if (r < 0 && errno != EINTR && errno != EBUSY) return -1;
+            bool interrupted = r < 0 && errno == EINTR;
+
+            unsigned head = *cq_head;
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail && k < max; ++head) {
+                io_uring_cqe *cqe = &cqes[head & *cq_mask];
+                uint64_t tag = cqe->user_data;
+                int res = cqe->res;
+                if (tag & WRITE_TAG) {
+                    Pending &p = writes[(int)(uint32_t)tag];
+                    p.busy = false;
+                    // недописанный остаток уходит первым в следующей пачке
+                    if (res > 0 && (size_t)res < p.inflight.size()) p.buf.insert(0, p.inflight, (size_t)res);
+                    else if (res == -EINTR) p.buf.insert(0, p.inflight);
+                    else if (res <= 0) write_failed(p.inflight.size(), res < 0 ? -res : EIO);
+                    p.inflight.clear();
+                } else if (timeouts.count(tag)) {
+                    timeouts.erase(tag);
+                    out[k++] = LoopEvent{tag, 1};
+                } else if (res >= 0) {
+                    armed.erase(tag);
+                    uint64_t value = read_bufs.count(tag) ? read_bufs[tag] : 0;
+                    out[k++] = LoopEvent{tag, value};
+                } else if ((res == -EINTR || res == -EAGAIN || res == -ECANCELED) && armed.count(tag)) {
+                    std::pair<int, bool> a = armed[tag];
+                    arm_fd(a.first, tag, a.second);
+                } else if (!failed) {
+                    failed = -res;
+                }
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            if (interrupted) break;
+        }
+        if (k == 0 && failed) {
+            errno = failed;
+            failed = 0;
+            return -1;
+        }
+        return k;
+    }
+};
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "common.h"
+
+using namespace std;
+
+// Клиент управляющего сокета teacher: отправляет одну команду и печатает ответ.
+//   ./examctl stats | slots | pause | resume | drain | set grade-ms N | set log quiet | set capacity N
+
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: ./examctl [--exam ID] stats|slots|pause|resume|drain|help\n"
+                        "       ./examctl [--exam ID] set grade-ms N|random|default\n"
+                        "       ./examctl [--exam ID] set log quiet|normal\n"
+                        "       ./examctl [--exam ID] set capacity N\n";
+    if (!take_exam_arg(argc, argv) || argc < 2) {
+        cerr << usage;
+        return 1;
+    }
+
+    string cmd;
+    for (int i = 1; i < argc; ++i) {
+        if (i > 1) cmd += " ";
+        cmd += argv[i];
+    }
+    cmd += "\n";
+
+    int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, exam_name(ADMIN_SOCK_NAME).c_str(), sizeof(addr.sun_path) - 1);
+    if (s < 0 || connect(s, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror(addr.sun_path);
+        return 1;
+    }
+    if (send(s, cmd.data(), cmd.size(), MSG_NOSIGNAL) != (ssize_t)cmd.size()) {
+        perror("send");
+        close(s);
+        return 1;
+    }
+
+    string reply;
+    char buf[512];
+    ssize_t r;
+    while ((r = read(s, buf, sizeof(buf))) > 0) reply.append(buf, r);
+    close(s);
+
+    cout << reply;
+    return reply.compare(0, 6, "error:") == 0 ? 1 : 0;
+}
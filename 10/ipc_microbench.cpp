@@ -0,0 +1,569 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#include "transport.h"
+
+using namespace std;
+
+// Микробенчмарк примитивов IPC, из которых собраны транспорты (transport.h), и альтернатив:
+//   pingpong — round trip между двумя процессами: named/unnamed sem_t, futex (FSem), eventfd,
+//              pipe, FIFO, Unix socket; p50/p99/среднее и round trip/с
+//   stream   — поток сообщений в одну сторону без ожидания ответа: сообщений/с
+//   mutex    — захват и освобождение mutex_sem (named sem_t, как NamedSemTransport) и
+//              futex-семафора на 1..64 конкурирующих процессах
+//   scan     — поиск свободного слота: линейный обход состояний (4-6/exam.cpp, GenericSlots)
+//              и по битовой маске (slot_claim) при вместимости 16..1M
+// Каждый замер — без привязки к CPU и с привязкой (pinned: процессы по CPU из маски по кругу).
+// Вывод — CSV (по умолчанию) или JSON.
+
+static const char *MB_SEM_NAME = "/ipc_mb_sem";
+static const char *MB_FIFO_NAME = "/tmp/ipc_mb_fifo";
+
+uint64_t now_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// ---------- привязка к CPU ----------
+
+vector<int> allowed_cpus;
+
+void pin_to(int k) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(allowed_cpus[k % allowed_cpus.size()], &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+void unpin() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : allowed_cpus) CPU_SET(c, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+// ---------- вывод ----------
+
+struct Row {
+    string bench;
+    string primitive;
+    bool pinned;
+    int procs;
+    long capacity;
+    long iters;
+    double p50_ns, p99_ns, mean_ns, ops_s;
+};
+
+vector<Row> rows;
+bool json = false;
+
+void emit(const Row &r) {
+    rows.push_back(r);
+    if (json) return;
+    printf("%s,%s,%d,%d,%ld,%ld,%.0f,%.0f,%.1f,%.0f\n", r.bench.c_str(), r.primitive.c_str(), r.pinned ? 1 : 0,
+           r.procs, r.capacity, r.iters, r.p50_ns, r.p99_ns, r.mean_ns, r.ops_s);
+    fflush(stdout);
+}
+
+void print_json() {
+    printf("[\n");
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const Row &r = rows[i];
+        printf("  {\"bench\":\"%s\",\"primitive\":\"%s\",\"pinned\":%s,\"procs\":%d,\"capacity\":%ld,\"iters\":%ld,"
+               "\"p50_ns\":%.0f,\"p99_ns\":%.0f,\"mean_ns\":%.1f,\"ops_s\":%.0f}%s\n",
+               r.bench.c_str(), r.primitive.c_str(), r.pinned ? "true" : "false", r.procs, r.capacity, r.iters,
+               r.p50_ns, r.p99_ns, r.mean_ns, r.ops_s, i + 1 < rows.size() ? "," : "");
+    }
+    printf("]\n");
+}
+
+double pct(vector<uint32_t> &v, double p) {
+    if (v.empty()) return 0;
+    size_t i = (size_t)(p * (v.size() - 1));
+    nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+void *shared_alloc(size_t size) {
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        return nullptr;
+    }
+    memset(p, 0, size);
+    return p;
+}
+
+// ---------- каналы: два направления, post(d) будит ждущего в wait(d) ----------
+
+struct Chan {
+    virtual ~Chan() {}
+    virtual const char *name() const = 0;
+    virtual bool open() = 0;
+    virtual void post(int d) = 0;
+    virtual void wait(int d) = 0;
+};
+
+struct NamedSemChan final : Chan {
+    sem_t *s[2] = {};
+    const char *name() const override { return "named_sem"; }
+    bool open() override {
+        for (int d = 0; d < 2; ++d) {
+            string n = string(MB_SEM_NAME) + to_string(d);
+            sem_unlink(n.c_str());
+            s[d] = sem_open(n.c_str(), O_CREAT | O_EXCL, 0600, 0);
+            if (s[d] == SEM_FAILED) {
+                perror("sem_open");
+                return false;
+            }
+            // отображение наследуется через fork, имя больше не нужно
+            sem_unlink(n.c_str());
+        }
+        return true;
+    }
+    void post(int d) override { sem_post(s[d]); }
+    void wait(int d) override {
+        while (sem_wait(s[d]) == -1 && errno == EINTR) {}
+    }
+    ~NamedSemChan() {
+        for (sem_t *x : s) {
+            if (x && x != SEM_FAILED) sem_close(x);
+        }
+    }
+};
+
+struct UnnamedSemChan final : Chan {
+    sem_t *s = nullptr;
+    const char *name() const override { return "unnamed_sem"; }
+    bool open() override {
+        s = (sem_t *)shared_alloc(2 * sizeof(sem_t));
+        if (!s) return false;
+        return sem_init(&s[0], 1, 0) == 0 && sem_init(&s[1], 1, 0) == 0;
+    }
+    void post(int d) override { sem_post(&s[d]); }
+    void wait(int d) override {
+        while (sem_wait(&s[d]) == -1 && errno == EINTR) {}
+    }
+    ~UnnamedSemChan() {
+        if (s) munmap(s, 2 * sizeof(sem_t));
+    }
+};
+
+struct FutexChan final : Chan {
+    FSem *s = nullptr;
+    const char *name() const override { return "futex"; }
+    bool open() override {
+        s = (FSem *)shared_alloc(2 * sizeof(FSem));
+        return s != nullptr;
+    }
+    void post(int d) override { fsem_post(&s[d]); }
+    void wait(int d) override { fsem_wait(&s[d], -1); }
+    ~FutexChan() {
+        if (s) munmap(s, 2 * sizeof(FSem));
+    }
+};
+
+// Каналы на дескрипторах: направление d — пара (rd[d], wr[d]), сообщение msg байт
+struct FdChan : Chan {
+    int rd[2] = {-1, -1}, wr[2] = {-1, -1};
+    size_t msg = 1;
+    void post(int d) override {
+        uint64_t v = 1;
+        while (write(wr[d], &v, msg) == -1 && errno == EINTR) {}
+    }
+    void wait(int d) override {
+        uint64_t v;
+        while (read(rd[d], &v, msg) == -1 && errno == EINTR) {}
+    }
+    ~FdChan() {
+        for (int d = 0; d < 2; ++d) {
+            if (rd[d] >= 0) close(rd[d]);
+            if (wr[d] >= 0 && wr[d] != rd[d]) close(wr[d]);
+        }
+    }
+};
+
+struct EventfdChan final : FdChan {
+    const char *name() const override { return "eventfd"; }
+    bool open() override {
+        msg = sizeof(uint64_t);
+        for (int d = 0; d < 2; ++d) {
+            // EFD_SEMAPHORE: каждое чтение забирает одно сообщение, как sem_wait
+            rd[d] = wr[d] = eventfd(0, EFD_SEMAPHORE | EFD_CLOEXEC);
+            if (rd[d] < 0) {
+                perror("eventfd");
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct PipeChan final : FdChan {
+    const char *name() const override { return "pipe"; }
+    bool open() override {
+        for (int d = 0; d < 2; ++d) {
+            int p[2];
+            if (pipe2(p, O_CLOEXEC) == -1) {
+                perror("pipe");
+                return false;
+            }
+            rd[d] = p[0];
+            wr[d] = p[1];
+        }
+        return true;
+    }
+};
+
+struct FifoChan final : FdChan {
+    const char *name() const override { return "fifo"; }
+    bool open() override {
+        for (int d = 0; d < 2; ++d) {
+            string n = string(MB_FIFO_NAME) + to_string(d);
+            unlink(n.c_str());
+            if (mkfifo(n.c_str(), 0600) == -1) {
+                perror("mkfifo");
+                return false;
+            }
+            // O_RDWR не блокируется в open (Linux); дескрипторы наследуются через fork
+            rd[d] = wr[d] = ::open(n.c_str(), O_RDWR | O_CLOEXEC);
+            unlink(n.c_str());
+            if (rd[d] < 0) {
+                perror("open fifo");
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct UnixChan final : FdChan {
+    const char *name() const override { return "unix_stream"; }
+    bool open() override {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+            perror("socketpair");
+            return false;
+        }
+        // направление 0: родитель пишет в sv[0], ребёнок читает из sv[1]; 1 — наоборот
+        wr[0] = sv[0];
+        rd[0] = sv[1];
+        wr[1] = sv[1];
+        rd[1] = sv[0];
+        return true;
+    }
+    ~UnixChan() {
+        close(wr[0]);
+        close(wr[1]);
+        rd[0] = rd[1] = wr[0] = wr[1] = -1;
+    }
+};
+
+Chan *make_chan(int k) {
+    switch (k) {
+        case 0: return new NamedSemChan;
+        case 1: return new UnnamedSemChan;
+        case 2: return new FutexChan;
+        case 3: return new EventfdChan;
+        case 4: return new PipeChan;
+        case 5: return new FifoChan;
+        case 6: return new UnixChan;
+    }
+    return nullptr;
+}
+
+static const int CHAN_COUNT = 7;
+
+// Round trip: родитель post(0) -> ребёнок wait(0), post(1) -> родитель wait(1)
+void bench_pingpong(Chan &c, long iters, bool pinned) {
+    pid_t child = fork();
+    if (child == 0) {
+        if (pinned) pin_to(1);
+        for (long i = 0; i < iters + iters / 10; ++i) {
+            c.wait(0);
+            c.post(1);
+        }
+        _exit(0);
+    }
+    if (pinned) pin_to(0);
+    // прогрев: первые 10% не учитываются
+    for (long i = 0; i < iters / 10; ++i) {
+        c.post(0);
+        c.wait(1);
+    }
+    vector<uint32_t> lat(iters);
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; ++i) {
+        uint64_t a = now_ns();
+        c.post(0);
+        c.wait(1);
+        lat[i] = (uint32_t)min<uint64_t>(now_ns() - a, UINT32_MAX);
+    }
+    double total = (double)(now_ns() - t0);
+    waitpid(child, nullptr, 0);
+    if (pinned) unpin();
+    double p50 = pct(lat, 0.5), p99 = pct(lat, 0.99);
+    emit(Row{"pingpong", c.name(), pinned, 2, 0, iters, p50, p99, total / iters, iters / (total / 1e9)});
+}
+
+// Поток: родитель post(0) iters раз подряд, ребёнок забирает все и отвечает одним post(1)
+void bench_stream(Chan &c, long iters, bool pinned) {
+    pid_t child = fork();
+    if (child == 0) {
+        if (pinned) pin_to(1);
+        for (long i = 0; i < iters; ++i) c.wait(0);
+        c.post(1);
+        _exit(0);
+    }
+    if (pinned) pin_to(0);
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; ++i) c.post(0);
+    c.wait(1);
+    double total = (double)(now_ns() - t0);
+    waitpid(child, nullptr, 0);
+    if (pinned) unpin();
+    emit(Row{"stream", c.name(), pinned, 2, 0, iters, 0, 0, total / iters, iters / (total / 1e9)});
+}
+
+// ---------- mutex под конкуренцией ----------
+
+struct MutexShared {
+    FSem futex_lock;
+    long counter;
+    std::atomic<int> ready;
+    std::atomic<int> go;
+    uint32_t p50[64];
+    uint32_t p99[64];
+};
+
+// procs процессов по iters захватов; в критической секции — инкремент общего счётчика.
+// Задержка пары захват+освобождение: медиана p50 по процессам и худший p99
+bool bench_mutex(bool futex, int procs, long iters, bool pinned) {
+    MutexShared *ms = (MutexShared *)shared_alloc(sizeof(MutexShared));
+    if (!ms) return false;
+    ms->futex_lock.count = 1;
+    sem_t *named = nullptr;
+    if (!futex) {
+        sem_unlink(MB_SEM_NAME);
+        named = sem_open(MB_SEM_NAME, O_CREAT | O_EXCL, 0600, 1);
+        if (named == SEM_FAILED) {
+            perror("sem_open");
+            munmap(ms, sizeof(MutexShared));
+            return false;
+        }
+        sem_unlink(MB_SEM_NAME);
+    }
+
+    vector<pid_t> kids;
+    for (int p = 0; p < procs; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            if (pinned) pin_to(p);
+            vector<uint32_t> lat(iters);
+            ms->ready.fetch_add(1);
+            while (ms->go.load() == 0) sched_yield();
+            for (long i = 0; i < iters; ++i) {
+                uint64_t a = now_ns();
+                if (futex) {
+                    fsem_wait(&ms->futex_lock, -1);
+                } else {
+                    while (sem_wait(named) == -1 && errno == EINTR) {}
+                }
+                ms->counter++;
+                if (futex) fsem_post(&ms->futex_lock);
+                else sem_post(named);
+                lat[i] = (uint32_t)min<uint64_t>(now_ns() - a, UINT32_MAX);
+            }
+            ms->p50[p] = (uint32_t)pct(lat, 0.5);
+            ms->p99[p] = (uint32_t)pct(lat, 0.99);
+            _exit(0);
+        }
+        kids.push_back(pid);
+    }
+    while (ms->ready.load() < procs) sched_yield();
+    uint64_t t0 = now_ns();
+    ms->go.store(1);
+    for (pid_t k : kids) waitpid(k, nullptr, 0);
+    double total = (double)(now_ns() - t0);
+
+    long ops = (long)procs * iters;
+    bool ok = ms->counter == ops;
+    vector<uint32_t> p50(ms->p50, ms->p50 + procs);
+    double worst = *max_element(ms->p99, ms->p99 + procs);
+    emit(Row{"mutex", futex ? "futex" : "named_sem", pinned, procs, 0, ops, pct(p50, 0.5), worst, total / ops,
+             ops / (total / 1e9)});
+    if (!ok) fprintf(stderr, "mutex %s procs=%d: counter %ld != %ld\n", futex ? "futex" : "named_sem", procs,
+                     ms->counter, ops);
+    if (named) sem_close(named);
+    munmap(ms, sizeof(MutexShared));
+    return ok;
+}
+
+// ---------- поиск слота ----------
+
+// Линейный обход: первый слот со state == EMPTY, занять CAS (как GenericSlots::scan)
+int scan_linear(std::atomic<int> *state, long cap) {
+    for (long i = 0; i < cap; ++i) {
+        int from = SLOT_EMPTY;
+        if (state[i].load(std::memory_order_relaxed) == SLOT_EMPTY
+            && state[i].compare_exchange_strong(from, SLOT_RESERVED, std::memory_order_acq_rel)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// По маске свободных: первое ненулевое слово, ctz, CAS, снять бит (как slot_claim)
+int scan_mask(std::atomic<int> *state, unsigned long long *mask, long cap) {
+    long words = (cap + 63) / 64;
+    for (long w = 0; w < words; ++w) {
+        unsigned long long bits = __atomic_load_n(&mask[w], __ATOMIC_ACQUIRE);
+        while (bits) {
+            int i = (int)(w * 64 + __builtin_ctzll(bits));
+            int from = SLOT_EMPTY;
+            if (state[i].compare_exchange_strong(from, SLOT_RESERVED, std::memory_order_acq_rel)) {
+                __atomic_fetch_and(&mask[w], ~(1ull << (i & 63)), __ATOMIC_RELAXED);
+                return i;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return -1;
+}
+
+// Все слоты заняты, кроме одного; на каждом шаге свободный слот занимается, а случайный
+// другой освобождается — свободный слот в среднем посередине таблицы
+void bench_scan(bool use_mask, long cap, bool pinned) {
+    if (pinned) pin_to(0);
+    long iters = max(200L, min(1000000L, 50000000L / cap));
+    vector<std::atomic<int>> state(cap);
+    vector<unsigned long long> mask((cap + 63) / 64, 0);
+    for (long i = 0; i < cap; ++i) state[i].store(SLOT_WAITING, std::memory_order_relaxed);
+    mt19937_64 rng(cap);
+    vector<int> next(iters);
+    for (long i = 0; i < iters; ++i) next[i] = (int)(rng() % cap);
+    int free_slot = next[0];
+    state[free_slot].store(SLOT_EMPTY);
+    mask[free_slot >> 6] |= 1ull << (free_slot & 63);
+
+    vector<uint32_t> lat(iters);
+    uint64_t t0 = now_ns();
+    long found = 0;
+    for (long i = 0; i < iters; ++i) {
+        uint64_t a = now_ns();
+        int got = use_mask ? scan_mask(state.data(), mask.data(), cap) : scan_linear(state.data(), cap);
+        lat[i] = (uint32_t)min<uint64_t>(now_ns() - a, UINT32_MAX);
+        if (got >= 0) {
+            found++;
+            state[got].store(SLOT_WAITING, std::memory_order_relaxed);
+        }
+        // освободить другой слот (не только что занятый)
+        int r = next[i] == got ? (got + 1) % cap : next[i];
+        state[r].store(SLOT_EMPTY, std::memory_order_release);
+        __atomic_fetch_or(&mask[r >> 6], 1ull << (r & 63), __ATOMIC_RELEASE);
+    }
+    double total = (double)(now_ns() - t0);
+    if (pinned) unpin();
+    if (found != iters) fprintf(stderr, "scan cap=%ld: found %ld of %ld\n", cap, found, iters);
+    double p50 = pct(lat, 0.5), p99 = pct(lat, 0.99);
+    emit(Row{"scan", use_mask ? "mask" : "linear", pinned, 1, cap, iters, p50, p99, total / iters,
+             iters / (total / 1e9)});
+}
+
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: ./ipc_microbench [--iters N] [--max-procs P] [--max-capacity C]\n"
+                        "                        [--only pingpong|stream|mutex|scan] [--pinned|--unpinned] [--json]\n";
+    long iters = 100000;
+    int max_procs = 64;
+    long max_cap = 1 << 20;
+    string only;
+    int variants = 3;   // бит 0 — без привязки, бит 1 — с привязкой
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        if (a == "--iters" && i + 1 < argc) {
+            iters = atol(argv[++i]);
+        } else if (a == "--max-procs" && i + 1 < argc) {
+            max_procs = atoi(argv[++i]);
+        } else if (a == "--max-capacity" && i + 1 < argc) {
+            max_cap = atol(argv[++i]);
+        } else if (a == "--only" && i + 1 < argc) {
+            only = argv[++i];
+            if (only != "pingpong" && only != "stream" && only != "mutex" && only != "scan") {
+                cerr << usage;
+                return 1;
+            }
+        } else if (a == "--pinned") {
+            variants = 2;
+        } else if (a == "--unpinned") {
+            variants = 1;
+        } else if (a == "--json") {
+            json = true;
+        } else {
+            cerr << usage;
+            return 1;
+        }
+    }
+    if (iters < 10 || max_procs < 1 || max_procs > 64 || max_cap < 16) {
+        cerr << "Iters must be >= 10, max procs 1..64, max capacity >= 16\n";
+        return 1;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c, &set)) allowed_cpus.push_back(c);
+    }
+    fprintf(stderr, "ipc_microbench: %zu CPU(s) available%s\n", allowed_cpus.size(),
+            allowed_cpus.size() < 2 ? ", pinned pairs share one CPU" : "");
+
+    if (!json) printf("bench,primitive,pinned,procs,capacity,iters,p50_ns,p99_ns,mean_ns,ops_s\n");
+    bool ok = true;
+    for (int v = 0; v < 2; ++v) {
+        if (!(variants & (1 << v))) continue;
+        bool pinned = v == 1;
+        for (int k = 0; k < CHAN_COUNT; ++k) {
+            if (!only.empty() && only != "pingpong" && only != "stream") break;
+            Chan *c = make_chan(k);
+            if (!c->open()) {
+                delete c;
+                return 1;
+            }
+            if (only.empty() || only == "pingpong") bench_pingpong(*c, iters, pinned);
+            if (only.empty() || only == "stream") bench_stream(*c, iters, pinned);
+            delete c;
+        }
+        if (only.empty() || only == "mutex") {
+            for (int futex = 0; futex < 2; ++futex) {
+                for (int p = 1; p <= max_procs; p *= 2) ok = bench_mutex(futex, p, max(10L, iters / p), pinned) && ok;
+            }
+        }
+        if (only.empty() || only == "scan") {
+            for (int m = 0; m < 2; ++m) {
+                for (long cap = 16; cap <= max_cap; cap *= 4) bench_scan(m == 1, cap, pinned);
+            }
+        }
+    }
+    if (json) print_json();
+    return ok ? 0 : 1;
+}
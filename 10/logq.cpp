@@ -0,0 +1,54 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "segment_log.h"
+
+using namespace std;
+
+// Поиск по журналу наблюдателя (observer --segments <dir>)
+
+void print_hit(const SegHit &h) {
+    time_t sec = h.ts / 1000000000LL;
+    tm t{};
+    localtime_r(&sec, &t);
+    char when[32];
+    strftime(when, sizeof(when), "%H:%M:%S", &t);
+    printf("%s.%06lld %s\n", when, (long long)(h.ts % 1000000000LL) / 1000, h.text.c_str());
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: ./logq <dir> --pid <pid>\n"
+             << "       ./logq <dir> --from <unix_sec> [--to <unix_sec>]\n";
+        return 1;
+    }
+
+    string dir = argv[1];
+    int32_t pid = 0;
+    int64_t from = -1, to = INT64_MAX;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--pid") == 0) pid = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--from") == 0) from = atoll(argv[i + 1]) * 1000000000LL;
+        else if (strcmp(argv[i], "--to") == 0) to = atoll(argv[i + 1]) * 1000000000LL;
+    }
+
+    vector<SegHit> hits;
+    if (pid > 0) {
+        seg_query_pid(dir, pid, hits);
+        for (const SegHit &h : hits) {
+            if (h.ts >= from && h.ts <= to) print_hit(h);
+        }
+    } else if (from >= 0) {
+        seg_query_time(dir, from, to, hits);
+        for (const SegHit &h : hits) print_hit(h);
+    } else {
+        cerr << "Either --pid or --from is required\n";
+        return 1;
+    }
+    return 0;
+}
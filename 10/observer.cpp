@@ -1,41 +1,251 @@
 #include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
 #include <fcntl.h>
 #include <unistd.h>
 #include <csignal>
 #include <cerrno>
+#include <poll.h>
 #include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "common.h"
+#include "segment_log.h"
 
 using namespace std;
 
 volatile sig_atomic_t running = 1;
 void handle_sigint(int) { running = 0; }
 
-int main() {
-    signal(SIGINT, handle_sigint);
+// сколько байт за раз перекладываем из FIFO в приёмник (ёмкость pipe по умолчанию)
+static const size_t SPLICE_CHUNK = 64 * 1024;
 
-    pid_t pid = getpid();
+// журнал в сегментах (--segments); строки собираются из кусков, прочитанных из FIFO
+SegmentWriter *seg_log = nullptr;
+string seg_pending;
 
-    if (mkfifo(FIFO_NAME, 0666) == -1 && errno != EEXIST) {
-        perror("mkfifo");
-        return 1;
+void feed_segments(const char *buf, size_t n) {
+    seg_pending.append(buf, n);
+    size_t start = 0;
+    int64_t ts = seg_now_ns();
+    for (size_t nl; (nl = seg_pending.find('\n', start)) != string::npos; start = nl + 1) {
+        size_t len = nl - start;
+        if (len == 0) continue;
+        const char *line = seg_pending.data() + start;
+        seg_log->append(ts, seg_parse_pid(line, len), line, (uint32_t)len);
     }
+    seg_pending.erase(0, start);
+}
 
-    cout << "[Observer " << pid << "] Started. Waiting for logs...\n";
+// --aggregate: разбор строк teacher/student вместо эха, память постоянная при любом числе строк.
+// Оценка и билет берутся из пары строк teacher "Checking PID=p ticket=t" -> "Grade=g PID=p";
+// между ними pid ждёт в таблице AGG_PENDING ячеек (в проверке одновременно не больше комнат).
+static const size_t AGG_BUF = 1 << 20;
+static const int AGG_PENDING = 4096;
+static const int AGG_GRADES = 10;
+static const int AGG_TICKETS = 100;
 
-    int fd = open(FIFO_NAME, O_RDONLY | O_NONBLOCK);
-    if (fd < 0) {
-        perror("open fifo");
-        return 1;
+struct Aggregator {
+    bool simd = true;
+    uint64_t lines = 0, oversized = 0;
+    uint64_t students = 0, checked = 0, graded = 0, received = 0;
+    uint64_t rejected = 0, interrupted = 0, exam_ended = 0, unmatched = 0;
+    uint64_t grades[AGG_GRADES] = {};
+    uint64_t ticket_n[AGG_TICKETS + 1] = {};
+    uint64_t ticket_sum[AGG_TICKETS + 1] = {};
+    int32_t pending_pid[AGG_PENDING] = {};
+    int16_t pending_ticket[AGG_PENDING] = {};
+    // проверено за текущую секунду; пик и число секунд для среднего
+    int64_t sec = -1, first_sec = -1;
+    uint64_t sec_graded = 0, sec_lines = 0, peak = 0;
+
+    static bool starts(const char *p, const char *end, const char *lit, size_t n) {
+        return (size_t)(end - p) >= n && memcmp(p, lit, n) == 0;
+    }
+
+    // число с позиции p; p сдвигается за него
+    static int parse_int(const char *&p, const char *end) {
+        int v = 0;
+        while (p < end && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+        return v;
+    }
+
+    // значение tag=N с позиции p (после пробелов); -1 — тега нет
+    static int field(const char *&p, const char *end, const char *tag, size_t n) {
+        while (p < end && *p == ' ') p++;
+        if (!starts(p, end, tag, n)) return -1;
+        p += n;
+        return parse_int(p, end);
+    }
+
+    // "Checking PID=p ticket=t[ (from room k)]", "Grade=g PID=p"
+    void teacher_line(const char *m, const char *end) {
+        if (starts(m, end, "Checking ", 9)) {
+            m += 9;
+            int pid = field(m, end, "PID=", 4);
+            int ticket = field(m, end, "ticket=", 7);
+            if (pid <= 0) return;
+            checked++;
+            pending_pid[pid % AGG_PENDING] = pid;
+            pending_ticket[pid % AGG_PENDING] = (int16_t)ticket;
+        } else if (starts(m, end, "Grade=", 6)) {
+            m += 6;
+            int grade = parse_int(m, end);
+            int pid = field(m, end, "PID=", 4);
+            graded++;
+            sec_graded++;
+            if (grade >= 0 && grade < AGG_GRADES) grades[grade]++;
+            int h = pid > 0 ? pid % AGG_PENDING : 0;
+            if (pid > 0 && pending_pid[h] == pid) {
+                int t = pending_ticket[h];
+                if (t >= 1 && t <= AGG_TICKETS) {
+                    ticket_n[t]++;
+                    ticket_sum[t] += grade;
+                }
+                pending_pid[h] = 0;
+            } else {
+                unmatched++;
+            }
+        }
+    }
+
+    void student_line(const char *m, const char *end) {
+        if (starts(m, end, "Preparing ", 10)) students++;
+        else if (starts(m, end, "Received grade: ", 16)) received++;
+        else if (starts(m, end, "No free slots", 13) || starts(m, end, "Exam closed", 11)) rejected++;
+        else if (starts(m, end, "Interrupted", 11)) interrupted++;
+        else if (starts(m, end, "Exam ended", 10)) exam_ended++;
+    }
+
+    void line(const char *p, size_t len) {
+        lines++;
+        sec_lines++;
+        const char *end = p + len;
+        if (len < 3 || p[0] != '[') return;
+        const char *close = (const char *)memchr(p, ']', len);
+        if (!close || close + 2 > end) return;
+        // "[TEACHER] ", "[TEACHER room k] ", "[STUDENT pid] "
+        if (starts(p + 1, end, "TEACHER", 7)) teacher_line(close + 2, end);
+        else if (starts(p + 1, end, "STUDENT", 7)) student_line(close + 2, end);
+    }
+
+#if defined(__SSE2__)
+    // биты позиций '\n' в 16 байтах
+    static uint64_t newlines16(const char *p) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        return (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    }
+#endif
+
+    // Разбирает целые строки из [p, p + n), возвращает, сколько байт обработано.
+    // SSE2: маска '\n' на 64 байта за четыре сравнения, строки идут по установленным битам;
+    // хвост и сборки без SSE2 — memchr
+    size_t feed(const char *p, size_t n) {
+        size_t start = 0, i = 0;
+#if defined(__SSE2__)
+        if (simd) {
+            for (; i + 64 <= n; i += 64) {
+                uint64_t m = newlines16(p + i) | newlines16(p + i + 16) << 16 | newlines16(p + i + 32) << 32
+                             | newlines16(p + i + 48) << 48;
+                while (m) {
+                    size_t e = i + __builtin_ctzll(m);
+                    line(p + start, e - start);
+                    start = e + 1;
+                    m &= m - 1;
+                }
+            }
+        }
+#endif
+        while (i < n) {
+            const char *q = (const char *)memchr(p + i, '\n', n - i);
+            if (!q) break;
+            size_t e = q - p;
+            line(p + start, e - start);
+            start = i = e + 1;
+        }
+        return start;
     }
 
+    // раз в секунду — строка с пропускной способностью за прошедшую секунду
+    void tick(pid_t pid) {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        if (sec < 0) {
+            sec = first_sec = ts.tv_sec;
+            return;
+        }
+        if (ts.tv_sec == sec) return;
+        if (sec_lines > 0) {
+            cout << "[Observer " << pid << "] " << (sec - first_sec) << " s: " << sec_graded << " graded/s, "
+                 << sec_lines << " lines/s\n";
+            cout.flush();
+        }
+        peak = max(peak, sec_graded);
+        sec = ts.tv_sec;
+        sec_graded = sec_lines = 0;
+    }
+
+    void report(pid_t pid) {
+        peak = max(peak, sec_graded);
+        long seconds = sec >= 0 ? sec - first_sec + 1 : 0;
+        printf("[Observer %d] Aggregate: lines=%llu students=%llu checked=%llu graded=%llu received=%llu\n", (int)pid,
+               (unsigned long long)lines, (unsigned long long)students, (unsigned long long)checked,
+               (unsigned long long)graded, (unsigned long long)received);
+        printf("[Observer %d] Left: no_slot=%llu interrupted=%llu exam_ended=%llu; unmatched=%llu oversized=%llu\n",
+               (int)pid, (unsigned long long)rejected, (unsigned long long)interrupted,
+               (unsigned long long)exam_ended, (unsigned long long)unmatched, (unsigned long long)oversized);
+        printf("[Observer %d] Throughput: peak=%llu graded/s mean=%.1f graded/s over %ld s\n", (int)pid,
+               (unsigned long long)peak, seconds > 0 ? (double)graded / seconds : 0.0, seconds);
+        for (int g = 0; g < AGG_GRADES; ++g) {
+            if (grades[g] == 0) continue;
+            printf("[Observer %d] grade %d: %llu (%.1f%%)\n", (int)pid, g, (unsigned long long)grades[g],
+                   100.0 * grades[g] / graded);
+        }
+        for (int t = 1; t <= AGG_TICKETS; ++t) {
+            if (ticket_n[t] == 0) continue;
+            printf("[Observer %d] ticket %d: n=%llu mean=%.2f\n", (int)pid, t, (unsigned long long)ticket_n[t],
+                   (double)ticket_sum[t] / ticket_n[t]);
+        }
+        fflush(stdout);
+    }
+};
+
+bool is_pipe(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+// Записать n байт целиком (приёмник может принимать частями)
+void write_full(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;
+        p += w;
+        n -= w;
+    }
+}
+
+// Обычный режим: read() в буфер и вывод через cout с префиксом наблюдателя.
+// raw_fd >= 0 — замена --splice, когда приёмник не поддерживает splice: данные идут
+// в raw_fd как есть, без префикса (и в stdout, если raw_stdout — как делал tee)
+int run_copy(int fd, pid_t pid, int raw_fd = -1, bool raw_stdout = false) {
     char buf[512];
 
     while (running) {
         ssize_t n = read(fd, buf, sizeof(buf) - 1);
         if (n > 0) {
             buf[n] = '\0';
+            if (seg_log) feed_segments(buf, n);
+            if (raw_fd >= 0) {
+                if (raw_stdout) write_full(STDOUT_FILENO, buf, n);
+                write_full(raw_fd, buf, n);
+                continue;
+            }
             cout << "[Observer " << pid << "] " << buf;
             cout.flush();
             continue;
@@ -46,16 +256,208 @@ int main() {
         }
         if (n == 0) {
             close(fd);
-            fd = open(FIFO_NAME, O_RDONLY | O_NONBLOCK);
+            fd = open(exam_name(FIFO_NAME).c_str(), O_RDONLY | O_NONBLOCK);
+            if (fd < 0) {
+                break;
+            }
+            continue;
+        }
+    }
+    return fd;
+}
+
+// Режим --aggregate: строки из FIFO разбираются в буфере AGG_BUF, неполная строка
+// переносится в начало; строка длиннее буфера отбрасывается.
+// Свой конец на запись держит FIFO открытым: без EOF и переоткрытия нет окна, в котором
+// open() писателей с O_NONBLOCK падает с ENXIO и строки теряются (счётчики были бы неточны)
+int run_aggregate(int fd, pid_t pid, Aggregator &agg) {
+    static char buf[AGG_BUF];
+    size_t have = 0;
+    int keep_fd = open(exam_name(FIFO_NAME).c_str(), O_WRONLY | O_NONBLOCK);
+
+    while (running) {
+        agg.tick(pid);
+        ssize_t n = read(fd, buf + have, sizeof(buf) - have);
+        if (n > 0) {
+            if (seg_log) feed_segments(buf + have, n);
+            have += n;
+            size_t used = agg.feed(buf, have);
+            if (used == 0 && have == sizeof(buf)) {
+                agg.oversized++;
+                used = have;
+            }
+            memmove(buf, buf + used, have - used);
+            have -= used;
+            continue;
+        }
+        if (n == -1 && errno == EAGAIN) {
+            usleep(100000);
+            continue;
+        }
+        if (n == 0) {
+            close(fd);
+            fd = open(exam_name(FIFO_NAME).c_str(), O_RDONLY | O_NONBLOCK);
+            if (fd < 0) {
+                break;
+            }
+            continue;
+        }
+    }
+    agg.report(pid);
+    if (keep_fd >= 0) close(keep_fd);
+    return fd;
+}
+
+// Zero-copy режим: данные уходят из FIFO в stdout/файл через splice() и не попадают
+// в память процесса. Если задан файл, а stdout тоже pipe, поток дублируется в него через tee().
+int run_splice(int fd, int out_fd, bool tee_stdout, bool &unsupported) {
+    while (running) {
+        pollfd pfd{fd, POLLIN, 0};
+        int pr = poll(&pfd, 1, 100);
+        if (pr <= 0) continue;
+
+        size_t len = SPLICE_CHUNK;
+        if (tee_stdout) {
+            // в файл уходит ровно то, что уже скопировано в stdout: иначе при заполненном
+            // stdout (EAGAIN) эти байты достались бы только файлу
+            ssize_t t = tee(fd, STDOUT_FILENO, len, SPLICE_F_NONBLOCK);
+            if (t <= 0) {
+                if (t == -1 && errno != EAGAIN && errno != EINTR) {
+                    perror("tee");
+                    unsupported = true;
+                    break;
+                }
+                pollfd out{STDOUT_FILENO, POLLOUT, 0};
+                poll(&out, 1, 100);
+                continue;
+            }
+            len = (size_t)t;
+        }
+
+        ssize_t n = splice(fd, nullptr, out_fd, nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) continue;
+        if (n == -1 && errno == EAGAIN) continue;
+        if (n == -1 && errno == EINTR) continue;
+        if (n == 0) {
+            close(fd);
+            fd = open(exam_name(FIFO_NAME).c_str(), O_RDONLY | O_NONBLOCK);
             if (fd < 0) {
                 break;
             }
             continue;
         }
+        // приёмник не поддерживает splice (например, старое ядро и tty)
+        perror("splice");
+        unsupported = true;
+        break;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    bool use_splice = false;
+    bool aggregate = false;
+    bool scalar_scan = false;
+    const char *out_path = nullptr;
+    const char *seg_dir = nullptr;
+    size_t seg_size = SEG_DEFAULT_SIZE;
+    const char *usage = "Usage: ./observer [--splice [file] | --aggregate [--scalar-scan]]"
+                        " [--segments dir [--segment-mb N]] [--exam ID]\n";
+
+    if (!take_exam_arg(argc, argv)) {
+        cerr << usage;
+        return 1;
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--splice") == 0) {
+            use_splice = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') out_path = argv[++i];
+        } else if (strcmp(argv[i], "--aggregate") == 0) {
+            aggregate = true;
+        } else if (strcmp(argv[i], "--scalar-scan") == 0) {
+            // поиск строк через memchr, для сравнения с SSE2 (bench aggregate)
+            scalar_scan = true;
+        } else if (strcmp(argv[i], "--segments") == 0 && i + 1 < argc) {
+            seg_dir = argv[++i];
+        } else if (strcmp(argv[i], "--segment-mb") == 0 && i + 1 < argc) {
+            int mb = atoi(argv[++i]);
+            if (mb < 1 || mb > SEG_MAX_MB) {
+                cerr << usage;
+                return 1;
+            }
+            seg_size = (size_t)mb << 20;
+        } else {
+            cerr << usage;
+            return 1;
+        }
+    }
+    if (use_splice && seg_dir) {
+        // splice не передаёт данные в процесс, разбирать строки для журнала нечем
+        cerr << "--splice and --segments are mutually exclusive\n";
+        return 1;
+    }
+    if (use_splice && aggregate) {
+        cerr << "--splice and --aggregate are mutually exclusive\n";
+        return 1;
+    }
+
+    signal(SIGINT, handle_sigint);
+
+    pid_t pid = getpid();
+
+    if (mkfifo(exam_name(FIFO_NAME).c_str(), 0666) == -1 && errno != EEXIST) {
+        perror("mkfifo");
+        return 1;
+    }
+
+    SegmentWriter writer;
+    if (seg_dir) {
+        if (!writer.open_dir(seg_dir, seg_size)) return 1;
+        seg_log = &writer;
+    }
+
+    int out_fd = STDOUT_FILENO;
+    if (out_path) {
+        // без O_APPEND: splice в файлы с O_APPEND старые ядра не поддерживают
+        out_fd = open(out_path, O_WRONLY | O_CREAT, 0644);
+        if (out_fd < 0) {
+            perror("open output");
+            return 1;
+        }
+        lseek(out_fd, 0, SEEK_END);
+    }
+
+    // в zero-copy режиме stdout может быть приёмником, поэтому служебные сообщения идут в stderr
+    ostream &info = use_splice ? cerr : cout;
+    info << "[Observer " << pid << "] Started" << (use_splice ? " (splice)" : aggregate ? " (aggregate)" : "")
+         << ". Waiting for logs...\n";
+
+    int fd = open(exam_name(FIFO_NAME).c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        perror("open fifo");
+        return 1;
+    }
+
+    if (use_splice) {
+        bool unsupported = false;
+        fd = run_splice(fd, out_fd, out_path && is_pipe(STDOUT_FILENO), unsupported);
+        if (unsupported) {
+            info << "[Observer " << pid << "] Falling back to copy mode\n";
+            if (out_fd == STDOUT_FILENO) fd = run_copy(fd, pid);
+            else fd = run_copy(fd, pid, out_fd, out_path && is_pipe(STDOUT_FILENO));
+        }
+    } else if (aggregate) {
+        Aggregator agg;
+        agg.simd = !scalar_scan;
+        fd = run_aggregate(fd, pid, agg);
+    } else {
+        fd = run_copy(fd, pid);
     }
 
-    cout << "\n[Observer " << pid << "] Shutdown.\n";
-    close(fd);
+    info << "\n[Observer " << pid << "] Shutdown.\n";
+    if (fd >= 0) close(fd);
+    if (out_fd != STDOUT_FILENO) close(out_fd);
+    if (seg_log) writer.close_all();
     // FIFO не удаляем, чтобы можно было перезапускать наблюдателей/teacher
     return 0;
 }
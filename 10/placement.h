@@ -0,0 +1,91 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <fstream>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Размещение сегмента и процессов: huge pages, предварительные page faults,
+// привязка к CPU и к узлу NUMA. Без libnuma: mbind/set_mempolicy через syscall.
+
+// hugetlbfs-файл вместо /dev/shm (teacher --huge); студент ищет его, если SHM_NAME нет
+static const char *HUGE_SHM_PATH = "/dev/hugepages/exam_shm";
+static const size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+// из <linux/mempolicy.h>, чтобы не тянуть заголовки numactl
+static const int PL_MPOL_PREFERRED = 1;
+static const int PL_MPOL_BIND = 2;
+
+// "0,2-3" -> маска CPU; false при ошибке разбора
+inline bool parse_cpu_list(const char *s, cpu_set_t &set) {
+    CPU_ZERO(&set);
+    const char *p = s;
+    while (*p) {
+        char *end;
+        long a = strtol(p, &end, 10);
+        if (end == p || a < 0 || a >= CPU_SETSIZE) return false;
+        long b = a;
+        if (*end == '-') {
+            p = end + 1;
+            b = strtol(p, &end, 10);
+            if (end == p || b < a || b >= CPU_SETSIZE) return false;
+        }
+        for (long c = a; c <= b; ++c) CPU_SET(c, &set);
+        if (*end == ',') end++;
+        else if (*end) return false;
+        p = end;
+    }
+    return CPU_COUNT(&set) > 0;
+}
+
+inline bool pin_cpus(const char *list) {
+    cpu_set_t set;
+    if (!parse_cpu_list(list, set)) {
+        errno = EINVAL;
+        return false;
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// Страницы [addr, addr+len) только с узла node
+inline bool numa_bind(void *addr, size_t len, int node) {
+    unsigned long mask = 1ul << node;
+    return syscall(SYS_mbind, addr, len, PL_MPOL_BIND, &mask, sizeof(mask) * 8 + 1, 0) == 0;
+}
+
+// Новые страницы процесса по возможности с узла node
+inline bool numa_prefer(int node) {
+    unsigned long mask = 1ul << node;
+    return syscall(SYS_set_mempolicy, PL_MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1) == 0;
+}
+
+inline size_t round_huge(size_t n) {
+    return (n + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+}
+
+// Прочитать значение в квадратных скобках из файла sysfs ("always [madvise] never")
+inline std::string sysfs_choice(const char *path) {
+    std::ifstream f(path);
+    std::string line;
+    if (!std::getline(f, line)) return "?";
+    size_t a = line.find('['), b = line.find(']');
+    if (a == std::string::npos || b == std::string::npos) return line;
+    return line.substr(a + 1, b - a - 1);
+}
+
+// Коснуться каждой страницы на запись (для отображений, где MAP_POPULATE не сработал).
+// Атомарное «+0» — один page fault на страницу, а не чтение нулевой страницы и затем COW
+inline void prefault(void *addr, size_t len, size_t page) {
+    char *p = (char *)addr;
+    for (size_t off = 0; off < len; off += page) __atomic_fetch_add(p + off, 0, __ATOMIC_RELAXED);
+}
+
+#endif // PLACEMENT_H
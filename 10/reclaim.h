@@ -0,0 +1,152 @@
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <ctime>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common.h"
+
+// Объекты экзамена, которые teacher убирает в cleanup(): сегмент (/dev/shm или hugetlbfs),
+// именованные семафоры, сокеты fd-транспорта и управляющий. teacher, убитый SIGKILL или
+// OOM, оставляет их навсегда, и за дни работы /dev/shm заполняется. При запуске teacher
+// удаляет объекты экзаменов, чей владелец завершился: его pid записан в заголовке
+// сегмента (SharedData::owner). Если владельца не узнать (сегмента нет, заголовок чужой
+// версии или ещё не записан), объекты удаляются, только когда все старше RECLAIM_GRACE_S:
+// teacher, который сейчас запускается (в том числе с тем же ID), так не пострадает. Трогаются только имена,
+// которые создаёт сам teacher; FIFO лога, трассы и записи нагрузки остаются.
+
+static const int RECLAIM_GRACE_S = 60;
+// Слоты убитых студентов teacher обходит раз в REAP_PERIOD_MS (AdminServer::reap);
+// RESERVED забирается только на втором обходе, то есть через 1..2 периода
+static const int REAP_PERIOD_MS = 1000;
+
+struct ExamObjects {
+    std::vector<std::string> paths;
+    std::string segment;   // путь сегмента, если он есть
+    time_t newest = 0;     // mtime самого нового объекта
+};
+
+// Имя объекта teacher без каталога: "exam_shm.ID", "sem.exam_ack_3" (ID пустой у экзамена
+// по умолчанию). false — имя не teacher
+inline bool exam_object_id(const std::string &name, std::string &id, bool &segment) {
+    bool sem = name.compare(0, 4, "sem.") == 0;
+    std::string base = sem ? name.substr(4) : name;
+    size_t dot = base.find('.');
+    id = dot == std::string::npos ? "" : base.substr(dot + 1);
+    base = base.substr(0, dot);
+    segment = !sem && base == "exam_shm";
+    if (sem) {
+        if (base == "exam_mutex" || base == "exam_queue") return true;
+        for (const char *kind : {"exam_grade_", "exam_ack_"}) {
+            size_t n = strlen(kind);
+            if (base.size() > n && base.compare(0, n, kind) == 0
+                && base.find_first_not_of("0123456789", n) == std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return segment || base == "exam_fds" || base == "exam_admin";
+}
+
+// Все объекты teacher в /dev/shm, /tmp (только сокеты) и hugetlbfs по ID экзамена
+inline std::map<std::string, ExamObjects> exam_objects() {
+    std::map<std::string, ExamObjects> all;
+    for (const char *dir : {"/dev/shm", "/tmp", "/dev/hugepages"}) {
+        DIR *d = opendir(dir);
+        while (dirent *e = d ? readdir(d) : nullptr) {
+            std::string name = e->d_name, id;
+            bool segment;
+            if (!exam_object_id(name, id, segment)) continue;
+            std::string path = std::string(dir) + "/" + name;
+            struct stat st;
+            if (lstat(path.c_str(), &st) < 0) continue;
+            if (strcmp(dir, "/tmp") == 0 ? !S_ISSOCK(st.st_mode) : !S_ISREG(st.st_mode)) continue;
+            ExamObjects &x = all[id];
+            x.paths.push_back(path);
+            if (segment) x.segment = path;
+            if (st.st_mtime > x.newest) x.newest = st.st_mtime;
+        }
+        if (d) closedir(d);
+    }
+    return all;
+}
+
+// EPERM — процесс есть, но чужой: считается живым. Зомби (родитель ещё не вызвал wait) —
+// уже завершился
+inline bool pid_alive(pid_t pid) {
+    if (kill(pid, 0) == -1 && errno == ESRCH) return false;
+    char path[64], buf[256];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return true;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    buf[n > 0 ? n : 0] = 0;
+    const char *p = strrchr(buf, ')');
+    return !(p && p[1] == ' ' && p[2] == 'Z');
+}
+
+// Владелец сегмента: 1 — жив, 0 — завершился, -1 — не узнать
+inline int segment_owner_alive(const std::string &path, pid_t &owner) {
+    owner = 0;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    alignas(SharedData) char buf[sizeof(SharedData)];
+    ssize_t r = pread(fd, buf, sizeof(buf), 0);
+    close(fd);
+    const SharedData *h = reinterpret_cast<const SharedData *>(buf);
+    if (r < (ssize_t)sizeof(SharedData) || h->magic != SEGMENT_MAGIC || h->version != SEGMENT_VERSION
+        || h->owner <= 0) {
+        return -1;
+    }
+    owner = h->owner;
+    return pid_alive(owner) ? 1 : 0;
+}
+
+// Удалить объекты экзаменов, владелец которых завершился. Неизвестный владелец (заголовок
+// ещё не записан) ждёт RECLAIM_GRACE_S и у own, ID запускаемого teacher: это может быть
+// второй teacher с тем же ID, который запускается сейчас. Его сегмент остаётся, и
+// map_segment (O_EXCL) откажет. -1 — экзамен own уже обслуживает живой teacher (его pid
+// в busy), иначе число удалённых. log — строка на каждый очищенный экзамен
+inline int reclaim_stale(const std::string &own, pid_t &busy, std::vector<std::string> &log) {
+    int removed = 0;
+    busy = 0;
+    time_t now = time(nullptr);
+    for (auto &e : exam_objects()) {
+        const std::string &id = e.first;
+        ExamObjects &x = e.second;
+        pid_t owner = 0;
+        int alive = x.segment.empty() ? -1 : segment_owner_alive(x.segment, owner);
+        if (alive == 1) {
+            if (id == own) {
+                busy = owner;
+                return -1;
+            }
+            continue;
+        }
+        if (alive == -1 && now - x.newest < RECLAIM_GRACE_S) continue;
+
+        int n = 0;
+        for (const std::string &p : x.paths) n += unlink(p.c_str()) == 0;
+        removed += n;
+        if (n == 0) continue;
+        std::string name = id.empty() ? "(default)" : id;
+        log.push_back("Reclaimed " + std::to_string(n) + " stale objects of exam " + name
+                      + (alive == 0 ? ", teacher PID=" + std::to_string(owner) + " exited"
+                                    : ", owner unknown, idle " + std::to_string(now - x.newest) + " s"));
+    }
+    return removed;
+}
+
+#endif // RECLAIM_H
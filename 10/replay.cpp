@@ -0,0 +1,206 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <tuple>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "transport.h"
+#include "replay.h"
+
+using namespace std;
+
+// Воспроизведение записанной нагрузки (teacher --record). Запускает ./teacher и ./student
+// из текущего каталога: тех же студентов в те же моменты, с теми же билетами, временем
+// подготовки и проверки. Так одну запись можно прогнать на двух сборках и сравнить.
+
+double percentile(vector<double> v, double p) {
+    if (v.empty()) return 0;
+    sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+double now_sec() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+pid_t spawn(const vector<string> &args) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        vector<char *> argv;
+        for (const string &a : args) argv.push_back(const_cast<char *>(a.c_str()));
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+// Отпечаток нагрузки: FNV-1a по отсортированным (билет, подготовка, проверка).
+// Порядок запусков в пределах дрожания fork может поменяться, поэтому без порядка
+uint64_t fingerprint(const Recording &rec) {
+    vector<tuple<int, int, int>> v;
+    for (const Arrival &a : rec.students) v.emplace_back(a.ticket, a.prep_ms, a.grade_ms);
+    sort(v.begin(), v.end());
+    uint64_t h = 1469598103934665603ull;
+    for (auto &x : v) {
+        for (int k : {get<0>(x), get<1>(x), get<2>(x)}) {
+            h = (h ^ (uint32_t)k) * 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+void print_info(const Recording &rec) {
+    vector<double> prep, grade;
+    for (const Arrival &a : rec.students) {
+        prep.push_back(a.prep_ms);
+        if (a.grade_ms >= 0) grade.push_back(a.grade_ms);
+    }
+    double span = (rec.students.back().t - rec.students.front().t) / 1e9;
+    printf("capacity=%d transport=%s rooms=%d\n", rec.h.capacity,
+           rec.h.transport >= 0 && rec.h.transport < TR_COUNT ? TRANSPORT_NAMES[rec.h.transport] : "?", rec.h.rooms);
+    printf("students=%zu graded=%d arrivals over %.3f s\n", rec.students.size(), rec.graded, span);
+    printf("prep_ms p50=%.0f p99=%.0f, grade_ms p50=%.0f p99=%.0f\n", percentile(prep, 0.5),
+           percentile(prep, 0.99), percentile(grade, 0.5), percentile(grade, 0.99));
+    printf("workload %016llx\n", (unsigned long long)fingerprint(rec));
+}
+
+// Время не проверенных в записи студентов — медиана записанных, чтобы прогон не зависел
+// от rand(). record: teacher --record, чтобы сверить воспроизведённый прогон с исходным
+int replay(const Recording &rec, double speed, int transport, bool record) {
+    vector<double> grade;
+    for (const Arrival &a : rec.students) {
+        if (a.grade_ms >= 0) grade.push_back(a.grade_ms);
+    }
+    int fallback_ms = (int)(percentile(grade, 0.5) / speed);
+
+    vector<string> teacher = {"./teacher", to_string(rec.h.capacity), "--grade-ms", to_string(fallback_ms),
+                              "--transport", TRANSPORT_NAMES[transport]};
+    if (rec.h.rooms > 0) {
+        teacher.push_back("--rooms");
+        teacher.push_back(to_string(rec.h.rooms));
+    }
+    if (!exam_id().empty()) {
+        teacher.push_back("--exam");
+        teacher.push_back(exam_id());
+    }
+    if (record) teacher.push_back("--record");
+    pid_t t = spawn(teacher);
+    usleep(300000);
+
+    map<pid_t, double> started;
+    vector<double> lat_ms;
+    timespec base{};
+    clock_gettime(CLOCK_MONOTONIC, &base);
+    double t0 = now_sec();
+    uint64_t first = rec.students.front().t;
+    for (const Arrival &a : rec.students) {
+        // момент запуска по абсолютному времени: задержки fork не накапливаются
+        uint64_t off = (uint64_t)((a.t - first) / speed);
+        timespec at = base;
+        at.tv_sec += off / 1000000000ull;
+        at.tv_nsec += off % 1000000000ull;
+        if (at.tv_nsec >= 1000000000L) {
+            at.tv_sec++;
+            at.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, nullptr) == EINTR) {}
+
+        vector<string> args = {"./student", "--ticket", to_string(a.ticket), "--prep-ms",
+                               to_string((int)(a.prep_ms / speed))};
+        if (a.grade_ms >= 0) {
+            args.push_back("--grade-ms");
+            args.push_back(to_string((int)(a.grade_ms / speed)));
+        }
+        if (!exam_id().empty()) {
+            args.push_back("--exam");
+            args.push_back(exam_id());
+        }
+        started[spawn(args)] = now_sec();
+
+        // собрать уже завершившихся, не дожидаясь конца запусков
+        pid_t p;
+        while ((p = waitpid(-1, nullptr, WNOHANG)) > 0) {
+            auto it = started.find(p);
+            if (it == started.end()) continue;
+            lat_ms.push_back((now_sec() - it->second) * 1e3);
+            started.erase(it);
+        }
+    }
+    while (!started.empty()) {
+        pid_t p = waitpid(-1, nullptr, 0);
+        if (p < 0) break;
+        auto it = started.find(p);
+        if (it == started.end()) continue;
+        lat_ms.push_back((now_sec() - it->second) * 1e3);
+        started.erase(it);
+    }
+    double total = now_sec() - t0;
+    kill(t, SIGINT);
+    waitpid(t, nullptr, 0);
+
+    printf("replayed %zu students in %.3f s (speed %.2f): %.1f students/s, latency p50=%.1f ms p99=%.1f ms\n",
+           lat_ms.size(), total, speed, lat_ms.size() / total, percentile(lat_ms, 0.5), percentile(lat_ms, 0.99));
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: ./replay [--exam ID] [FILE] [--info] [--speed X]"
+                        " [--transport named|unnamed|futex|eventfd|pipe] [--record]\n";
+    if (!take_exam_arg(argc, argv)) {
+        cerr << usage;
+        return 1;
+    }
+    string path;
+    bool info = false;
+    bool record = false;
+    double speed = 1.0;
+    int transport = -1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--info") == 0) {
+            info = true;
+        } else if (strcmp(argv[i], "--record") == 0) {
+            record = true;
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--transport") == 0 && i + 1 < argc) {
+            transport = transport_from_name(argv[++i]);
+            if (transport < 0) {
+                cerr << usage;
+                return 1;
+            }
+        } else if (argv[i][0] != '-' && path.empty()) {
+            path = argv[i];
+        } else {
+            cerr << usage;
+            return 1;
+        }
+    }
+    if (speed <= 0) {
+        cerr << "Speed must be > 0\n";
+        return 1;
+    }
+    if (path.empty()) path = exam_name(RECORD_NAME);
+
+    Recording rec;
+    if (!load_recording(path, rec)) return 1;
+    print_info(rec);
+    if (info) return 0;
+    if (transport < 0) transport = rec.h.transport >= 0 && rec.h.transport < TR_COUNT ? rec.h.transport : TR_NAMED_SEM;
+    return replay(rec, speed, transport, record);
+}
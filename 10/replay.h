@@ -0,0 +1,126 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "trace.h"
+
+// Запись нагрузки экзамена (teacher --record) для воспроизведения (./replay).
+// Студент при выходе дописывает REC_ARRIVAL: момент запуска, билет и время подготовки;
+// teacher — REC_GRADED на каждую проверку: pid студента и время проверки.
+// replay сопоставляет их по pid и запускает тех же студентов в те же моменты
+// с --ticket/--prep-ms/--grade-ms, поэтому нагрузка не зависит от rand().
+
+static const char *RECORD_NAME = "/tmp/exam_record";
+
+static const uint32_t RECORD_MAGIC = 0x43455258;  // "XREC"
+static const uint32_t RECORD_VERSION = 1;
+
+enum RecordKind {
+    REC_ARRIVAL = 1,
+    REC_GRADED
+};
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t event_size;
+    int32_t capacity;
+    int32_t transport;
+    int32_t rooms;
+    uint64_t start;       // нс, CLOCK_MONOTONIC: запуск teacher
+};
+
+struct RecordEvent {
+    uint64_t t;           // нс, CLOCK_MONOTONIC: запуск студента / начало проверки
+    int32_t pid;          // студент
+    int16_t kind;         // RecordKind
+    int16_t ticket;
+    int32_t ms;           // подготовка / проверка
+    int32_t reserved;
+};
+
+static_assert(sizeof(RecordEvent) == 24, "record event layout");
+
+inline bool record_create(int capacity, int transport, int rooms) {
+    RecordHeader h{RECORD_MAGIC, RECORD_VERSION, sizeof(RecordEvent), capacity, transport, rooms, trace_now()};
+    return append_file_create(RECORD_NAME, &h, sizeof(h));
+}
+
+struct RecordBuf : AppendBuf<RecordEvent> {
+    RecordBuf() : AppendBuf<RecordEvent>(RECORD_NAME) {}
+
+    void add(RecordKind kind, uint64_t t, int pid, int ticket, int ms) {
+        if (!on) return;
+        RecordEvent e{};
+        e.t = t;
+        e.pid = pid;
+        e.kind = (int16_t)kind;
+        e.ticket = (int16_t)ticket;
+        e.ms = ms;
+        push(e);
+    }
+};
+
+// Записанный студент: события REC_ARRIVAL и REC_GRADED одного pid
+struct Arrival {
+    uint64_t t = 0;
+    int32_t pid = 0;
+    int ticket = 0;
+    int prep_ms = 0;
+    int grade_ms = -1;   // -1 — в записи студента не проверяли
+};
+
+struct Recording {
+    RecordHeader h{};
+    std::vector<Arrival> students;   // по времени запуска
+    int graded = 0;
+};
+
+// false — файла нет, чужой формат или в нём нет студентов (причина в stderr)
+inline bool load_recording(const std::string &path, Recording &rec) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        perror(path.c_str());
+        return false;
+    }
+    if (fread(&rec.h, sizeof(rec.h), 1, f) != 1 || rec.h.magic != RECORD_MAGIC || rec.h.version != RECORD_VERSION
+        || rec.h.event_size != sizeof(RecordEvent)) {
+        fprintf(stderr, "%s: not a workload recording\n", path.c_str());
+        fclose(f);
+        return false;
+    }
+    std::map<int32_t, Arrival> by_pid;
+    std::map<int32_t, int> grade_ms;
+    RecordEvent e;
+    while (fread(&e, sizeof(e), 1, f) == 1) {
+        if (e.kind == REC_ARRIVAL) {
+            Arrival &a = by_pid[e.pid];
+            a.t = e.t;
+            a.pid = e.pid;
+            a.ticket = e.ticket;
+            a.prep_ms = e.ms;
+        } else if (e.kind == REC_GRADED) {
+            grade_ms[e.pid] = e.ms;
+        }
+    }
+    fclose(f);
+    for (auto &kv : by_pid) {
+        auto g = grade_ms.find(kv.first);
+        if (g != grade_ms.end()) {
+            kv.second.grade_ms = g->second;
+            rec.graded++;
+        }
+        rec.students.push_back(kv.second);
+    }
+    std::sort(rec.students.begin(), rec.students.end(), [](const Arrival &a, const Arrival &b) { return a.t < b.t; });
+    if (rec.students.empty()) fprintf(stderr, "%s: no students\n", path.c_str());
+    return !rec.students.empty();
+}
+
+#endif // REPLAY_H
@@ -0,0 +1,107 @@
+#ifndef ROOMS_H
+#define ROOMS_H
+
+#include <cstdint>
+#include <string>
+
+#include "common.h"
+#include "transport.h"
+#include "slot_table.h"
+
+// Комнаты (teacher --rooms M): слоты делятся на M непрерывных диапазонов, у каждой
+// комнаты своя очередь (futex-семафор в сегменте) и свой проверяющий поток.
+// Слоты комнаты занимаются и освобождаются теми же CAS-переходами, что и вся таблица
+// (slot_table.h), только поиск ограничен диапазоном комнаты; grade/ack идут через транспорт.
+
+enum RouteKind {
+    ROUTE_HASH = 0,   // комната = pid % M
+    ROUTE_LEAST,      // наименьшая загрузка (waiting + processing), без блокировки
+    ROUTE_FILL        // по порядку: следующая комната, только когда предыдущая заполнена
+};
+
+inline constexpr const char *ROUTE_NAMES[] = {"hash", "least", "fill"};
+
+struct alignas(64) Room {
+    FSem queue;
+    int first;       // диапазон слотов [first, first + count)
+    int count;
+    int load;        // занятые слоты комнаты; читаются без lock, меняются атомарно
+    int waiting;     // ждут проверки (для кражи чужой очереди)
+    uint64_t graded;
+    uint64_t stolen;   // проверено этой комнатой из чужих
+};
+
+inline Room *rooms_of(SharedData *shm) {
+    return (Room *)((char *)shm + shm->rooms_offset);
+}
+
+inline void rooms_init(SharedData *shm, int m, int route) {
+    shm->rooms = m;
+    shm->route = route;
+    Room *r = rooms_of(shm);
+    int per = shm->capacity / m, extra = shm->capacity % m, first = 0;
+    for (int k = 0; k < m; ++k) {
+        r[k] = Room{};
+        r[k].first = first;
+        r[k].count = per + (k < extra ? 1 : 0);
+        first += r[k].count;
+    }
+}
+
+inline int room_reserve(SharedData *shm, Room &r) {
+    if (r.count == 0) return -1;
+    int i = slot_claim(shm, shm->free_mask, r.first, r.first + r.count, SLOT_EMPTY, SLOT_RESERVED);
+    if (i >= 0) __atomic_fetch_add(&r.load, 1, __ATOMIC_RELAXED);
+    return i;
+}
+
+inline void room_unreserve(SharedData *shm, Room &r, int i) {
+    slot_unreserve(shm, i);
+    __atomic_fetch_sub(&r.load, 1, __ATOMIC_RELAXED);
+}
+
+inline void room_publish(SharedData *shm, Room &r, int i) {
+    __atomic_fetch_add(&r.waiting, 1, __ATOMIC_RELAXED);
+    slot_publish(shm, i);
+}
+
+inline int room_take_waiting(SharedData *shm, Room &r) {
+    if (r.count == 0) return -1;
+    int i = slot_claim(shm, shm->wait_mask, r.first, r.first + r.count, SLOT_WAITING, SLOT_PROCESSING);
+    if (i >= 0) __atomic_fetch_sub(&r.waiting, 1, __ATOMIC_RELAXED);
+    return i;
+}
+
+inline void room_release(SharedData *shm, Room &r, int i) {
+    slot_release(shm, i);
+    __atomic_fetch_sub(&r.load, 1, __ATOMIC_RELAXED);
+}
+
+inline bool room_cancel(SharedData *shm, Room &r, int i) {
+    if (!slot_cancel(shm, i)) return false;
+    __atomic_fetch_sub(&r.waiting, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&r.load, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+// С какой комнаты студенту начинать поиск свободного слота
+inline int route_student(SharedData *shm, pid_t pid) {
+    Room *r = rooms_of(shm);
+    int m = shm->rooms;
+    if (shm->route == ROUTE_LEAST) {
+        int best = 0;
+        double best_load = 2.0;
+        for (int k = 0; k < m; ++k) {
+            double load = r[k].count ? (double)__atomic_load_n(&r[k].load, __ATOMIC_RELAXED) / r[k].count : 1.0;
+            if (load < best_load) {
+                best_load = load;
+                best = k;
+            }
+        }
+        return best;
+    }
+    if (shm->route == ROUTE_FILL) return 0;
+    return (int)(pid % m);
+}
+
+#endif // ROOMS_H
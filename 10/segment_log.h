@@ -0,0 +1,327 @@
+#ifndef SEGMENT_LOG_H
+#define SEGMENT_LOG_H
+
+#include <cstdint>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Журнал наблюдателя: каталог с сегментами фиксированного размера seg-<seq>.log.
+// Сегмент отображается в память целиком и состоит из:
+//   [SegmentHeader | таблица pid | разреженный индекс по времени | записи]
+// Записи одного pid внутри сегмента связаны обратной цепочкой (prev), а таблица pid
+// хранит смещение последней записи, поэтому история студента читается без сканирования.
+
+static const uint32_t SEG_MAGIC = 0x47455358; // "XSEG"
+static const uint32_t SEG_VERSION = 1;
+static const uint32_t SEG_NONE = 0xFFFFFFFFu;
+
+static const size_t SEG_HEADER_SIZE = 4096;
+static const uint32_t SEG_PID_SLOTS = 32768;  // открытая адресация, степень двойки; до 24k pid на сегмент
+static const uint32_t SEG_TS_ENTRIES = 1024;  // одна точка индекса на (data_capacity / 1024) байт
+static const size_t SEG_DEFAULT_SIZE = 16u << 20;
+static const int SEG_MAX_MB = 4095;            // смещения записей — uint32_t, SEG_NONE занят
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seq;
+    uint64_t segment_size;
+    uint64_t data_capacity;
+    uint64_t data_size;
+    uint64_t records;
+    int64_t first_ts;
+    int64_t last_ts;
+    uint32_t pid_count;
+    uint32_t ts_count;
+    uint32_t sealed;
+};
+
+struct SegPidEntry {
+    int32_t pid;       // 0 — свободно
+    uint32_t last;     // смещение последней записи этого pid
+};
+
+struct SegTsEntry {
+    int64_t ts;
+    uint64_t offset;
+};
+
+struct SegRecord {
+    int64_t ts;        // CLOCK_REALTIME, нс
+    int32_t pid;       // 0 — сообщение без pid (например, служебное от teacher)
+    uint32_t len;
+    uint32_t prev;     // предыдущая запись того же pid в этом сегменте
+    uint32_t reserved;
+    // далее len байт текста, выравнивание до 8
+};
+
+inline size_t seg_meta_size() {
+    return SEG_HEADER_SIZE + SEG_PID_SLOTS * sizeof(SegPidEntry) + SEG_TS_ENTRIES * sizeof(SegTsEntry);
+}
+
+inline int64_t seg_now_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+inline uint32_t seg_pid_hash(int32_t pid) {
+    return ((uint32_t)pid * 2654435761u) & (SEG_PID_SLOTS - 1);
+}
+
+// Сегмент, отображённый в память (и для записи, и для чтения)
+struct Segment {
+    uint8_t *base = nullptr;
+    size_t size = 0;
+
+    SegmentHeader *hdr() const { return (SegmentHeader *)base; }
+    SegPidEntry *pids() const { return (SegPidEntry *)(base + SEG_HEADER_SIZE); }
+    SegTsEntry *ts_index() const { return (SegTsEntry *)((uint8_t *)pids() + SEG_PID_SLOTS * sizeof(SegPidEntry)); }
+    uint8_t *data() const { return base + seg_meta_size(); }
+    SegRecord *record(uint64_t off) const { return (SegRecord *)(data() + off); }
+
+    SegPidEntry *find_pid(int32_t pid, bool insert) const {
+        SegPidEntry *tab = pids();
+        for (uint32_t i = seg_pid_hash(pid), n = 0; n < SEG_PID_SLOTS; i = (i + 1) & (SEG_PID_SLOTS - 1), ++n) {
+            if (tab[i].pid == pid) return &tab[i];
+            if (tab[i].pid == 0) {
+                if (!insert) return nullptr;
+                tab[i].pid = pid;
+                tab[i].last = SEG_NONE;
+                hdr()->pid_count++;
+                return &tab[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void unmap() {
+        if (base) munmap(base, size);
+        base = nullptr;
+        size = 0;
+    }
+};
+
+inline std::string seg_path(const std::string &dir, uint64_t seq) {
+    char name[32];
+    snprintf(name, sizeof(name), "/seg-%08llu.log", (unsigned long long)seq);
+    return dir + name;
+}
+
+// Номера всех сегментов каталога по возрастанию
+inline std::vector<uint64_t> seg_list(const std::string &dir) {
+    std::vector<uint64_t> out;
+    DIR *d = opendir(dir.c_str());
+    if (!d) return out;
+    while (dirent *e = readdir(d)) {
+        unsigned long long seq;
+        if (sscanf(e->d_name, "seg-%llu.log", &seq) == 1) out.push_back(seq);
+    }
+    closedir(d);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+inline bool seg_open_read(const std::string &dir, uint64_t seq, Segment &seg) {
+    int fd = open(seg_path(dir, seq).c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < seg_meta_size()) {
+        close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return false;
+    seg.base = (uint8_t *)p;
+    seg.size = st.st_size;
+    if (seg.hdr()->magic != SEG_MAGIC || seg.hdr()->version != SEG_VERSION) {
+        seg.unmap();
+        return false;
+    }
+    return true;
+}
+
+// Писатель: дописывает записи в текущий сегмент и открывает следующий, когда место кончилось
+struct SegmentWriter {
+    std::string dir;
+    size_t segment_size = SEG_DEFAULT_SIZE;
+    uint64_t seq = 0;
+    uint64_t ts_stride = 0;
+    Segment cur;
+
+    bool open_dir(const std::string &d, size_t size) {
+        dir = d;
+        segment_size = size;
+        if (segment_size < seg_meta_size() * 2) segment_size = seg_meta_size() * 2;
+        if (mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST) {
+            perror("mkdir segments");
+            return false;
+        }
+        std::vector<uint64_t> existing = seg_list(dir);
+        seq = existing.empty() ? 0 : existing.back() + 1;
+        return rotate();
+    }
+
+    bool rotate() {
+        if (cur.base) {
+            cur.hdr()->sealed = 1;
+            msync(cur.base, cur.size, MS_ASYNC);
+            cur.unmap();
+            seq++;
+        }
+        int fd = open(seg_path(dir, seq).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            perror("open segment");
+            return false;
+        }
+        if (ftruncate(fd, segment_size) < 0) {
+            perror("ftruncate segment");
+            close(fd);
+            return false;
+        }
+        void *p = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            perror("mmap segment");
+            return false;
+        }
+        cur.base = (uint8_t *)p;
+        cur.size = segment_size;
+
+        // файл после ftruncate уже заполнен нулями, достаточно заголовка
+        SegmentHeader *h = cur.hdr();
+        h->magic = SEG_MAGIC;
+        h->version = SEG_VERSION;
+        h->seq = seq;
+        h->segment_size = segment_size;
+        h->data_capacity = segment_size - seg_meta_size();
+        ts_stride = h->data_capacity / SEG_TS_ENTRIES;
+        return true;
+    }
+
+    bool append(int64_t ts, int32_t pid, const char *text, uint32_t len) {
+        size_t need = (sizeof(SegRecord) + len + 7) & ~(size_t)7;
+        if (need > segment_size - seg_meta_size()) return false;
+
+        SegmentHeader *h = cur.hdr();
+        if (h->data_size + need > h->data_capacity || h->pid_count >= SEG_PID_SLOTS * 3 / 4) {
+            if (!rotate()) return false;
+            h = cur.hdr();
+        }
+
+        uint64_t off = h->data_size;
+        SegRecord *r = cur.record(off);
+        r->ts = ts;
+        r->pid = pid;
+        r->len = len;
+        r->prev = SEG_NONE;
+        memcpy(r + 1, text, len);
+
+        if (pid != 0) {
+            SegPidEntry *e = cur.find_pid(pid, true);
+            r->prev = e->last;
+            e->last = (uint32_t)off;
+        }
+        if (h->ts_count < SEG_TS_ENTRIES && off >= h->ts_count * ts_stride) {
+            cur.ts_index()[h->ts_count] = SegTsEntry{ts, off};
+            h->ts_count++;
+        }
+        if (h->records == 0) h->first_ts = ts;
+        h->last_ts = ts;
+        h->records++;
+        // data_size публикуется последним: читатель видит только целые записи
+        __atomic_store_n(&h->data_size, off + need, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    void close_all() {
+        if (cur.base) {
+            cur.hdr()->sealed = 1;
+            msync(cur.base, cur.size, MS_SYNC);
+            cur.unmap();
+        }
+    }
+};
+
+struct SegHit {
+    int64_t ts;
+    int32_t pid;
+    std::string text;
+};
+
+// История одного pid: по каждому сегменту идём по цепочке prev от последней записи
+inline void seg_query_pid(const std::string &dir, int32_t pid, std::vector<SegHit> &out) {
+    for (uint64_t seq : seg_list(dir)) {
+        Segment seg;
+        if (!seg_open_read(dir, seq, seg)) continue;
+        const SegPidEntry *e = seg.find_pid(pid, false);
+        size_t first = out.size();
+        uint64_t limit = __atomic_load_n(&seg.hdr()->data_size, __ATOMIC_ACQUIRE);
+        for (uint32_t off = e ? e->last : SEG_NONE; off != SEG_NONE && off < limit; ) {
+            const SegRecord *r = seg.record(off);
+            out.push_back(SegHit{r->ts, r->pid, std::string((const char *)(r + 1), r->len)});
+            off = r->prev;
+        }
+        std::reverse(out.begin() + first, out.end());
+        seg.unmap();
+    }
+}
+
+// Записи в интервале [from, to]: сегменты отбрасываются по first_ts/last_ts,
+// начало внутри сегмента ищется двоичным поиском по разреженному индексу
+inline void seg_query_time(const std::string &dir, int64_t from, int64_t to, std::vector<SegHit> &out) {
+    for (uint64_t seq : seg_list(dir)) {
+        Segment seg;
+        if (!seg_open_read(dir, seq, seg)) continue;
+        const SegmentHeader *h = seg.hdr();
+        if (h->records == 0 || h->last_ts < from || h->first_ts > to) {
+            seg.unmap();
+            continue;
+        }
+        const SegTsEntry *idx = seg.ts_index();
+        uint32_t lo = 0, hi = h->ts_count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (idx[mid].ts < from) lo = mid + 1; else hi = mid;
+        }
+        uint64_t off = lo > 0 ? idx[lo - 1].offset : 0;
+        uint64_t limit = __atomic_load_n(&h->data_size, __ATOMIC_ACQUIRE);
+        while (off < limit) {
+            const SegRecord *r = seg.record(off);
+            if (r->ts > to) break;
+            if (r->ts >= from) out.push_back(SegHit{r->ts, r->pid, std::string((const char *)(r + 1), r->len)});
+            off += (sizeof(SegRecord) + r->len + 7) & ~(uint64_t)7;
+        }
+        seg.unmap();
+    }
+}
+
+// pid из строки лога: "[STUDENT <pid>] ..." или "... PID=<pid>"
+inline int32_t seg_parse_pid(const char *line, size_t len) {
+    static const char student[] = "[STUDENT ";
+    static const char pid_tag[] = "PID=";
+    const char *p = nullptr;
+    if (len > sizeof(student) - 1 && memcmp(line, student, sizeof(student) - 1) == 0) {
+        p = line + sizeof(student) - 1;
+    } else {
+        const char *q = (const char *)memmem(line, len, pid_tag, sizeof(pid_tag) - 1);
+        if (q) p = q + sizeof(pid_tag) - 1;
+    }
+    if (!p) return 0;
+    int32_t pid = 0;
+    while (p < line + len && *p >= '0' && *p <= '9') pid = pid * 10 + (*p++ - '0');
+    return pid;
+}
+
+#endif // SEGMENT_LOG_H
@@ -0,0 +1,563 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <queue>
+#include <set>
+#include <random>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "slot_table.h"
+#include "rooms.h"
+#include "trace.h"
+#include "replay.h"
+
+using namespace std;
+
+// Модель экзамена в виртуальном времени (дискретно-событийная симуляция).
+// Слоты и комнаты — настоящие: SharedData в обычной памяти и те же переходы, что у
+// teacher/student (Slots<>::reserve/publish/take_waiting/release, room_*, route_student),
+// поэтому порядок выбора студента (младший занятый слот, кража из чужих комнат) тот же.
+// Подготовка и проверка — события в календаре (очередь с приоритетом по времени) вместо sleep.
+// Простаивающий проверяющий комнаты, как grade_room, ждёт свою очередь по 50 мс и между
+// ожиданиями заглядывает в чужие. Упрощения: IPC и ack мгновенны, студент ждёт без таймаута.
+// --policy 4-6 — политика 4-6/exam.cpp: у каждого студента свой слот (его номер), поэтому
+// никто не уходит без места, один преподаватель берёт ждущего с младшим номером,
+// подготовка 1..4 с, проверка 1..3 с.
+
+typedef Slots<SLOT_MASK_BITS> SimSlots;
+
+enum SimPolicy {
+    POLICY_10 = 0,   // таблица слотов 10/ (teacher/student, --rooms)
+    POLICY_4_6       // 4-6/exam.cpp
+};
+
+enum EvKind {
+    EV_ARRIVE = 0,   // студент запущен: начинает подготовку
+    EV_READY,        // подготовка закончена: резервирует слот и публикуется
+    EV_DONE,         // проверяющий закончил проверку
+    EV_POLL          // истекло ожидание своей очереди (комнаты): проверить чужие
+};
+
+struct Event {
+    int64_t t;       // нс виртуального времени
+    uint64_t seq;    // при равном времени — в порядке планирования
+    int kind;
+    long student;    // EV_POLL: номер ожидания проверяющего
+    int grader;
+
+    bool operator>(const Event &o) const { return t != o.t ? t > o.t : seq > o.seq; }
+};
+
+struct SimStudent {
+    int64_t arrive = 0;
+    int64_t ready = 0;
+    int32_t pid = 0;
+    int prep_ms = 0;
+    int grade_ms = 0;
+};
+
+struct Grader {
+    bool busy = false;
+    int slot = -1;
+    int from = -1;       // комната, из которой взят студент
+    int64_t taken = 0;
+    int64_t busy_ns = 0;
+    uint64_t graded = 0;
+    uint64_t stolen = 0;
+    long poll = 0;       // текущее ожидание; устаревшие EV_POLL пропускаются
+};
+
+struct SimConfig {
+    int policy = POLICY_10;
+    long students = 1000;
+    int capacity = 64;
+    int rooms = 0;
+    int route = ROUTE_HASH;
+    double rate = 0;            // прибытий в секунду (Пуассон); 0 — все сразу, как run_students.sh
+    int prep_lo = -1, prep_hi = -1;     // мс, равномерно; -1 — 1..3 с целыми секундами, как student
+                                        // (1..4 с в --policy 4-6)
+    int grade_lo = -1, grade_hi = -1;   // мс; -1 — 1..3 с, как teacher
+    uint64_t seed = 1;
+};
+
+struct SimResult {
+    long students = 0, graded = 0, balked = 0;
+    int64_t first = 0, last = 0;        // первое прибытие и последнее событие
+    uint64_t events = 0;
+    double queue_avg = 0;               // среднее по времени число ждущих (WAITING)
+    long queue_peak = 0;
+    vector<double> wait_ms;             // от публикации до взятия на проверку
+    vector<double> slot_ms;             // от публикации до оценки (как wait в трассе 7.14)
+    vector<double> sojourn_ms;          // от запуска до оценки
+    vector<Grader> graders;
+    double wall_s = 0;
+};
+
+struct Sim {
+    SimConfig cfg;
+    SharedData *shm = nullptr;
+    size_t shm_size = 0;
+    Room *rooms = nullptr;
+    vector<SimStudent> st;
+    vector<long> in_slot;   // слот -> студент
+    set<long> waiting_ids;  // --policy 4-6: ждущие по номеру, он же слот
+    vector<Grader> graders;
+    priority_queue<Event, vector<Event>, greater<Event>> cal;
+    uint64_t seq = 0;
+    int64_t now = 0;
+    mt19937_64 rng;
+    SimResult res;
+    long waiting = 0;
+    long remaining = 0;     // ещё не проверены и не ушли; 0 — проверяющие больше не ждут
+    int64_t last_change = 0;
+    double area = 0;        // интеграл числа ждущих по времени, нс
+
+    bool init(const SimConfig &c) {
+        cfg = c;
+        rng.seed(c.seed);
+        if (c.policy == POLICY_4_6) {
+            graders.assign(1, Grader{});
+            return true;
+        }
+        size_t rooms_offset = (sizeof(SharedData) + c.capacity * sizeof(StudentSlot) + 63) & ~(size_t)63;
+        shm_size = (rooms_offset + c.rooms * sizeof(Room) + 63) & ~(size_t)63;
+        shm = (SharedData *)aligned_alloc(64, shm_size);
+        if (!shm) return false;
+        memset((void *)shm, 0, shm_size);
+        shm->capacity = c.capacity;
+        shm->rooms_offset = rooms_offset;
+        slot_table_init(shm, c.capacity);
+        if (c.rooms > 0) {
+            rooms_init(shm, c.rooms, c.route);
+            rooms = rooms_of(shm);
+        }
+        in_slot.assign(c.capacity, -1);
+        graders.assign(c.rooms > 0 ? c.rooms : 1, Grader{});
+        return true;
+    }
+
+    ~Sim() { free(shm); }
+
+    void schedule(int64_t t, int kind, long student, int grader = -1) {
+        cal.push(Event{t, seq++, kind, student, grader});
+    }
+
+    int draw_ms(int lo, int hi, int max_s = 3) {
+        if (lo < 0) return 1000 * (1 + (int)(rng() % (uint64_t)max_s));
+        return lo + (int)(rng() % (uint64_t)(hi - lo + 1));
+    }
+
+    void queue_change(long delta) {
+        area += (double)waiting * (now - last_change);
+        last_change = now;
+        waiting += delta;
+        res.queue_peak = max(res.queue_peak, waiting);
+    }
+
+    // Как grade_room: своя комната, затем (steal) чужие по кругу
+    int take(int k, int &from, bool steal) {
+        if (cfg.policy == POLICY_4_6) {
+            // exam.cpp: первый по номеру студент в состоянии 1
+            from = -1;
+            if (waiting_ids.empty()) return -1;
+            long s = *waiting_ids.begin();
+            waiting_ids.erase(waiting_ids.begin());
+            return (int)s;
+        }
+        if (!rooms) {
+            from = -1;
+            return SimSlots::take_waiting(shm);
+        }
+        int m = steal ? cfg.rooms : 1;
+        for (int d = 0; d < m; ++d) {
+            int r = (k + d) % m;
+            if (d > 0 && __atomic_load_n(&rooms[r].waiting, __ATOMIC_RELAXED) == 0) continue;
+            int idx = room_take_waiting(shm, rooms[r]);
+            if (idx >= 0) {
+                from = r;
+                return idx;
+            }
+        }
+        return -1;
+    }
+
+    void try_grade(int k, bool steal) {
+        Grader &g = graders[k];
+        if (g.busy) return;
+        int from;
+        int idx = take(k, from, steal);
+        if (idx < 0) {
+            if (rooms && steal && remaining > 0) schedule(now + 50000000, EV_POLL, ++g.poll, k);
+            return;
+        }
+        g.poll++;
+        queue_change(-1);
+        long s = cfg.policy == POLICY_4_6 ? idx : in_slot[idx];
+        g.busy = true;
+        g.slot = idx;
+        g.from = from;
+        g.taken = now;
+        res.wait_ms.push_back((now - st[s].ready) / 1e6);
+        schedule(now + (int64_t)st[s].grade_ms * 1000000, EV_DONE, s, k);
+    }
+
+    void on_ready(long s) {
+        SimStudent &x = st[s];
+        x.ready = now;
+        if (cfg.policy == POLICY_4_6) {
+            waiting_ids.insert(s);
+            queue_change(1);
+            try_grade(0, false);
+            return;
+        }
+        int slot = -1, room = -1;
+        if (rooms) {
+            int start = route_student(shm, x.pid);
+            for (int d = 0; d < cfg.rooms && slot < 0; ++d) {
+                int k = (start + d) % cfg.rooms;
+                slot = room_reserve(shm, rooms[k]);
+                if (slot >= 0) room = k;
+            }
+        } else {
+            slot = SimSlots::reserve(shm);
+        }
+        if (slot < 0) {
+            res.balked++;   // "No free slots, leaving"
+            remaining--;
+            res.last = now;
+            return;
+        }
+        shm->slots[slot].pid = x.pid;
+        in_slot[slot] = s;
+        if (rooms) room_publish(shm, rooms[room], slot);
+        else SimSlots::publish(shm, slot);
+        queue_change(1);
+
+        // очередь комнаты будит только её проверяющего; чужие заметят студента по EV_POLL
+        try_grade(rooms ? room : 0, false);
+    }
+
+    void on_done(long s, int k) {
+        Grader &g = graders[k];
+        SimStudent &x = st[s];
+        // в 4-6 слот — номер студента, освобождать нечего
+        if (cfg.policy != POLICY_4_6) {
+            if (rooms) room_release(shm, rooms[g.from], g.slot);
+            else SimSlots::release(shm, g.slot);
+            in_slot[g.slot] = -1;
+        }
+        g.busy_ns += now - g.taken;
+        g.graded++;
+        if (rooms && g.from != k) g.stolen++;
+        g.busy = false;
+        res.graded++;
+        remaining--;
+        res.last = now;
+        res.slot_ms.push_back((now - x.ready) / 1e6);
+        res.sojourn_ms.push_back((now - x.arrive) / 1e6);
+        try_grade(k, true);
+    }
+
+    // students заполнен заранее (запись нагрузки) или пуст — тогда прибытия генерируются
+    SimResult run(vector<SimStudent> preset = {}) {
+        timespec w0{}, w1{};
+        clock_gettime(CLOCK_MONOTONIC, &w0);
+        exponential_distribution<double> gap(cfg.rate > 0 ? cfg.rate : 1.0);
+        if (!preset.empty()) {
+            st = move(preset);
+            cfg.students = (long)st.size();
+            for (long i = 0; i < cfg.students; ++i) schedule(st[i].arrive, EV_ARRIVE, i);
+        } else {
+            st.resize(cfg.students);
+            schedule(0, EV_ARRIVE, 0);
+        }
+        res.students = cfg.students;
+        remaining = cfg.students;
+        res.first = st.empty() ? 0 : st[0].arrive;
+        now = last_change = res.first;
+        for (int k = 0; rooms && k < cfg.rooms; ++k) try_grade(k, true);
+
+        while (!cal.empty()) {
+            Event e = cal.top();
+            cal.pop();
+            now = e.t;
+            res.events++;
+            if (e.kind == EV_ARRIVE) {
+                SimStudent &x = st[e.student];
+                if (preset.empty() && x.pid == 0) {
+                    // генерируемое прибытие: параметры студента и следующее прибытие
+                    x.arrive = now;
+                    x.pid = 1000 + (int32_t)e.student;
+                    x.prep_ms = draw_ms(cfg.prep_lo, cfg.prep_hi, cfg.policy == POLICY_4_6 ? 4 : 3);
+                    x.grade_ms = draw_ms(cfg.grade_lo, cfg.grade_hi);
+                    if (e.student + 1 < cfg.students) {
+                        int64_t next = cfg.rate > 0 ? now + (int64_t)(gap(rng) * 1e9) : now;
+                        schedule(next, EV_ARRIVE, e.student + 1);
+                    }
+                }
+                schedule(now + (int64_t)x.prep_ms * 1000000, EV_READY, e.student);
+            } else if (e.kind == EV_READY) {
+                on_ready(e.student);
+            } else if (e.kind == EV_POLL) {
+                if (!graders[e.grader].busy && graders[e.grader].poll == e.student) try_grade(e.grader, true);
+            } else {
+                on_done(e.student, e.grader);
+            }
+        }
+        now = res.last;
+        queue_change(0);
+        res.queue_avg = res.last > res.first ? area / (res.last - res.first) : 0;
+        res.graders = graders;
+        clock_gettime(CLOCK_MONOTONIC, &w1);
+        res.wall_s = (w1.tv_sec - w0.tv_sec) + (w1.tv_nsec - w0.tv_nsec) / 1e9;
+        return move(res);
+    }
+};
+
+double percentile(vector<double> &v, double p) {
+    if (v.empty()) return 0;
+    sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+void print_result(SimResult &r) {
+    double span = (r.last - r.first) / 1e9;
+    printf("students=%ld graded=%ld left_no_slot=%ld simulated=%.3f s\n", r.students, r.graded, r.balked, span);
+    printf("events=%llu wall=%.3f s (%.0f events/s)\n", (unsigned long long)r.events, r.wall_s,
+           r.wall_s > 0 ? r.events / r.wall_s : 0.0);
+    printf("queue: avg=%.2f peak=%ld\n", r.queue_avg, r.queue_peak);
+    printf("%-10s %10s %10s %10s %10s %10s\n", "ms", "mean", "p50", "p90", "p99", "max");
+    struct { const char *name; vector<double> *v; } rows[] = {
+        {"wait", &r.wait_ms}, {"in_slot", &r.slot_ms}, {"sojourn", &r.sojourn_ms}};
+    for (auto &row : rows) {
+        vector<double> &v = *row.v;
+        double sum = 0;
+        for (double x : v) sum += x;
+        double p50 = percentile(v, 0.5), p90 = percentile(v, 0.9), p99 = percentile(v, 0.99);
+        printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f\n", row.name, v.empty() ? 0 : sum / v.size(), p50, p90, p99,
+               v.empty() ? 0 : v.back());
+    }
+    for (size_t k = 0; k < r.graders.size(); ++k) {
+        Grader &g = r.graders[k];
+        printf("grader %zu: graded=%llu stolen=%llu utilization=%.1f%%\n", k, (unsigned long long)g.graded,
+               (unsigned long long)g.stolen, span > 0 ? g.busy_ns / 1e9 / span * 100 : 0.0);
+    }
+}
+
+// Студенты из записи нагрузки (7.15); не проверенным в записи — медиана записанного времени
+vector<SimStudent> from_recording(const Recording &rec) {
+    vector<double> grade;
+    for (const Arrival &a : rec.students) {
+        if (a.grade_ms >= 0) grade.push_back(a.grade_ms);
+    }
+    int fallback = (int)percentile(grade, 0.5);
+    vector<SimStudent> v;
+    for (const Arrival &a : rec.students) {
+        SimStudent s;
+        s.arrive = (int64_t)a.t;
+        s.pid = a.pid;
+        s.prep_ms = a.prep_ms;
+        s.grade_ms = a.grade_ms >= 0 ? a.grade_ms : fallback;
+        v.push_back(s);
+    }
+    return v;
+}
+
+pid_t spawn(const vector<string> &args) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        vector<char *> argv;
+        for (const string &a : args) argv.push_back(const_cast<char *>(a.c_str()));
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+void compare_row(const char *name, double real, double sim) {
+    printf("%-16s %10.1f %10.1f %+9.1f%%\n", name, real, sim, real != 0 ? (sim - real) / real * 100 : 0.0);
+}
+
+// Сверка с настоящим прогоном: ./teacher --record --trace и n студентов (--exam simcheck),
+// затем та же нагрузка (моменты запуска, подготовка, проверка из записи) в симуляции.
+// Сравниваются число проверенных, время в слоте (wait из трассы) и время до последней оценки.
+int validate(const SimConfig &c, int prep_max) {
+    set_exam_id("simcheck");
+    vector<string> teacher = {"./teacher", to_string(c.capacity), "--grade-ms", to_string(max(c.grade_lo, 0)),
+                              "--transport", "futex", "--trace", "--record", "--exam", "simcheck"};
+    if (c.rooms > 0) {
+        teacher.push_back("--rooms");
+        teacher.push_back(to_string(c.rooms));
+    }
+    pid_t t = spawn(teacher);
+    usleep(300000);
+    mt19937_64 rng(c.seed);
+    vector<pid_t> kids;
+    for (long i = 0; i < c.students; ++i) {
+        kids.push_back(spawn({"./student", "--prep-ms", to_string((int)(rng() % (uint64_t)(prep_max + 1))),
+                              "--exam", "simcheck"}));
+    }
+    for (pid_t k : kids) waitpid(k, nullptr, 0);
+    kill(t, SIGINT);
+    waitpid(t, nullptr, 0);
+
+    Recording rec;
+    if (!load_recording(exam_name(RECORD_NAME), rec)) return 1;
+    FILE *f = fopen(exam_name(TRACE_NAME).c_str(), "rb");
+    TraceHeader h{};
+    if (!f || fread(&h, sizeof(h), 1, f) != 1 || h.magic != TRACE_MAGIC) {
+        fprintf(stderr, "validate: no trace\n");
+        if (f) fclose(f);
+        return 1;
+    }
+    vector<double> real_slot;
+    long real_graded = 0;
+    uint64_t real_last = 0;
+    TraceRecord r;
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+        if (r.kind == SPAN_WAIT && r.grade >= 0) real_slot.push_back((r.end - r.start) / 1e6);
+        if (r.kind == SPAN_GRADE) {
+            real_graded++;
+            real_last = max(real_last, r.end);
+        }
+    }
+    fclose(f);
+    unlink(exam_name(TRACE_NAME).c_str());
+    unlink(exam_name(RECORD_NAME).c_str());
+
+    Sim sim;
+    if (!sim.init(c)) return 1;
+    SimResult s = sim.run(from_recording(rec));
+    double real_span = real_last > rec.students[0].t ? (real_last - rec.students[0].t) / 1e6 : 0;
+    double sim_span = (s.last - s.first) / 1e6;
+
+    printf("%-16s %10s %10s %10s\n", "metric", "real", "sim", "diff");
+    compare_row("graded", real_graded, s.graded);
+    compare_row("in_slot p50 ms", percentile(real_slot, 0.5), percentile(s.slot_ms, 0.5));
+    compare_row("in_slot p90 ms", percentile(real_slot, 0.9), percentile(s.slot_ms, 0.9));
+    compare_row("in_slot max ms", real_slot.empty() ? 0 : real_slot.back(), s.slot_ms.empty() ? 0 : s.slot_ms.back());
+    compare_row("last grade ms", real_span, sim_span);
+    return 0;
+}
+
+bool parse_range(const char *s, int &lo, int &hi) {
+    char *end;
+    lo = (int)strtol(s, &end, 10);
+    hi = lo;
+    if (*end == '-') hi = (int)strtol(end + 1, &end, 10);
+    return *end == '\0' && lo >= 0 && hi >= lo;
+}
+
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: ./sim [--students N] [--capacity C] [--rooms M [--route hash|least|fill]]\n"
+                        "             [--policy 10|4-6]\n"
+                        "             [--rate R] [--prep-ms A[-B]] [--grade-ms A[-B]] [--seed S]\n"
+                        "       ./sim --workload FILE [--capacity C] [--rooms M]\n"
+                        "       ./sim --validate [--students N] [--capacity C] [--rooms M] [--grade-ms G]"
+                        " [--prep-ms MAX]\n";
+    SimConfig c;
+    string workload;
+    bool check = false;
+    bool capacity_set = false, rooms_set = false;
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        bool has = i + 1 < argc;
+        if (a == "--students" && has) {
+            c.students = atol(argv[++i]);
+        } else if (a == "--capacity" && has) {
+            c.capacity = atoi(argv[++i]);
+            capacity_set = true;
+        } else if (a == "--rooms" && has) {
+            c.rooms = atoi(argv[++i]);
+            rooms_set = true;
+        } else if (a == "--route" && has) {
+            string r = argv[++i];
+            c.route = r == "hash" ? ROUTE_HASH : r == "least" ? ROUTE_LEAST : r == "fill" ? ROUTE_FILL : -1;
+            if (c.route < 0) {
+                cerr << usage;
+                return 1;
+            }
+        } else if (a == "--rate" && has) {
+            c.rate = atof(argv[++i]);
+        } else if (a == "--prep-ms" && has) {
+            if (!parse_range(argv[++i], c.prep_lo, c.prep_hi)) {
+                cerr << usage;
+                return 1;
+            }
+        } else if (a == "--grade-ms" && has) {
+            if (!parse_range(argv[++i], c.grade_lo, c.grade_hi)) {
+                cerr << usage;
+                return 1;
+            }
+        } else if (a == "--policy" && has) {
+            string p = argv[++i];
+            c.policy = p == "10" ? POLICY_10 : p == "4-6" ? POLICY_4_6 : -1;
+            if (c.policy < 0) {
+                cerr << usage;
+                return 1;
+            }
+        } else if (a == "--seed" && has) {
+            c.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (a == "--workload" && has) {
+            workload = argv[++i];
+        } else if (a == "--validate") {
+            check = true;
+        } else {
+            cerr << usage;
+            return 1;
+        }
+    }
+
+    Recording rec;
+    if (!workload.empty()) {
+        if (!load_recording(workload, rec)) return 1;
+        if (!capacity_set) c.capacity = rec.h.capacity;
+        if (!rooms_set) c.rooms = rec.h.rooms;
+    }
+    if (c.policy == POLICY_4_6 && (c.rooms > 0 || check)) {
+        cerr << "--policy 4-6 models a single teacher and has no real run to validate against\n";
+        return 1;
+    }
+    if (c.policy == POLICY_4_6) c.capacity = 1;   // не используется: слот у каждого студента
+    if (c.students <= 0 || c.capacity <= 0 || c.capacity > SLOT_MASK_BITS || c.rate < 0) {
+        cerr << "Students must be > 0, capacity 1.." << SLOT_MASK_BITS << ", rate >= 0\n";
+        return 1;
+    }
+    if (c.rooms < 0 || c.rooms > c.capacity) {
+        cerr << "Rooms must be 0..capacity\n";
+        return 1;
+    }
+
+    if (check) {
+        if (c.students > 2000) {
+            cerr << "Validation runs real processes: at most 2000 students\n";
+            return 1;
+        }
+        // по умолчанию короткие интервалы, чтобы настоящий прогон шёл секунды
+        if (c.grade_lo < 0) c.grade_lo = c.grade_hi = 20;
+        int prep_max = c.prep_lo < 0 ? 500 : c.prep_hi;
+        return validate(c, prep_max);
+    }
+
+    Sim sim;
+    if (!sim.init(c)) {
+        perror("sim");
+        return 1;
+    }
+    SimResult r = workload.empty() ? sim.run() : sim.run(from_recording(rec));
+    print_result(r);
+    return 0;
+}
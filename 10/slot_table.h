@@ -0,0 +1,256 @@
+#ifndef SLOT_TABLE_H
+#define SLOT_TABLE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "common.h"
+#include "transport.h"
+
+// Операции над таблицей слотов без общего lock: слот переходит между состояниями CAS
+// по StudentSlot::word (состояние в битах 0..2, оценка протокола 2 в 3..7, номер перехода
+// в старших 24 — он же защищает от ABA), выигравший CAS владеет слотом до следующего перехода.
+//   студент:  reserve (EMPTY -> RESERVED), publish (-> WAITING), cancel (WAITING -> EMPTY)
+//   teacher:  take_waiting (WAITING -> PROCESSING), release (-> EMPTY)
+// Маски free_mask / wait_mask — подсказки для поиска: бит ставится после смены состояния,
+// снимает его владелец слота. Лишний бит стоит только неудачного CAS.
+// Slots<Capacity> ищет по маскам, число слов известно при компиляции.
+// GenericSlots — линейный обход состояний до shm->capacity (для сравнения).
+
+inline uint32_t slot_next(uint32_t w, int to) {
+    return ((w & ~0xFFu) + 0x100) | (uint32_t)to;
+}
+
+inline int slot_state(SharedData *shm, int i) {
+    return slot_state_of(shm->slots[i].word.load(std::memory_order_acquire));
+}
+
+inline void slot_table_init(SharedData *shm, int capacity) {
+    for (int w = 0; w < SLOT_MASK_WORDS; ++w) {
+        int lo = w * 64;
+        int n = capacity - lo;
+        shm->free_mask[w] = n >= 64 ? ~0ull : n > 0 ? (1ull << n) - 1 : 0;
+        shm->wait_mask[w] = 0;
+    }
+    for (int k = 0; k < ACTIVE_SHARDS; ++k) shm->active[k].value.store(0, std::memory_order_relaxed);
+}
+
+inline void slot_set_bit(unsigned long long *m, int i) {
+    __atomic_fetch_or(&m[i >> 6], 1ull << (i & 63), __ATOMIC_RELEASE);
+}
+
+inline void slot_clear_bit(unsigned long long *m, int i) {
+    __atomic_fetch_and(&m[i >> 6], ~(1ull << (i & 63)), __ATOMIC_RELAXED);
+}
+
+// Неудача — только если состояние уже не from (номер мог смениться и вернуться к from).
+// Барьер после перехода: поля слота новый владелец пишет после смены слова (slot_read)
+inline bool slot_cas(SharedData *shm, int i, int from, int to) {
+    std::atomic<uint32_t> &word = shm->slots[i].word;
+    uint32_t w = word.load(std::memory_order_relaxed);
+    while (slot_state_of(w) == from) {
+        if (word.compare_exchange_weak(w, slot_next(w, to), std::memory_order_acq_rel)) {
+            std::atomic_thread_fence(std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Протокол 2: оценка и слот уходят студенту одним переходом PROCESSING -> DONE и одним
+// FUTEX_WAKE по слову. false — студент ушёл во время проверки (ERROR), слот освобождает
+// вызывающий
+inline bool slot_hand_back(SharedData *shm, int i, int grade) {
+    std::atomic<uint32_t> &word = shm->slots[i].word;
+    uint32_t w = word.load(std::memory_order_relaxed);
+    while (slot_state_of(w) == SLOT_PROCESSING) {
+        if (word.compare_exchange_weak(w, slot_next(w, SLOT_DONE) | (uint32_t)(grade & 0x1F) << 3,
+                                       std::memory_order_acq_rel)) {
+            futex_call(reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, 1, nullptr);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Протокол 2, завершение экзамена: разбудить студентов, ждущих на слове слота
+inline void slot_wake_all(SharedData *shm) {
+    for (int i = 0; i < shm->capacity; ++i) {
+        int st = slot_state_of(shm->slots[i].word.load(std::memory_order_relaxed));
+        if (st == SLOT_WAITING || st == SLOT_PROCESSING) {
+            futex_call(reinterpret_cast<uint32_t *>(&shm->slots[i].word), FUTEX_WAKE, 1, nullptr);
+        }
+    }
+}
+
+// Переход владельца слота: кроме него слово сейчас никто не меняет
+inline void slot_set_state(SharedData *shm, int i, int to) {
+    std::atomic<uint32_t> &word = shm->slots[i].word;
+    word.store(slot_next(word.load(std::memory_order_relaxed), to), std::memory_order_release);
+}
+
+// Первый слот из [lo, hi) с битом в маске m, для которого удался CAS from -> to; бит снимается
+inline int slot_claim(SharedData *shm, unsigned long long *m, int lo, int hi, int from, int to) {
+    for (int w = lo >> 6; w <= (hi - 1) >> 6; ++w) {
+        unsigned long long bits = __atomic_load_n(&m[w], __ATOMIC_ACQUIRE);
+        if (w == lo >> 6) bits &= ~0ull << (lo & 63);
+        if (w == (hi - 1) >> 6 && (hi & 63)) bits &= (1ull << (hi & 63)) - 1;
+        while (bits) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            if (slot_cas(shm, i, from, to)) {
+                slot_clear_bit(m, i);
+                return i;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return -1;
+}
+
+// Переходы владельца слота (состояние уже принадлежит вызывающему)
+inline void slot_publish(SharedData *shm, int i) {
+    active_add(shm, i, 1);
+    slot_set_state(shm, i, SLOT_WAITING);
+    slot_set_bit(shm->wait_mask, i);
+}
+
+// pid обнуляется: в RESERVED он тогда либо 0, либо нового владельца (reap в teacher)
+inline void slot_unreserve(SharedData *shm, int i) {
+    __atomic_store_n(&shm->slots[i].pid, 0, __ATOMIC_RELAXED);
+    slot_set_state(shm, i, SLOT_EMPTY);
+    slot_set_bit(shm->free_mask, i);
+}
+
+inline void slot_release(SharedData *shm, int i) {
+    slot_clear_bit(shm->wait_mask, i);
+    active_add(shm, i, -1);
+    slot_unreserve(shm, i);
+}
+
+// Студент уходит, не дождавшись: false — teacher уже забрал слот и освободит его сам.
+// Через RESERVED, чтобы бит ожидания снимался, пока слот ещё ничей для остальных.
+// WAITING здесь — своя регистрация, пока teacher освобождает слот только после ack студента
+inline bool slot_cancel(SharedData *shm, int i) {
+    if (!slot_cas(shm, i, SLOT_WAITING, SLOT_RESERVED)) return false;
+    slot_clear_bit(shm->wait_mask, i);
+    active_add(shm, i, -1);
+    slot_unreserve(shm, i);
+    return true;
+}
+
+template <int Capacity>
+struct Slots {
+    static_assert(Capacity > 0 && Capacity <= SLOT_MASK_BITS && Capacity % 64 == 0, "capacity class");
+
+    static int reserve(SharedData *shm) {
+        return slot_claim(shm, shm->free_mask, 0, Capacity, SLOT_EMPTY, SLOT_RESERVED);
+    }
+
+    static int take_waiting(SharedData *shm) {
+        return slot_claim(shm, shm->wait_mask, 0, Capacity, SLOT_WAITING, SLOT_PROCESSING);
+    }
+
+    static void publish(SharedData *shm, int i) { slot_publish(shm, i); }
+    static void release(SharedData *shm, int i) { slot_release(shm, i); }
+};
+
+struct GenericSlots {
+    static int scan(SharedData *shm, unsigned long long *m, int from, int to) {
+        for (int i = 0; i < shm->capacity; ++i) {
+            if (slot_state_of(shm->slots[i].word.load(std::memory_order_relaxed)) == from
+                && slot_cas(shm, i, from, to)) {
+                slot_clear_bit(m, i);
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    static int reserve(SharedData *shm) { return scan(shm, shm->free_mask, SLOT_EMPTY, SLOT_RESERVED); }
+    static int take_waiting(SharedData *shm) { return scan(shm, shm->wait_mask, SLOT_WAITING, SLOT_PROCESSING); }
+    static void publish(SharedData *shm, int i) { slot_publish(shm, i); }
+    static void release(SharedData *shm, int i) { slot_release(shm, i); }
+};
+
+// Снимок таблицы для читателей (stats, наблюдатели), без lock и без записи в сегмент.
+// Слот читается как под seqlock: слово, поля, снова слово — при смене перечитывается.
+// pid/ticket берутся только у WAITING/PROCESSING: их пишут до публикации, а в RESERVED
+// они ещё заполняются. Таблица целиком — двойным обходом: если повторный обход увидел
+// те же слова (номера переходов не повторяются), все слоты были такими в момент его
+// начала. Под постоянной сменой слотов обходы ограничены max_passes, и тогда снимок
+// согласован только послотово (consistent = false).
+struct SlotView {
+    uint32_t word = 0;
+    pid_t pid = 0;
+    int ticket = 0;
+
+    int state() const { return slot_state_of(word); }
+};
+
+struct TableSnapshot {
+    std::vector<SlotView> slots;
+    int count[SLOT_RESERVED + 1] = {};   // по SlotState
+    int passes = 0;
+    bool consistent = false;
+};
+
+inline SlotView slot_read(SharedData *shm, int i) {
+    StudentSlot &s = shm->slots[i];
+    for (;;) {
+        SlotView v;
+        v.word = s.word.load(std::memory_order_acquire);
+        if (v.state() == SLOT_WAITING || v.state() == SLOT_PROCESSING) {
+            v.pid = __atomic_load_n(&s.pid, __ATOMIC_RELAXED);
+            v.ticket = __atomic_load_n(&s.ticket, __ATOMIC_RELAXED);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.word.load(std::memory_order_relaxed) == v.word) return v;
+    }
+}
+
+inline bool table_snapshot(SharedData *shm, int n, TableSnapshot &snap, int max_passes = 8) {
+    snap.slots.resize(n);
+    for (int i = 0; i < n; ++i) snap.slots[i] = slot_read(shm, i);
+    snap.passes = 1;
+    snap.consistent = false;
+    while (!snap.consistent && snap.passes < max_passes) {
+        snap.passes++;
+        snap.consistent = true;
+        for (int i = 0; i < n; ++i) {
+            if (shm->slots[i].word.load(std::memory_order_acquire) != snap.slots[i].word) {
+                snap.slots[i] = slot_read(shm, i);
+                snap.consistent = false;
+            }
+        }
+    }
+    for (int &c : snap.count) c = 0;
+    for (const SlotView &v : snap.slots) {
+        if (v.state() <= SLOT_RESERVED) snap.count[v.state()]++;
+    }
+    return snap.consistent;
+}
+
+// Выбор специализации по runtime-параметрам: транспорт приводится к конкретному
+// final-классу (вызовы без виртуальной диспетчеризации), вместимость — к классу 64/256/1024.
+// F — функтор с template <class SlotsT, class Sync> int operator()(Sync &) const.
+template <class Sync, class F>
+int with_capacity(int capacity, Sync &t, F &&f) {
+    if (capacity <= 64) return f.template operator()<Slots<64>>(t);
+    if (capacity <= 256) return f.template operator()<Slots<256>>(t);
+    return f.template operator()<Slots<SLOT_MASK_BITS>>(t);
+}
+
+template <class F>
+int with_policy(Transport *tr, int kind, int capacity, bool generic, F &&f) {
+    if (generic) return f.template operator()<GenericSlots>(*tr);
+    switch (kind) {
+        case TR_NAMED_SEM:   return with_capacity(capacity, static_cast<NamedSemTransport &>(*tr), f);
+        case TR_UNNAMED_SEM: return with_capacity(capacity, static_cast<UnnamedSemTransport &>(*tr), f);
+        case TR_FUTEX:       return with_capacity(capacity, static_cast<FutexTransport &>(*tr), f);
+        case TR_EVENTFD:
+        case TR_PIPE:        return with_capacity(capacity, static_cast<FdTransport &>(*tr), f);
+        default:             return f.template operator()<GenericSlots>(*tr);
+    }
+}
+
+#endif // SLOT_TABLE_H
@@ -0,0 +1,133 @@
+#ifndef SOCK_PROTO_H
+#define SOCK_PROTO_H
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// Протокол teacher <-> student поверх сокетов (sock_teacher / sock_student).
+// Каждое сообщение: uint32 длина тела (без самого поля длины) + тело.
+// Порядок тот же, что в варианте с разделяемой памятью:
+//   student -> REGISTER(pid, ticket)
+//   teacher -> GRADE(grade)        grade = -1, если экзамен завершён
+//   student -> ACK
+// Если свободных мест нет, teacher отвечает REJECT и закрывает соединение.
+
+static const char *SOCK_PATH = "/tmp/exam_sock";
+static const int SOCK_PORT = 5555;
+
+enum MsgType : uint32_t {
+    MSG_REGISTER = 1,
+    MSG_GRADE,
+    MSG_ACK,
+    MSG_REJECT
+};
+
+struct Msg {
+    uint32_t len;    // sizeof(Msg) - sizeof(len)
+    uint32_t type;
+    int32_t a;       // REGISTER: pid,    GRADE: оценка
+    int32_t b;       // REGISTER: билет
+};
+
+static const uint32_t MSG_BODY = sizeof(Msg) - sizeof(uint32_t);
+
+inline Msg make_msg(MsgType type, int32_t a = 0, int32_t b = 0) {
+    return Msg{MSG_BODY, (uint32_t)type, a, b};
+}
+
+// Адрес из флагов: --unix [path] (по умолчанию) или --tcp [port] на 127.0.0.1
+struct SockAddr {
+    sockaddr_storage ss{};
+    socklen_t len = 0;
+    bool tcp = false;
+};
+
+inline SockAddr sock_addr_unix(const char *path) {
+    SockAddr a;
+    sockaddr_un *un = (sockaddr_un *)&a.ss;
+    un->sun_family = AF_UNIX;
+    strncpy(un->sun_path, path, sizeof(un->sun_path) - 1);
+    a.len = sizeof(sockaddr_un);
+    return a;
+}
+
+inline SockAddr sock_addr_tcp(int port) {
+    SockAddr a;
+    sockaddr_in *in = (sockaddr_in *)&a.ss;
+    in->sin_family = AF_INET;
+    in->sin_port = htons(port);
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    a.len = sizeof(sockaddr_in);
+    a.tcp = true;
+    return a;
+}
+
+inline int sock_connect(const SockAddr &a) {
+    int fd = socket(a.ss.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (const sockaddr *)&a.ss, a.len) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (a.tcp) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+// Блокирующие чтение/запись сообщения целиком (для студента)
+inline bool sock_send(int fd, const Msg &m) {
+    const char *p = (const char *)&m;
+    size_t left = sizeof(m);
+    while (left > 0) {
+        ssize_t w = send(fd, p, left, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        p += w;
+        left -= w;
+    }
+    return true;
+}
+
+inline bool sock_recv(int fd, Msg &m) {
+    char *p = (char *)&m;
+    size_t left = sizeof(m);
+    while (left > 0) {
+        ssize_t r = recv(fd, p, left, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        left -= r;
+    }
+    return m.len == MSG_BODY;
+}
+
+// Самое длинное тело, которое принимается от клиента: хватает на расширения протокола,
+// но не даёт одному соединению копить во входном буфере гигабайты
+static const uint32_t MSG_MAX_BODY = 256;
+
+// Разбор входного буфера неблокирующего соединения: достаёт одно целое сообщение.
+// Тела длиннее известного пропускаются, поэтому протокол можно расширять.
+// 1 — сообщение в m, 0 — нужно дочитать, -1 — длина больше MSG_MAX_BODY, соединение закрыть
+inline int sock_take(std::string &in, Msg &m) {
+    if (in.size() < sizeof(uint32_t)) return 0;
+    uint32_t len;
+    memcpy(&len, in.data(), sizeof(len));
+    if (len > MSG_MAX_BODY) return -1;
+    if (in.size() < sizeof(uint32_t) + len) return 0;
+    memset(&m, 0, sizeof(m));
+    memcpy(&m, in.data(), sizeof(uint32_t) + (len < MSG_BODY ? len : MSG_BODY));
+    in.erase(0, sizeof(uint32_t) + len);
+    return 1;
+}
+
+#endif // SOCK_PROTO_H
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <csignal>
+#include <ctime>
+
+#include "common.h"
+#include "sock_proto.h"
+
+using namespace std;
+
+// Студент для sock_teacher: тот же сценарий, что у student.cpp, но через сокет
+
+void print_local(const string &s) { cout << s << endl; }
+
+void send_fifo_one(const string &s) {
+    int fd = open(exam_name(FIFO_NAME).c_str(), O_WRONLY | O_NONBLOCK);
+    if (fd >= 0) {
+        write(fd, s.c_str(), s.size());
+        close(fd);
+    }
+}
+
+void log_both(const string &who, const string &msg) {
+    string s = "[" + who + "] " + msg + "\n";
+    print_local(s);
+    send_fifo_one(s);
+}
+
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: ./sock_student [--unix [path] | --tcp [port]] [--prep-ms N] [--exam ID]\n";
+    if (!take_exam_arg(argc, argv)) {
+        cerr << usage;
+        return 1;
+    }
+    string default_path = exam_name(SOCK_PATH);
+    SockAddr addr = sock_addr_unix(default_path.c_str());
+    int prep_ms = -1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--unix") == 0) {
+            const char *path = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : default_path.c_str();
+            addr = sock_addr_unix(path);
+        } else if (strcmp(argv[i], "--tcp") == 0) {
+            int port = (i + 1 < argc && argv[i + 1][0] != '-') ? atoi(argv[++i]) : SOCK_PORT;
+            addr = sock_addr_tcp(port);
+        } else if (strcmp(argv[i], "--prep-ms") == 0 && i + 1 < argc) {
+            prep_ms = atoi(argv[++i]);
+        } else {
+            cerr << usage;
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    pid_t pid = getpid();
+    srand((unsigned)time(nullptr) ^ pid);
+    string who = "STUDENT " + to_string(pid);
+
+    int fd = sock_connect(addr);
+    if (fd < 0) {
+        cout << "[STUDENT " << pid << "] Teacher not running.\n";
+        return 0;
+    }
+
+    int ticket = 1 + rand() % 100;
+    int prep = prep_ms >= 0 ? prep_ms : 1000 * (1 + rand() % 3);
+
+    log_both(who, "Preparing " + to_string(prep) + "ms, ticket=" + to_string(ticket));
+    usleep(prep * 1000);
+
+    Msg m;
+    if (!sock_send(fd, make_msg(MSG_REGISTER, pid, ticket))) {
+        log_both(who, "Teacher closed the connection");
+        close(fd);
+        return 0;
+    }
+
+    if (!sock_recv(fd, m)) {
+        log_both(who, "Exam ended before receiving grade");
+        close(fd);
+        return 0;
+    }
+    if (m.type == MSG_REJECT) {
+        log_both(who, "No free slots, leaving");
+        close(fd);
+        return 0;
+    }
+    if (m.type != MSG_GRADE || m.a < 0) {
+        log_both(who, "Exam ended before receiving grade");
+        close(fd);
+        return 0;
+    }
+
+    log_both(who, "Received grade: " + to_string(m.a));
+    sock_send(fd, make_msg(MSG_ACK));
+
+    close(fd);
+    return 0;
+}
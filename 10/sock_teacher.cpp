@@ -0,0 +1,400 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <unistd.h>
+#include <fcntl.h>
+#include <csignal>
+#include <ctime>
+#include <cerrno>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+
+#include "common.h"
+#include "sock_proto.h"
+
+using namespace std;
+
+// Преподаватель, принимающий студентов по Unix-сокету или TCP на localhost.
+// Один поток, один epoll: новые соединения, сообщения студентов и таймер проверки.
+
+enum ConnState {
+    CONN_NEW = 0,    // подключился, ещё не зарегистрировался
+    CONN_WAITING,    // в очереди
+    CONN_GRADING,    // идёт проверка (взведён таймер)
+    CONN_GRADED,     // оценка отправлена, ждём ACK
+    CONN_CLOSING     // отправлен REJECT, закрываем после отправки
+};
+
+struct Conn {
+    int fd;
+    ConnState state;
+    pid_t pid;
+    int ticket;
+    int grade;
+    string in;
+    string out;
+};
+
+static const uint64_t ID_LISTEN = 0;
+static const uint64_t ID_TIMER = 1;
+// студент отвечает сразу после оценки; молчит дольше — зависший, очередь не ждёт (как у teacher)
+static const int ACK_TIMEOUT_MS = 5000;
+
+int epfd = -1;
+int listen_fd = -1;
+int timer_fd = -1;
+int fifo_fd = -1;
+SockAddr addr;
+
+unordered_map<uint64_t, Conn> conns;
+deque<uint64_t> queue_ids;
+uint64_t next_id = 2;
+uint64_t current = 0;    // кого проверяем сейчас (0 — никого)
+int registered = 0;
+int capacity = 0;
+int grade_ms = -1;
+
+volatile sig_atomic_t running = 1;
+void handle_sigint(int) { running = 0; }
+
+void print_local(const string &s) {
+    cout << s << endl;
+}
+
+void send_fifo(const string &msg) {
+    if (fifo_fd >= 0) {
+        ssize_t w = write(fifo_fd, msg.c_str(), msg.size());
+        if (w == (ssize_t)msg.size()) return;
+    }
+    int fd = open(exam_name(FIFO_NAME).c_str(), O_WRONLY | O_NONBLOCK);
+    if (fd >= 0) {
+        write(fd, msg.c_str(), msg.size());
+        close(fd);
+    }
+}
+
+void log_msg_both(const string &who, const string &msg) {
+    string s = "[" + who + "] " + msg + "\n";
+    print_local(s);
+    send_fifo(s);
+}
+
+void set_events(uint64_t id, Conn &c) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | (c.out.empty() ? 0u : (uint32_t)EPOLLOUT);
+    ev.data.u64 = id;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+void close_conn(uint64_t id) {
+    auto it = conns.find(id);
+    if (it == conns.end()) return;
+    Conn &c = it->second;
+    if (c.state == CONN_WAITING || c.state == CONN_GRADING || c.state == CONN_GRADED) registered--;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+    close(c.fd);
+    conns.erase(it);
+}
+
+// Пишем сразу; что не влезло в сокет, уходит по EPOLLOUT
+bool flush_out(uint64_t id, Conn &c) {
+    bool had_out = !c.out.empty();
+    while (!c.out.empty()) {
+        ssize_t w = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+        if (w > 0) {
+            c.out.erase(0, w);
+            continue;
+        }
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && errno == EAGAIN) break;
+        return false;
+    }
+    if (had_out && c.out.empty()) set_events(id, c);
+    return true;
+}
+
+bool send_msg(uint64_t id, Conn &c, const Msg &m) {
+    bool was_empty = c.out.empty();
+    c.out.append((const char *)&m, sizeof(m));
+    if (!flush_out(id, c)) return false;
+    if (was_empty && !c.out.empty()) set_events(id, c);
+    // REJECT отправлен целиком — соединение больше не нужно
+    if (c.state == CONN_CLOSING && c.out.empty()) {
+        close_conn(id);
+    }
+    return true;
+}
+
+void arm_timer(int ms) {
+    itimerspec its{};
+    // нулевое значение выключает таймер, поэтому минимум — 1 нс
+    its.it_value.tv_sec = ms / 1000;
+    its.it_value.tv_nsec = (ms % 1000) * 1000000L;
+    if (ms == 0) its.it_value.tv_nsec = 1;
+    timerfd_settime(timer_fd, 0, &its, nullptr);
+}
+
+void start_next() {
+    while (current == 0 && !queue_ids.empty()) {
+        uint64_t id = queue_ids.front();
+        queue_ids.pop_front();
+        auto it = conns.find(id);
+        if (it == conns.end() || it->second.state != CONN_WAITING) continue;
+
+        Conn &c = it->second;
+        c.state = CONN_GRADING;
+        current = id;
+        log_msg_both("TEACHER", "Checking PID=" + to_string(c.pid) + " ticket=" + to_string(c.ticket));
+        arm_timer(grade_ms >= 0 ? grade_ms : 1000 * (1 + rand() % 3));
+    }
+}
+
+void finish_current() {
+    current = 0;
+    start_next();
+}
+
+void on_timer() {
+    uint64_t expirations;
+    read(timer_fd, &expirations, sizeof(expirations));
+
+    auto it = conns.find(current);
+    if (it == conns.end()) {
+        finish_current();
+        return;
+    }
+    Conn &c = it->second;
+    if (c.state == CONN_GRADED) {
+        // таймер ACK: оценка отправлена ACK_TIMEOUT_MS назад, ответа нет
+        log_msg_both("TEACHER", "No ACK from PID=" + to_string(c.pid) + ", dropping");
+        close_conn(current);
+        finish_current();
+        return;
+    }
+    c.grade = 3 + rand() % 3;
+    c.state = CONN_GRADED;
+    if (!send_msg(current, c, make_msg(MSG_GRADE, c.grade))) {
+        close_conn(current);
+        finish_current();
+        return;
+    }
+    if (conns.count(current)) arm_timer(ACK_TIMEOUT_MS);
+}
+
+void on_message(uint64_t id, Conn &c, const Msg &m) {
+    if (m.type == MSG_REGISTER && c.state == CONN_NEW) {
+        c.pid = m.a;
+        c.ticket = m.b;
+        if (registered >= capacity) {
+            c.state = CONN_CLOSING;
+            send_msg(id, c, make_msg(MSG_REJECT));
+            return;
+        }
+        c.state = CONN_WAITING;
+        registered++;
+        queue_ids.push_back(id);
+        start_next();
+        return;
+    }
+    if (m.type == MSG_ACK && c.state == CONN_GRADED) {
+        log_msg_both("TEACHER", "Grade=" + to_string(c.grade) + " PID=" + to_string(c.pid));
+        bool was_current = id == current;
+        close_conn(id);
+        if (was_current) finish_current();
+    }
+}
+
+void on_conn(uint64_t id, uint32_t events) {
+    auto it = conns.find(id);
+    if (it == conns.end()) return;
+    Conn &c = it->second;
+
+    if (events & EPOLLOUT) {
+        bool ok = flush_out(id, c);
+        if (!ok || (c.state == CONN_CLOSING && c.out.empty())) {
+            bool was_current = id == current;
+            close_conn(id);
+            if (was_current) finish_current();
+            return;
+        }
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        char buf[4096];
+        bool closed = false;
+        while (true) {
+            ssize_t r = recv(c.fd, buf, sizeof(buf), 0);
+            if (r > 0) {
+                c.in.append(buf, r);
+                continue;
+            }
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && errno == EAGAIN) break;
+            closed = true;
+            break;
+        }
+
+        Msg m;
+        int taken = 0;
+        while (conns.count(id) && (taken = sock_take(conns[id].in, m)) == 1) on_message(id, conns[id], m);
+        if (conns.count(id) && taken < 0) closed = true;
+
+        if (closed && conns.count(id)) {
+            bool was_current = id == current;
+            close_conn(id);
+            if (was_current) finish_current();
+        }
+    }
+}
+
+void on_accept() {
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            // EAGAIN — всех приняли; EMFILE — упёрлись в лимит дескрипторов
+            if (errno == EMFILE || errno == ENFILE) perror("accept");
+            return;
+        }
+        if (addr.tcp) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        uint64_t id = next_id++;
+        conns[id] = Conn{fd, CONN_NEW, 0, 0, 0, string(), string()};
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = id;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void raise_fd_limit() {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+void cleanup() {
+    log_msg_both("TEACHER", "Cleaning resources");
+    while (!conns.empty()) close_conn(conns.begin()->first);
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        if (!addr.tcp) unlink(((sockaddr_un *)&addr.ss)->sun_path);
+    }
+    if (timer_fd >= 0) close(timer_fd);
+    if (epfd >= 0) close(epfd);
+    if (fifo_fd >= 0) close(fifo_fd);
+}
+
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: ./sock_teacher <capacity> [--unix [path] | --tcp [port]] [--grade-ms N] [--exam ID]\n";
+    if (!take_exam_arg(argc, argv) || argc < 2) {
+        cerr << usage;
+        return 1;
+    }
+
+    capacity = atoi(argv[1]);
+    if (capacity <= 0 || capacity > (1 << 20)) {
+        cerr << "Capacity must be 1..1048576\n";
+        return 1;
+    }
+
+    string default_path = exam_name(SOCK_PATH);
+    addr = sock_addr_unix(default_path.c_str());
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--unix") == 0) {
+            const char *path = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : default_path.c_str();
+            addr = sock_addr_unix(path);
+        } else if (strcmp(argv[i], "--tcp") == 0) {
+            int port = (i + 1 < argc && argv[i + 1][0] != '-') ? atoi(argv[++i]) : SOCK_PORT;
+            addr = sock_addr_tcp(port);
+        } else if (strcmp(argv[i], "--grade-ms") == 0 && i + 1 < argc) {
+            grade_ms = atoi(argv[++i]);
+        } else {
+            cerr << usage;
+            return 1;
+        }
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = handle_sigint;
+    sigaction(SIGINT, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    srand((unsigned)time(nullptr));
+    raise_fd_limit();
+
+    if (mkfifo(exam_name(FIFO_NAME).c_str(), 0666) == -1 && errno != EEXIST) {
+        perror("mkfifo");
+    } else {
+        fifo_fd = open(exam_name(FIFO_NAME).c_str(), O_WRONLY | O_NONBLOCK);
+    }
+
+    listen_fd = socket(addr.ss.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    if (addr.tcp) {
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    } else {
+        unlink(((sockaddr_un *)&addr.ss)->sun_path);
+    }
+    if (bind(listen_fd, (sockaddr *)&addr.ss, addr.len) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        perror("bind/listen");
+        cleanup();
+        return 1;
+    }
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epfd < 0 || timer_fd < 0) {
+        perror("epoll/timerfd");
+        cleanup();
+        return 1;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = ID_LISTEN;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.u64 = ID_TIMER;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, timer_fd, &ev);
+
+    log_msg_both("TEACHER", string("Ready (") + (addr.tcp ? "tcp" : "unix") + "). Capacity=" + to_string(capacity));
+
+    epoll_event events[256];
+    while (running) {
+        int n = epoll_wait(epfd, events, 256, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            uint64_t id = events[i].data.u64;
+            if (id == ID_LISTEN) on_accept();
+            else if (id == ID_TIMER) on_timer();
+            else on_conn(id, events[i].events);
+        }
+    }
+
+    log_msg_both("TEACHER", "Shutdown: notifying all students");
+    for (auto &kv : conns) {
+        Conn &c = kv.second;
+        if (c.state == CONN_WAITING || c.state == CONN_GRADING) {
+            Msg m = make_msg(MSG_GRADE, -1);
+            send(c.fd, &m, sizeof(m), MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+    }
+
+    log_msg_both("TEACHER", "Exiting.");
+    cleanup();
+    return 0;
+}
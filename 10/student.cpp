@@ -3,26 +3,25 @@
 #include <unistd.h>
 #include <csignal>
 #include <fcntl.h>
-#include <sys/mman.h>
-#include <semaphore.h>
 #include <ctime>
-#include <sys/stat.h>
 #include <sys/types.h>
 
 #include "common.h"
+#include "transport.h"
+#include "slot_table.h"
+#include "placement.h"
+#include "rooms.h"
+#include "attach.h"
+#include "trace.h"
+#include "replay.h"
 
 using namespace std;
 
+ExamAttach exam;
 SharedData *shm = nullptr;
-int shm_fd = -1;
-sem_t *mutex_sem = nullptr;
-sem_t *queue_sem = nullptr;
-
-sem_t *grade_sem = nullptr;
-sem_t *ack_sem = nullptr;
-
-char grade_name[64];
-char ack_name[64];
+Transport *tr = nullptr;
+TraceBuf trace;
+RecordBuf record;
 
 volatile sig_atomic_t interrupted = 0;
 
@@ -31,7 +30,7 @@ void handle_sigint(int) { interrupted = 1; }
 void print_local(const string &s) { cout << s << endl; }
 
 void send_fifo_one(const string &s) {
-    int fd = open(FIFO_NAME, O_WRONLY | O_NONBLOCK);
+    int fd = open(exam_name(FIFO_NAME).c_str(), O_WRONLY | O_NONBLOCK);
     if (fd >= 0) {
         write(fd, s.c_str(), s.size());
         close(fd);
@@ -44,72 +43,114 @@ void log_both(const string &who, const string &msg) {
     send_fifo_one(s);
 }
 
+// Протокол 2: оценка приходит в слове слота (slot_hand_back). 1 — grade получена,
+// 0 — экзамен завершён или студента прервали
+int wait_grade_v2(int slot, int &grade) {
+    std::atomic<uint32_t> &word = shm->slots[slot].word;
+    while (!interrupted) {
+        uint32_t w = word.load(std::memory_order_acquire);
+        if (slot_state_of(w) == SLOT_DONE) {
+            grade = slot_grade_of(w);
+            return 1;
+        }
+        if (__atomic_load_n(&shm->shutdown, __ATOMIC_SEQ_CST)) break;
+        timespec ts{1, 0};
+        futex_call(reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, w, &ts);
+    }
+    return 0;
+}
+
 void cleanup() {
-    if (grade_sem) { sem_close(grade_sem); sem_unlink(grade_name); grade_sem = nullptr; }
-    if (ack_sem)   { sem_close(ack_sem);   sem_unlink(ack_name);   ack_sem = nullptr; }
-    if (mutex_sem) { sem_close(mutex_sem); mutex_sem = nullptr; }
-    if (queue_sem) { sem_close(queue_sem); queue_sem = nullptr; }
-    if (shm) { munmap(shm, sizeof(SharedData)); shm = nullptr; }
-    if (shm_fd >= 0) { close(shm_fd); shm_fd = -1; }
+    trace.flush();
+    record.flush();
+    exam_detach(exam);
+    shm = nullptr;
+    tr = nullptr;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    uint64_t t_start = trace_now();
+    // фиксированное время подготовки вместо случайных 1..3 с (для замеров)
+    int prep_ms = -1;
+    // replay: билет и время проверки из записи нагрузки
+    int ticket_arg = 0;
+    int grade_ms = -1;
+    bool populate = false;
+    const char *cpus = nullptr;
+    int numa = -1;
+    bool args_ok = take_exam_arg(argc, argv);
+    for (int i = 1; i < argc && args_ok; ++i) {
+        if (strcmp(argv[i], "--prep-ms") == 0 && i + 1 < argc) {
+            prep_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ticket") == 0 && i + 1 < argc) {
+            ticket_arg = atoi(argv[++i]);
+            if (ticket_arg < 1 || ticket_arg > 100) args_ok = false;
+        } else if (strcmp(argv[i], "--grade-ms") == 0 && i + 1 < argc) {
+            grade_ms = atoi(argv[++i]);
+            if (grade_ms < 0) args_ok = false;
+        } else if (strcmp(argv[i], "--populate") == 0) {
+            populate = true;
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            cpus = argv[++i];
+        } else if (strcmp(argv[i], "--numa") == 0 && i + 1 < argc) {
+            numa = atoi(argv[++i]);
+        } else {
+            args_ok = false;
+        }
+    }
+    if (!args_ok) {
+        cerr << "Usage: ./student [--prep-ms N] [--ticket 1..100] [--grade-ms N] [--populate] [--cpu LIST]"
+                " [--numa NODE] [--exam ID]\n";
+        return 1;
+    }
+
+    if (cpus && !pin_cpus(cpus)) {
+        perror("sched_setaffinity");
+        return 1;
+    }
+    if (numa >= 0 && !numa_prefer(numa)) perror("set_mempolicy");
+
     signal(SIGINT, handle_sigint);
 
     pid_t pid = getpid();
     srand((unsigned)time(nullptr) ^ pid);
 
-    shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
-    if (shm_fd < 0) {
+    string why;
+    AttachResult ar = exam_attach(exam, populate, &why);
+    if (ar == ATTACH_NO_TEACHER) {
         cout << "[STUDENT " << pid << "] Teacher not running.\n";
         return 0;
     }
-
-    // получаем размер
-    struct stat st;
-    if (fstat(shm_fd, &st) < 0) {
-        perror("fstat");
-        close(shm_fd);
-        return 1;
-    }
-    size_t map_size = st.st_size;
-    if (map_size < sizeof(SharedData)) {
-        cerr << "[STUDENT " << pid << "] shared memory too small\n";
-        close(shm_fd);
-        return 1;
-    }
-
-    shm = static_cast<SharedData *>(mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0));
-    if (shm == MAP_FAILED) {
-        perror("mmap");
-        close(shm_fd);
-        return 1;
-    }
-
-    mutex_sem = sem_open(MUTEX_NAME, 0);
-    queue_sem = sem_open(QUEUE_NAME, 0);
-    if (mutex_sem == SEM_FAILED || queue_sem == SEM_FAILED) {
-        perror("sem_open");
+    if (ar == ATTACH_INCOMPATIBLE) {
+        cerr << "[STUDENT " << pid << "] Incompatible exam segment: " << why << "\n";
         cleanup();
         return 1;
     }
-
-    sprintf(grade_name, "/grade_%d", pid);
-    sprintf(ack_name,   "/ack_%d",   pid);
-
-    grade_sem = sem_open(grade_name, O_CREAT, 0666, 0);
-    ack_sem   = sem_open(ack_name,   O_CREAT, 0666, 0);
-    if (grade_sem == SEM_FAILED || ack_sem == SEM_FAILED) {
-        perror("sem_open per-student");
+    if (ar != ATTACH_OK) {
+        perror("attach");
         cleanup();
         return 1;
     }
+    shm = exam.shm;
+    tr = exam.tr;
+    trace.on = shm->trace != 0;
+    record.on = shm->record != 0;
 
-    int ticket = 1 + rand() % 100;
+    int ticket = ticket_arg > 0 ? ticket_arg : 1 + rand() % 100;
     int prep = 1 + rand() % 3;
+    record.add(REC_ARRIVAL, t_start, pid, ticket, prep_ms >= 0 ? prep_ms : prep * 1000);
+
+    uint64_t t_prep = trace_now();
+    if (prep_ms >= 0) {
+        log_both("STUDENT " + to_string(pid), "Preparing " + to_string(prep_ms) + "ms, ticket=" + to_string(ticket));
+        usleep(prep_ms * 1000);
+    } else {
+        log_both("STUDENT " + to_string(pid), "Preparing " + to_string(prep) + "s, ticket=" + to_string(ticket));
+        sleep(prep);
+    }
 
-    log_both("STUDENT " + to_string(pid), "Preparing " + to_string(prep) + "s, ticket=" + to_string(ticket));
-    sleep(prep);
+    uint64_t t_reg = trace_now();
+    trace.add(SPAN_PREPARE, t_prep, t_reg, pid, -1, -1, -1);
 
     if (interrupted || shm->shutdown) {
         log_both("STUDENT " + to_string(pid), "Interrupted during preparation");
@@ -119,63 +160,114 @@ int main() {
 
     int slot = -1;
 
-    sem_wait(mutex_sem);
-    if (!shm->shutdown) {
-        for (int i = 0; i < shm->capacity; ++i) {
-            if (shm->slots[i].state == SLOT_EMPTY) {
+    // маски в сегменте рассчитаны на SLOT_MASK_BITS, поэтому хватает одной специализации
+    typedef Slots<SLOT_MASK_BITS> StudentSlots;
+    // --rooms: начать с комнаты по маршруту teacher, при заполненной — следующая
+    int room = -1;
+    Room *rooms = shm->rooms > 0 ? rooms_of(shm) : nullptr;
+    // слот занимается CAS (RESERVED), заполняется и только потом публикуется как WAITING;
+    // shutdown проверяется после резервирования, иначе notify_all_students может его пропустить.
+    // Так же и closed (examctl drain): teacher считает drain законченным по пустым слотам.
+    // pid пишется сразу после CAS: по нему teacher освобождает слот, если студента убьют
+    // до публикации
+    auto refused = [&] {
+        return __atomic_load_n(&shm->shutdown, __ATOMIC_SEQ_CST) || __atomic_load_n(&shm->closed, __ATOMIC_SEQ_CST);
+    };
+    if (rooms) {
+        int start = route_student(shm, pid);
+        for (int d = 0; d < shm->rooms && slot == -1 && !refused(); ++d) {
+            int k = (start + d) % shm->rooms;
+            int i = room_reserve(shm, rooms[k]);
+            if (i < 0) continue;
+            shm->slots[i].pid = pid;
+            if (refused() || !exam_attach_slot(exam, i, populate)) {
+                room_unreserve(shm, rooms[k], i);
+                continue;
+            }
+            slot = i;
+            room = k;
+            shm->slots[i].ticket = ticket;
+            shm->slots[i].grade_ms = grade_ms;
+            room_publish(shm, rooms[k], i);
+        }
+    } else {
+        int i = StudentSlots::reserve(shm);
+        if (i >= 0) {
+            shm->slots[i].pid = pid;
+            if (refused() || !exam_attach_slot(exam, i, populate)) {
+                slot_unreserve(shm, i);
+            } else {
                 slot = i;
-                shm->slots[i].state = SLOT_WAITING;
-                shm->slots[i].pid = pid;
                 shm->slots[i].ticket = ticket;
-                strncpy(shm->slots[i].grade_sem_name, grade_name, sizeof(shm->slots[i].grade_sem_name)-1);
-                strncpy(shm->slots[i].ack_sem_name,   ack_name,   sizeof(shm->slots[i].ack_sem_name)-1);
-                shm->active_students++;
-                break;
+                shm->slots[i].grade_ms = grade_ms;
+                StudentSlots::publish(shm, i);
             }
         }
     }
-    sem_post(mutex_sem);
+
+    uint64_t t_wait = trace_now();
+    trace.add(SPAN_REGISTER, t_reg, t_wait, pid, slot, room, -1);
 
     if (slot == -1) {
-        log_both("STUDENT " + to_string(pid), "No free slots, leaving");
+        log_both("STUDENT " + to_string(pid), __atomic_load_n(&shm->closed, __ATOMIC_SEQ_CST)
+                 ? "Exam closed for admission, leaving" : "No free slots, leaving");
         cleanup();
         return 0;
-    }log_both("STUDENT " + to_string(pid), "Registered in slot " + to_string(slot));
-    sem_post(queue_sem);
+    }
+    log_both("STUDENT " + to_string(pid), "Registered in slot " + to_string(slot)
+              + (room >= 0 ? " room " + to_string(room) : string()));
+    if (room >= 0) fsem_post(&rooms[room].queue);
+    else tr->post_queue();
 
+    bool v2 = shm->protocol == PROTO_V2;
     bool received = false;
-    while (!interrupted) {
-        timespec ts{};
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += 1;
-
-        int r = sem_timedwait(grade_sem, &ts);
-        if (r == 0) {
-            received = true;
-            break;
+    int grade = -1;
+    if (v2) {
+        received = wait_grade_v2(slot, grade) == 1;
+    } else {
+        while (!interrupted) {
+            if (tr->wait_grade(slot, 1000) == 1) {
+                // семафорные транспорты будят при завершении через grade со значением -1
+                // (broadcast_shutdown): это не оценка, студент уходит как на остальных
+                received = shm->slots[slot].grade >= 0;
+                break;
+            }
+            if (shm->shutdown) break;
         }
-        if (shm->shutdown) break;
     }
 
+    uint64_t t_ack = trace_now();
+
     if (!received) {
+        trace.add(SPAN_WAIT, t_wait, t_ack, pid, slot, room, -1);
         log_both("STUDENT " + to_string(pid), "Exam ended before receiving grade");
-        sem_wait(mutex_sem);
-        shm->slots[slot].state = SLOT_EMPTY;
-        shm->active_students--;
-        sem_post(mutex_sem);
+        bool cancelled = room >= 0 ? room_cancel(shm, rooms[room], slot) : slot_cancel(shm, slot);
+        // teacher уже проверяет: слот освободит он. v1 — ack, чтобы не ждал ушедшего студента;
+        // v2 — PROCESSING -> ERROR, и slot_hand_back вернёт teacher слот. Не удалось — оценка
+        // уже в слове (DONE), слот освобождается здесь
+        if (!cancelled && !v2) tr->post_ack(slot);
+        if (!cancelled && v2 && !slot_cas(shm, slot, SLOT_PROCESSING, SLOT_ERROR)) {
+            if (room >= 0) room_release(shm, rooms[room], slot);
+            else slot_release(shm, slot);
+        }
         cleanup();
         return 0;
     }
 
-    int grade = shm->slots[slot].grade;
+    if (!v2) grade = shm->slots[slot].grade;
+    trace.add(SPAN_WAIT, t_wait, t_ack, pid, slot, room, grade);
     log_both("STUDENT " + to_string(pid), "Received grade: " + to_string(grade));
 
-    sem_post(ack_sem);
-
-    sem_wait(mutex_sem);
-    shm->slots[slot].state = SLOT_EMPTY;
-    shm->active_students--;
-    sem_post(mutex_sem);
+    if (v2) {
+        // слот уже у студента (DONE): освободить его — и есть ack
+        if (room >= 0) room_release(shm, rooms[room], slot);
+        else slot_release(shm, slot);
+    } else {
+        // слот освобождает teacher после ack: если освободить его и здесь, teacher может
+        // затереть регистрацию следующего студента, успевшего занять этот слот
+        tr->post_ack(slot);
+    }
+    trace.add(SPAN_ACK, t_ack, trace_now(), pid, slot, room, grade);
 
     cleanup();
     return 0;
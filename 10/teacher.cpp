@@ -8,19 +8,50 @@
 #include <semaphore.h>
 #include <sys/stat.h>
 #include <cerrno>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
 
 #include "common.h"
+#include "event_loop.h"
+#include "transport.h"
+#include "slot_table.h"
+#include "placement.h"
+#include "rooms.h"
+#include "trace.h"
+#include "replay.h"
+#include "reclaim.h"
 
 using namespace std;
 
 SharedData *shm = nullptr;
 int shm_fd = -1;
-sem_t *mutex_sem = nullptr;
-sem_t *queue_sem = nullptr;
+Transport *tr = nullptr;
 int fifo_fd = -1;
 size_t shm_size = 0;
+bool huge_file = false;   // сегмент в hugetlbfs (HUGE_SHM_PATH), а не в /dev/shm
 
-volatile sig_atomic_t running = 1;
+// SIGINT/SIGTERM заблокированы во всех потоках и читаются из sig_fd обычным кодом:
+// обработчика сигнала нет, завершение (лог, оповещение студентов) идёт вне его
+std::atomic<bool> running{true};
+int sig_fd = -1;
+
+// --loop: записи лога идут через цикл событий пачками
+EventLoop *loop = nullptr;
+
+// --trace: интервалы проверки основного потока (у потоков комнат свои буферы)
+TraceBuf trace;
+// --record: время каждой проверки для replay
+RecordBuf record;
 
 void print_local(const string &s) {
     cout << s << endl;
@@ -31,50 +62,106 @@ void send_fifo(const string &msg) {
         ssize_t w = write(fifo_fd, msg.c_str(), msg.size());
         if (w == (ssize_t)msg.size()) return;
     }
-    int fd = open(FIFO_NAME, O_WRONLY | O_NONBLOCK);
+    int fd = open(exam_name(FIFO_NAME).c_str(), O_WRONLY | O_NONBLOCK);
     if (fd >= 0) {
         write(fd, msg.c_str(), msg.size());
         close(fd);
     }
 }
 
+// --rooms: пишут несколько проверяющих потоков
+std::mutex log_mutex;
+
 void log_msg_both(const string &who, const string &msg) {
     string s = "[" + who + "] " + msg + "\n";
+    if (loop) {
+        loop->write(STDOUT_FILENO, s + "\n");
+        if (fifo_fd >= 0) loop->write(fifo_fd, s);
+        return;
+    }
+    std::lock_guard<std::mutex> g(log_mutex);
     print_local(s);
     send_fifo(s);
 }
 
+// Настройки, меняемые через управляющий сокет (AdminServer). Проверка читает их
+// relaxed-загрузкой, пишет только поток сокета — lock на горячем пути не появляется
+struct AdminSettings {
+    std::atomic<int> grade_ms{-2};      // -2 — значение --grade-ms, -1 — случайные 1..3 с
+    std::atomic<bool> paused{false};    // новые проверки не начинаются, начатые доводятся
+    std::atomic<bool> quiet{false};     // без строк Checking/Grade по каждому студенту
+};
+AdminSettings admin;
+// проверено студентов с запуска (для stats)
+std::atomic<uint64_t> graded_total{0};
+
+void log_student(const string &who, const string &msg) {
+    if (!admin.quiet.load(std::memory_order_relaxed)) log_msg_both(who, msg);
+}
+
+void count_graded() {
+    graded_total.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Студент проверяет shutdown после резервирования слота, поэтому lock не нужен:
+// флаг, затем одно оповещение через транспорт (для futex и fd — O(1), а не по слотам)
 void notify_all_students() {
     log_msg_both("TEACHER", "Shutdown: notifying all students");
-    sem_wait(mutex_sem);
-    shm->shutdown = true;
-
-    for (int i = 0; i < shm->capacity; ++i) {
-        if (shm->slots[i].state == SLOT_WAITING ||
-            shm->slots[i].state == SLOT_PROCESSING) {
+    // процессорное время потока: разбуженные студенты вытесняют teacher, и по часам
+    // получилось бы время их работы, а не оповещения
+    timespec t0{}, t1{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+    __atomic_store_n(&shm->shutdown, true, __ATOMIC_SEQ_CST);
+    tr->broadcast_shutdown(shm);
+    if (shm->protocol == PROTO_V2) slot_wake_all(shm);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+    long us = (t1.tv_sec - t0.tv_sec) * 1000000 + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    log_msg_both("TEACHER", "Shutdown: notified in " + to_string(us) + " us cpu");
+}
 
-            shm->slots[i].grade = -1;
-            sem_t *g = sem_open(shm->slots[i].grade_sem_name, 0);
-            if (g != SEM_FAILED) {
-                sem_post(g);
-                sem_close(g);
-            }
-        }
+// Дождаться SIGINT/SIGTERM на sig_fd
+int wait_signal() {
+    signalfd_siginfo si;
+    while (read(sig_fd, &si, sizeof(si)) != sizeof(si)) {
+        if (errno != EINTR) return -1;
     }
-    sem_post(mutex_sem);
+    return 1;
 }
 
-void handle_sigint(int) {
-    running = 0;
-    log_msg_both("TEACHER", "SIGINT received, finishing...");
-    notify_all_students();
-    if (queue_sem) sem_post(queue_sem);
+// Разбудить wait_signal без внешнего сигнала (сигнал процессу, а не потоку: его
+// прочитает signalfd в любом потоке)
+void raise_stop() {
+    kill(getpid(), SIGTERM);
+}
+
+// SIGUSR1 без SA_RESTART: прерывает ожидание потока (wait_ack, usleep) при завершении
+void wake_grader(int) {}
+
+double now_sec() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Как часто проверяется, жив ли студент, не приславший ack
+static const int ACK_ALIVE_MS = 100;
+
+// Ожидание ack студента pid. false — студент умер, не ответив (SIGKILL): без проверки
+// проверяющий ждал бы его вечно
+template <class T>
+bool wait_ack_alive(T &t, int idx, pid_t pid) {
+    int r;
+    while ((r = t.wait_ack(idx, ACK_ALIVE_MS)) != 1 && running) {
+        if (r == 0 && kill(pid, 0) == -1 && errno == ESRCH) return false;
+    }
+    return true;
 }
 
 void cleanup() {
     log_msg_both("TEACHER", "Cleaning resources");
-    if (mutex_sem) { sem_close(mutex_sem); sem_unlink(MUTEX_NAME); mutex_sem = nullptr; }
-    if (queue_sem) { sem_close(queue_sem); sem_unlink(QUEUE_NAME); queue_sem = nullptr; }
+    trace.flush();
+    record.flush();
+    if (tr) { tr->destroy(); delete tr; tr = nullptr; }
 
     if (shm) {
         munmap(shm, shm_size);
@@ -82,7 +169,8 @@ void cleanup() {
     }
     if (shm_fd >= 0) {
         close(shm_fd);
-        shm_unlink(SHM_NAME);
+        if (huge_file) unlink(exam_name(HUGE_SHM_PATH).c_str());
+        else shm_unlink(exam_name(SHM_NAME).c_str());
         shm_fd = -1;
     }
 
@@ -92,140 +180,1166 @@ void cleanup() {
     }
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: ./teacher <capacity>\n";
-        return 1;
+// Время проверки: заданное студентом (replay), --grade-ms или случайные 1..3 с
+int grading_ms(const StudentSlot &s, int grade_ms, unsigned *seed) {
+    if (s.grade_ms >= 0) return s.grade_ms;
+    int set = admin.grade_ms.load(std::memory_order_relaxed);
+    if (set != -2) grade_ms = set;
+    if (grade_ms >= 0) return grade_ms;
+    return 1000 * (1 + (seed ? rand_r(seed) : rand()) % 3);
+}
+
+// Ожидания транспорта (семафоры, futex) нельзя поставить в epoll/io_uring, поэтому их
+// выполняет вспомогательный поток и сообщает о них через eventfd.
+// repeat = true: ждёт один канал бесконечно (очередь), иначе — по одному arm().
+struct WaitBridge {
+    int efd = -1;
+    std::function<int()> wait_fn;     // 1 — дождались
+    std::function<void()> wake_fn;    // разбудить wait_fn при остановке
+    bool armed = false;
+    bool repeat = false;
+    bool stop = false;
+    std::mutex m;
+    std::condition_variable cv;
+    std::thread th;
+    std::atomic<uint64_t> syscalls{0};
+
+    bool start(bool rep) {
+        repeat = rep;
+        efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (efd < 0) return false;
+        th = std::thread([this] { run(); });
+        return true;
     }
 
-    int capacity = atoi(argv[1]);
-    if (capacity <= 0 || capacity > 1024) {
-        cerr << "Capacity must be 1..1024\n";
-        return 1;
+    void arm(std::function<int()> w, std::function<void()> wake) {
+        std::lock_guard<std::mutex> g(m);
+        wait_fn = std::move(w);
+        wake_fn = std::move(wake);
+        armed = true;
+        cv.notify_one();
     }
 
-    signal(SIGINT, handle_sigint);
-    srand((unsigned)time(nullptr));
+    void run() {
+        while (true) {
+            std::function<int()> w;
+            {
+                std::unique_lock<std::mutex> g(m);
+                cv.wait(g, [this] { return stop || armed; });
+                if (stop) return;
+                w = wait_fn;
+            }
+            while (w() != 1) {}
+            if (!repeat) {
+                std::lock_guard<std::mutex> g(m);
+                armed = false;
+            }
+            uint64_t one = 1;
+            write(efd, &one, sizeof(one));
+            syscalls += 2;
+        }
+    }
 
-    if (mkfifo(FIFO_NAME, 0666) == -1 && errno != EEXIST) {
-        perror("mkfifo");
-    } else {
-        fifo_fd = open(FIFO_NAME, O_WRONLY | O_NONBLOCK);
-        if (fifo_fd < 0) {
-            fifo_fd = -1;
+    void finish() {
+        {
+            std::lock_guard<std::mutex> g(m);
+            stop = true;
+            // разбудить поток, если он стоит в ожидании
+            if (armed && wake_fn) wake_fn();
+            cv.notify_one();
         }
+        if (th.joinable()) th.join();
+        if (efd >= 0) close(efd);
     }
+};
+
+typedef Slots<SLOT_MASK_BITS> LoopSlots;
 
-    shm_size = sizeof(SharedData) + capacity * sizeof(StudentSlot);
-    shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
-    if (shm_fd < 0) {
-        perror("shm_open");
+// Метка события цикла: вид в битах 28..31, для сессий проверки — слот и поколение сессии.
+// По поколению узнаются устаревшие события (таймаут ack уже завершённой сессии)
+static const uint64_t TAG_READY = 1;
+static const uint64_t TAG_GRADED = 2;
+static const uint64_t TAG_ACK = 3;
+static const uint64_t TAG_STOP = 4;
+static const uint64_t TAG_ACK_TIMEOUT = 5;
+
+// студент отвечает сразу после оценки; молчание дольше — студент убит, слот освобождается
+static const int ACK_TIMEOUT_MS = 5000;
+
+uint64_t loop_tag(uint64_t kind, int slot = 0, uint32_t gen = 0) {
+    return kind << 28 | (uint64_t)slot << 16 | (gen & 0xFFFF);
+}
+
+// Сессия проверки слота: таймер проверки, затем ожидание ack с таймаутом
+struct Session {
+    bool active = false;
+    bool acking = false;      // оценка отправлена
+    bool timed_out = false;   // мост: ack подставлен teacher по таймауту
+    uint32_t gen = 0;
+    double ack_until = 0;     // срок ack; раньше сессия закрывается, только если студент умер
+    uint64_t taken_at = 0;
+};
+
+// Основной цикл на io_uring/epoll: готовность студентов, таймеры проверки и ack, ack и
+// signalfd приходят событиями одного цикла, записи лога отправляются пачкой на итерации.
+// Проверка — таймер, а не sleep, поэтому одновременно идёт до overlap сессий.
+// У fd-транспорта (eventfd, pipe) очередь и ack — дескрипторы, их ждёт сам цикл;
+// семафоры и futex ждут потоки-мосты, и сессия тогда одна.
+int run_loop(LoopBackend want, int capacity, int grade_ms, int overlap) {
+    EventLoop ev;
+    if (!ev.init(want)) {
+        perror("event loop");
         return 1;
     }
-    if (ftruncate(shm_fd, shm_size) < 0) {
-        perror("ftruncate");
-        close(shm_fd);
-        shm_unlink(SHM_NAME);
-        return 1;
+    loop = &ev;
+
+    FdTransport *fdt = nullptr;
+    if (shm->transport == TR_EVENTFD || shm->transport == TR_PIPE) fdt = static_cast<FdTransport *>(tr);
+
+    WaitBridge ready, ack;
+    if (!fdt) {
+        if (!ready.start(true) || !ack.start(false)) {
+            perror("eventfd");
+            ready.finish();
+            ack.finish();
+            loop = nullptr;
+            ev.close_all();
+            return 1;
+        }
+        ready.arm([] { return tr->wait_queue(); }, [] { tr->post_queue(); });
     }
 
-    shm = static_cast<SharedData *>(mmap(nullptr, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0));
-    if (shm == MAP_FAILED) {
-        perror("mmap");
-        close(shm_fd);
-        shm_unlink(SHM_NAME);
-        return 1;
-    }// init shared data
-    shm->capacity = capacity;
-    shm->shutdown = false;
-    shm->active_students = 0;
+    log_msg_both("TEACHER", string("Event loop: ") + ev.name() + " overlap=" + to_string(overlap)
+                 + (fdt ? " (fd transport, no bridge threads)" : ""));
+    if (fdt) ev.poll(fdt->rd[1], loop_tag(TAG_READY));
+    else ev.watch(ready.efd, loop_tag(TAG_READY));
+    ev.poll(sig_fd, loop_tag(TAG_STOP));
+
+    // один неблокирующий read канала fd-транспорта (при EAGAIN — ещё poll с нулевым таймаутом)
+    auto try_fd = [&](int ch) {
+        int r = fdt->wait(ch, 0);
+        ev.syscalls += r == 1 ? 1 : 2;
+        return r == 1;
+    };
+
+    vector<Session> sess(capacity);
+    uint64_t pending = 0;
+    uint64_t graded = 0, timeouts = 0;
+    int inflight = 0, peak = 0;
+
+    auto take_next = [&]() {
+        while (inflight < overlap && pending > 0 && !admin.paused.load(std::memory_order_relaxed)) {
+            pending--;
+            int idx = LoopSlots::take_waiting(shm);
+            if (idx == -1) continue;
+            Session &ss = sess[idx];
+            ss.active = true;
+            ss.acking = false;
+            ss.timed_out = false;
+            ss.gen++;
+            ss.taken_at = trace_now();
+            inflight++;
+            peak = max(peak, inflight);
+
+            StudentSlot &s = shm->slots[idx];
+            log_student("TEACHER", "Checking PID=" + to_string(s.pid) + " ticket=" + to_string(s.ticket));
+            int ms = grading_ms(s, grade_ms, nullptr);
+            record.add(REC_GRADED, ss.taken_at, s.pid, s.ticket, ms);
+            ev.timer(loop_tag(TAG_GRADED, idx, ss.gen), ms);
+        }
+    };
+
+    auto finish = [&](int idx, bool acked) {
+        Session &ss = sess[idx];
+        StudentSlot &s = shm->slots[idx];
+        ev.syscalls += 2;
+        tr->close_slot(idx);
+        if (acked) {
+            trace.add(SPAN_GRADE, ss.taken_at, trace_now(), s.pid, idx, -1, s.grade);
+            log_student("TEACHER", "Grade=" + to_string(s.grade) + " PID=" + to_string(s.pid));
+            graded++;
+            count_graded();
+        } else {
+            log_msg_both("TEACHER", "Ack timeout PID=" + to_string(s.pid) + ", slot " + to_string(idx) + " released");
+            timeouts++;
+        }
+        ss.active = false;
+        ss.gen++;
+        LoopSlots::release(shm, idx);
+        inflight--;
+        take_next();
+    };
+
+    LoopEvent events[16];
+    while (running) {
+        int n = ev.wait(events, 16);
+        if (n < 0) {
+            perror("event loop wait");
+            break;
+        }
+        for (int k = 0; k < n && running; ++k) {
+            uint64_t tag = events[k].tag;
+            uint64_t kind = tag >> 28;
+            int idx = (int)((tag >> 16) & 0xFFF);
+            uint32_t gen = (uint32_t)(tag & 0xFFFF);
+            Session *ss = kind == TAG_GRADED || kind == TAG_ACK || kind == TAG_ACK_TIMEOUT ? &sess[idx] : nullptr;
+            if (ss && (!ss->active || (ss->gen & 0xFFFF) != gen)) continue;
+
+            if (kind == TAG_STOP) {
+                wait_signal();
+                running = false;
+            } else if (kind == TAG_READY) {
+                if (fdt) {
+                    while (try_fd(1)) pending++;
+                    ev.poll(fdt->rd[1], loop_tag(TAG_READY));
+                } else {
+                    pending += events[k].value;
+                    ev.watch(ready.efd, loop_tag(TAG_READY));
+                }
+                take_next();
+            } else if (kind == TAG_GRADED && shm->protocol == PROTO_V2) {
+                // оценка и слот уходят студенту одним переходом, ack не ждём
+                // после передачи слот уже у студента, pid берётся до неё
+                pid_t pid = shm->slots[idx].pid;
+                int grade = 3 + rand() % 3;
+                ev.syscalls++;
+                if (slot_hand_back(shm, idx, grade)) {
+                    trace.add(SPAN_GRADE, ss->taken_at, trace_now(), pid, idx, -1, grade);
+                    log_student("TEACHER", "Grade=" + to_string(grade) + " PID=" + to_string(pid));
+                    graded++;
+                    count_graded();
+                } else {
+                    LoopSlots::release(shm, idx);
+                }
+                ss->active = false;
+                ss->gen++;
+                inflight--;
+                take_next();
+            } else if (kind == TAG_GRADED) {
+                StudentSlot &s = shm->slots[idx];
+                s.grade = 3 + rand() % 3;
+                ev.syscalls += 2;
+                if (!tr->open_slot(idx)) {
+                    log_msg_both("TEACHER", "Failed to open per-student channels for PID=" + to_string(s.pid));
+                    ss->active = false;
+                    ss->gen++;
+                    LoopSlots::release(shm, idx);
+                    inflight--;
+                    take_next();
+                    continue;
+                }
+                // ack, опоздавший в прошлую сессию слота, не должен закрыть эту. После таймаута
+                // ack у семафоров и futex остаётся лишний: мост забрал поддельный post_ack,
+                // а настоящий пришёл позже (или наоборот)
+                if (fdt) {
+                    while (try_fd(fdt->chan_ack(idx))) {}
+                } else {
+                    while (tr->try_ack(idx)) {}
+                }
+                ev.syscalls++;
+                tr->post_grade(idx);
+                ss->acking = true;
+                uint64_t ack_tag = loop_tag(TAG_ACK, idx, ss->gen);
+                if (fdt) {
+                    ev.poll(fdt->rd[fdt->chan_ack(idx)], ack_tag);
+                } else {
+                    ack.arm([idx] { return tr->wait_ack(idx); }, [idx] { tr->post_ack(idx); });
+                    ev.watch(ack.efd, ack_tag);
+                }
+                ss->ack_until = now_sec() + ACK_TIMEOUT_MS / 1000.0;
+                ev.timer(loop_tag(TAG_ACK_TIMEOUT, idx, ss->gen), ACK_ALIVE_MS);
+            } else if (kind == TAG_ACK && ss->acking) {
+                if (fdt && !try_fd(fdt->chan_ack(idx))) {
+                    ev.poll(fdt->rd[fdt->chan_ack(idx)], tag);
+                    continue;
+                }
+                finish(idx, !ss->timed_out);
+            } else if (kind == TAG_ACK_TIMEOUT && ss->acking && !ss->timed_out) {
+                pid_t p = shm->slots[idx].pid;
+                if (now_sec() < ss->ack_until && !(kill(p, 0) == -1 && errno == ESRCH)) {
+                    ev.timer(tag, ACK_ALIVE_MS);
+                    continue;
+                }
+                if (fdt) {
+                    finish(idx, false);
+                } else {
+                    // мост стоит в wait_ack: разбудить его, сессия закроется по событию ack
+                    ss->timed_out = true;
+                    tr->post_ack(idx);
+                }
+            }
+        }
+    }
+
+    log_msg_both("TEACHER", "SIGINT received, finishing...");
+    notify_all_students();
+    ready.finish();
+    ack.finish();
     for (int i = 0; i < capacity; ++i) {
-        shm->slots[i].state = SLOT_EMPTY;
-        shm->slots[i].pid = 0;
-        shm->slots[i].ticket = 0;
-        shm->slots[i].grade = 0;
-        shm->slots[i].grade_sem_name[0] = '\0';
-        shm->slots[i].ack_sem_name[0] = '\0';
+        if (sess[i].active) tr->close_slot(i);
     }
 
-    sem_unlink(MUTEX_NAME);
-    sem_unlink(QUEUE_NAME);
+    uint64_t total = ev.syscalls + ready.syscalls + ack.syscalls;
+    log_msg_both("TEACHER", string("Loop stats: backend=") + ev.name() + " graded=" + to_string(graded)
+                 + " ack_timeouts=" + to_string(timeouts) + " peak_in_flight=" + to_string(peak)
+                 + " syscalls=" + to_string(total)
+                 + " per_student=" + (graded ? to_string((double)total / graded) : string("-"))
+                 + " log_lost=" + to_string(ev.write_lost));
+    if (ev.write_errno) {
+        fprintf(stderr, "Log writes lost %llu bytes: %s\n", (unsigned long long)ev.write_lost, strerror(ev.write_errno));
+    }
+    ev.close_all();
+    loop = nullptr;
+    return 0;
+}
 
-    mutex_sem = sem_open(MUTEX_NAME, O_CREAT, 0666, 1);
-    queue_sem = sem_open(QUEUE_NAME, O_CREAT, 0666, 0);
-    if (mutex_sem == SEM_FAILED || queue_sem == SEM_FAILED) {
-        perror("sem_open");
-        cleanup();
-        return 1;
+// Создать и отобразить сегмент. O_EXCL: сегмент всегда новый, и страницы обнуляются ядром
+// при первом обращении (слоты не инициализируются). Сегмент упавшего teacher убрал
+// reclaim_stale; оставшийся принадлежит живому или ещё запускающемуся teacher — не трогаем.
+// huge: сначала файл в hugetlbfs, при неудаче — /dev/shm
+// с MADV_HUGEPAGE (THP для shmem, если разрешено в shmem_enabled).
+// numa >= 0: страницы только с этого узла; populate: все page faults до начала работы.
+bool map_segment(size_t size, bool huge, bool populate, int numa) {
+    if (huge) {
+        shm_fd = open(exam_name(HUGE_SHM_PATH).c_str(), O_CREAT | O_RDWR | O_EXCL, 0666);
+        if (shm_fd < 0 && errno == EEXIST) {
+            cerr << "Segment " << exam_name(HUGE_SHM_PATH) << " exists: another teacher is starting this exam\n";
+            return false;
+        }
+        if (shm_fd >= 0) {
+            size_t hsize = round_huge(size);
+            void *p = MAP_FAILED;
+            if (ftruncate(shm_fd, hsize) == 0) {
+                p = mmap(nullptr, hsize, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+            }
+            if (p != MAP_FAILED) {
+                shm = static_cast<SharedData *>(p);
+                shm_size = hsize;
+                huge_file = true;
+            } else {
+                close(shm_fd);
+                unlink(exam_name(HUGE_SHM_PATH).c_str());
+                shm_fd = -1;
+            }
+        }
+    }
+
+    if (!huge_file) {
+        shm_size = size;
+        shm_fd = shm_open(exam_name(SHM_NAME).c_str(), O_CREAT | O_RDWR | O_EXCL, 0666);
+        if (shm_fd < 0 && errno == EEXIST) {
+            cerr << "Segment " << exam_name(SHM_NAME) << " exists: another teacher is starting this exam\n";
+            return false;
+        }
+        if (shm_fd < 0) {
+            perror("shm_open");
+            return false;
+        }
+        if (ftruncate(shm_fd, shm_size) < 0) {
+            perror("ftruncate");
+            close(shm_fd);
+            shm_unlink(exam_name(SHM_NAME).c_str());
+            shm_fd = -1;
+            return false;
+        }
+        // MAP_POPULATE сразу не ставим, если страницы сначала надо привязать к узлу
+        int flags = MAP_SHARED | (populate && numa < 0 ? MAP_POPULATE : 0);
+        void *p = mmap(nullptr, shm_size, PROT_READ | PROT_WRITE, flags, shm_fd, 0);
+        if (p == MAP_FAILED) {
+            perror("mmap");
+            close(shm_fd);
+            shm_unlink(exam_name(SHM_NAME).c_str());
+            shm_fd = -1;
+            return false;
+        }
+        shm = static_cast<SharedData *>(p);
+        if (huge) madvise(shm, shm_size, MADV_HUGEPAGE);
+    }
+
+    if (numa >= 0 && !numa_bind(shm, shm_size, numa)) perror("mbind");
+    if (populate && (numa >= 0 || huge_file)) prefault(shm, shm_size, huge_file ? HUGE_PAGE : 4096);
+
+    string backing = huge_file ? "hugetlbfs " + exam_name(HUGE_SHM_PATH)
+                   : huge ? "shm + THP advise (shmem_enabled=" + sysfs_choice("/sys/kernel/mm/transparent_hugepage/shmem_enabled") + ")"
+                   : string("shm");
+    log_msg_both("TEACHER", "Segment: " + to_string(shm_size) + " bytes, " + backing
+                 + (populate ? ", populated" : "") + (numa >= 0 ? ", node " + to_string(numa) : ""));
+    return true;
+}
+
+// Основной цикл без --loop. Собирается отдельно для каждого транспорта и класса
+// вместимости (slot_table.h), Sync — конкретный тип транспорта или Transport для --generic.
+struct ServeLoop {
+    int capacity;
+    int grade_ms;
+    int protocol;
+
+    template <class SlotsT, class Sync>
+    int operator()(Sync &t) const {
+        while (running) {
+            if (t.wait_queue() != 1) continue;
+            // пауза: токен очереди остаётся за этим потоком, студент ждёт в WAITING
+            while (admin.paused.load(std::memory_order_relaxed) && running) usleep(10000);
+            if (!running) break;
+
+            int idx = SlotsT::take_waiting(shm);
+
+            if (idx == -1) continue;
+            uint64_t taken_at = trace_now();
+
+            StudentSlot &s = shm->slots[idx];
+            log_student("TEACHER", "Checking PID=" + to_string(s.pid) + " ticket=" + to_string(s.ticket));
+
+            int ms = grading_ms(s, grade_ms, nullptr);
+            record.add(REC_GRADED, taken_at, s.pid, s.ticket, ms);
+            usleep(ms * 1000);
+
+            if (protocol == PROTO_V2) {
+                pid_t pid = s.pid;
+                int grade = 3 + rand() % 3;
+                if (slot_hand_back(shm, idx, grade)) {
+                    trace.add(SPAN_GRADE, taken_at, trace_now(), pid, idx, -1, grade);
+                    log_student("TEACHER", "Grade=" + to_string(grade) + " PID=" + to_string(pid));
+                    count_graded();
+                } else {
+                    SlotsT::release(shm, idx);
+                }
+                continue;
+            }
+            s.grade = 3 + rand() % 3;
+
+            if (!t.open_slot(idx)) {
+                log_msg_both("TEACHER", "Failed to open per-student channels for PID=" + to_string(s.pid));
+
+                SlotsT::release(shm, idx);
+                continue;
+            }
+
+            t.post_grade(idx);
+
+            bool acked = wait_ack_alive(t, idx, s.pid);
+
+            t.close_slot(idx);
+            if (acked) {
+                trace.add(SPAN_GRADE, taken_at, trace_now(), s.pid, idx, -1, s.grade);
+                log_student("TEACHER", "Grade=" + to_string(s.grade) + " PID=" + to_string(s.pid));
+                count_graded();
+            } else {
+                log_msg_both("TEACHER", "Student PID=" + to_string(s.pid) + " exited before ack, slot "
+                             + to_string(idx) + " released");
+            }
+
+            SlotsT::release(shm, idx);
+        }
+        return 0;
     }
+};
 
-    log_msg_both("TEACHER", "Ready. Capacity=" + to_string(capacity));
+// Поток, ждущий сигнала завершения: снимает running и будит поток target (SIGUSR1),
+// пока тот не отметит done — он мог ещё не дойти до ожидания
+struct SignalWatch {
+    pthread_t target;
+    std::atomic<bool> done{false};
+    std::thread th;
+
+    void start() {
+        target = pthread_self();
+        th = std::thread([this] {
+            wait_signal();
+            running = false;
+            while (!done) {
+                pthread_kill(target, SIGUSR1);
+                usleep(10000);
+            }
+        });
+    }
+
+    void finish() {
+        done = true;
+        if (running) raise_stop();
+        th.join();
+    }
+};
+
+struct RoomStats {
+    double first = 0, last = 0;   // время первой и последней проверки
+    std::atomic<bool> done{false};
+};
+
+// Проверяющий поток комнаты k. У потока свой экземпляр транспорта (attach, как у
+// студента): открытые семафоры слота и бюджет опроса не делятся между потоками.
+// Пока своя очередь пуста, поток забирает студентов из чужих комнат.
+void grade_room(int k, int kind, int grade_ms, RoomStats *st) {
+    Transport *t = make_transport(kind);
+    if (!t || !t->attach(shm, (char *)shm + shm->sync_offset)) {
+        log_msg_both("TEACHER", "Room " + to_string(k) + ": transport attach failed");
+        delete t;
+        st->done = true;
+        return;
+    }
+    Room *rooms = rooms_of(shm);
+    Room &own = rooms[k];
+    int m = shm->rooms;
+    unsigned seed = (unsigned)time(nullptr) ^ (unsigned)k;
+    string who = "TEACHER room " + to_string(k);
+    TraceBuf rt;
+    rt.on = shm->trace != 0;
+    RecordBuf rec;
+    rec.on = shm->record != 0;
 
     while (running) {
-        if (sem_wait(queue_sem) == -1) {
-            if (errno == EINTR && !running) break;
+        if (admin.paused.load(std::memory_order_relaxed)) {
+            usleep(10000);
             continue;
         }
-        if (!running) break;
+        int idx = -1, from = k;
+        if (fsem_try(&own.queue)) {
+            idx = room_take_waiting(shm, own);
+        } else {
+            for (int d = 1; d < m && idx < 0; ++d) {
+                Room &v = rooms[(k + d) % m];
+                if (__atomic_load_n(&v.waiting, __ATOMIC_RELAXED) > 0 && fsem_try(&v.queue)) {
+                    idx = room_take_waiting(shm, v);
+                    if (idx >= 0) from = (k + d) % m;
+                }
+            }
+            if (idx < 0 && fsem_wait(&own.queue, 50) == 1) idx = room_take_waiting(shm, own);
+        }
+        if (idx < 0) continue;
+        uint64_t taken_at = trace_now();
+
+        StudentSlot &s = shm->slots[idx];
+        log_student(who, "Checking PID=" + to_string(s.pid) + " ticket=" + to_string(s.ticket)
+                     + (from != k ? " (from room " + to_string(from) + ")" : string()));
+
+        int ms = grading_ms(s, grade_ms, &seed);
+        rec.add(REC_GRADED, taken_at, s.pid, s.ticket, ms);
+        usleep(ms * 1000);
+        int grade = 3 + rand_r(&seed) % 3;
+        bool release = true, graded = false;
+
+        if (shm->protocol == PROTO_V2) {
+            // слот освобождает студент (или room_release ниже, если он ушёл)
+            pid_t pid = s.pid;
+            if (slot_hand_back(shm, idx, grade)) {
+                rt.add(SPAN_GRADE, taken_at, trace_now(), pid, idx, k, grade);
+                log_student(who, "Grade=" + to_string(grade) + " PID=" + to_string(pid));
+                count_graded();
+                release = false;
+                graded = true;
+            }
+        } else if (t->open_slot(idx)) {
+            s.grade = grade;
+            t->post_grade(idx);
+            bool acked = wait_ack_alive(*t, idx, s.pid);
+            t->close_slot(idx);
+            if (acked) {
+                rt.add(SPAN_GRADE, taken_at, trace_now(), s.pid, idx, k, s.grade);
+                log_student(who, "Grade=" + to_string(s.grade) + " PID=" + to_string(s.pid));
+                count_graded();
+                graded = true;
+            } else {
+                log_msg_both(who, "Student PID=" + to_string(s.pid) + " exited before ack, slot "
+                             + to_string(idx) + " released");
+            }
+        } else {
+            log_msg_both(who, "Failed to open per-student channels for PID=" + to_string(s.pid));
+        }
 
-        sem_wait(mutex_sem);
-        int idx = -1;
+        if (release) room_release(shm, rooms[from], idx);
+
+        if (from != k) __atomic_fetch_add(&own.stolen, 1, __ATOMIC_RELAXED);
+        // в статистику комнаты — только переданные оценки, не ушедшие студенты
+        if (!graded) continue;
+        __atomic_fetch_add(&own.graded, 1, __ATOMIC_RELAXED);
+        st->last = now_sec();
+        if (st->first == 0) st->first = st->last;
+    }
+
+    rt.flush();
+    rec.flush();
+    t->detach();
+    delete t;
+    st->done = true;
+}
+
+// --rooms: по потоку на комнату, основной поток ждёт SIGINT
+int run_rooms(int kind, int grade_ms) {
+    int m = shm->rooms;
+    Room *rooms = rooms_of(shm);
+    vector<RoomStats> stats(m);
+    vector<std::thread> graders;
+    for (int k = 0; k < m; ++k) {
+        log_msg_both("TEACHER", "Room " + to_string(k) + ": slots " + to_string(rooms[k].first) + ".."
+                     + to_string(rooms[k].first + rooms[k].count - 1));
+        graders.emplace_back(grade_room, k, kind, grade_ms, &stats[k]);
+    }
+
+    wait_signal();
+    running = false;
+
+    log_msg_both("TEACHER", "SIGINT received, finishing...");
+    // сначала остановить проверяющих: поток посреди проверки иначе перезапишет grade = -1
+    // оповещения своей оценкой. Поток мог ещё не дойти до ожидания, поэтому будим, пока
+    // не завершится
+    for (int k = 0; k < m; ++k) {
+        while (!stats[k].done) {
+            pthread_kill(graders[k].native_handle(), SIGUSR1);
+            usleep(10000);
+        }
+        graders[k].join();
+    }
+    notify_all_students();
+
+    uint64_t total = 0;
+    double first = 0, last = 0;
+    for (int k = 0; k < m; ++k) {
+        RoomStats &st = stats[k];
+        double span = st.last - st.first;
+        log_msg_both("TEACHER", "Room stats: room=" + to_string(k) + " graded=" + to_string(rooms[k].graded)
+                     + " stolen=" + to_string(rooms[k].stolen)
+                     + " rate=" + (span > 0 ? to_string(rooms[k].graded / span) : string("-")));
+        total += rooms[k].graded;
+        if (st.first > 0 && (first == 0 || st.first < first)) first = st.first;
+        if (st.last > last) last = st.last;
+    }
+    log_msg_both("TEACHER", "Room stats: total graded=" + to_string(total)
+                 + " rate=" + (last > first ? to_string(total / (last - first)) : string("-")));
+    return 0;
+}
+
+// Поток сокета пишет в лог сам: буфер записи цикла событий (--loop) однопоточный
+void log_admin(const string &msg) {
+    string s = "[TEACHER] " + msg + "\n";
+    std::lock_guard<std::mutex> g(log_mutex);
+    print_local(s);
+    send_fifo(s);
+}
+
+// Управляющий сокет ADMIN_SOCK_NAME: одна текстовая команда на соединение, ответ —
+// строки "key=value" или "error: ...", затем соединение закрывается (клиент — ./examctl).
+// Поток сокета раз в 100 мс ещё и поддерживает уменьшенную вместимость (занимает
+// освободившиеся слоты за limit как RESERVED) и следит за окончанием drain.
+struct AdminServer {
+    int fd = -1;
+    int capacity = 0;
+    int limit = 0;              // set capacity: слоты >= limit студентам не выдаются
+    int grade_ms = -1;          // --grade-ms
+    string mode;
+    vector<char> closed;        // слот занят teacher из-за limit
+    vector<uint32_t> reserved;  // слово RESERVED-слота на прошлом обходе reap
+    bool draining = false;
+    int drain_idle = 0;         // подряд идущие обходы без студентов в слотах
+    double started = 0;
+    double rate = 0, rate_at = 0;
+    uint64_t rate_graded = 0;
+    std::atomic<bool> stop{false};
+    std::thread th;
+
+    bool start(int cap, int gms, const string &m) {
+        capacity = limit = cap;
+        grade_ms = gms;
+        mode = m;
+        closed.assign(cap, 0);
+        reserved.assign(cap, 0);
+        started = rate_at = now_sec();
+        string path = exam_name(ADMIN_SOCK_NAME);
+        unlink(path.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+            perror("admin socket");
+            if (fd >= 0) close(fd);
+            fd = -1;
+            return false;
+        }
+        chmod(path.c_str(), 0600);
+        th = std::thread([this] { run(); });
+        return true;
+    }
+
+    void run() {
+        while (!stop) {
+            pollfd pfd{fd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) > 0) {
+                int c = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (c >= 0) {
+                    serve(c);
+                    close(c);
+                }
+            }
+            if (running) tick();
+        }
+    }
+
+    void serve(int c) {
+        string line;
+        char buf[256];
+        pollfd pfd{c, POLLIN, 0};
+        while (line.find('\n') == string::npos && line.size() < 256 && poll(&pfd, 1, 1000) > 0) {
+            ssize_t r = read(c, buf, sizeof(buf));
+            if (r <= 0) break;
+            line.append(buf, r);
+        }
+        line = line.substr(0, line.find('\n'));
+        string reply = handle(line);
+        send(c, reply.data(), reply.size(), MSG_NOSIGNAL);
+    }
+
+    Room *room_of(int i) {
+        Room *r = rooms_of(shm);
+        for (int k = 0; k < shm->rooms; ++k) {
+            if (i >= r[k].first && i < r[k].first + r[k].count) return &r[k];
+        }
+        return nullptr;
+    }
+
+    // Слот за limit занимается, как только освободится; загрузка комнаты учитывает его
+    void tick() {
+        for (int i = limit; i < capacity; ++i) {
+            if (closed[i] || !slot_cas(shm, i, SLOT_EMPTY, SLOT_RESERVED)) continue;
+            slot_clear_bit(shm->free_mask, i);
+            if (Room *r = room_of(i)) __atomic_fetch_add(&r->load, 1, __ATOMIC_RELAXED);
+            closed[i] = 1;
+        }
+
+        double now = now_sec();
+        if (now - rate_at >= REAP_PERIOD_MS / 1000.0) {
+            uint64_t g = graded_total.load(std::memory_order_relaxed);
+            rate = (g - rate_graded) / (now - rate_at);
+            rate_graded = g;
+            rate_at = now;
+            reap();
+        }
+
+        if (!draining) return;
+        int busy = 0;
         for (int i = 0; i < capacity; ++i) {
-            if (shm->slots[i].state == SLOT_WAITING) {
-                idx = i;
-                shm->slots[i].state = SLOT_PROCESSING;
-                break;
+            if (!closed[i] && slot_state(shm, i) != SLOT_EMPTY) busy++;
+        }
+        drain_idle = busy ? 0 : drain_idle + 1;
+        // два пустых обхода подряд: студент, занявший слот до закрытия приёма, успел бы
+        // его опубликовать или вернуть
+        if (drain_idle >= 2) {
+            draining = false;
+            log_admin("Drain complete: " + to_string(graded_total.load()) + " graded, stopping");
+            raise_stop();
+        }
+    }
+
+    // Слоты студентов, убитых SIGKILL: освободить их, кроме teacher, некому. Слот забирается,
+    // когда процесса с pid из слота уже нет. WAITING отменяется, как отменил бы сам студент;
+    // DONE (протокол 2) освобождается, как после получения оценки; RESERVED — только если
+    // слово не менялось с прошлого обхода: студент регистрируется микросекунды, а pid в нём
+    // 0 до записи студентом. PROCESSING доводит проверка: v1 — по wait_ack_alive, v2 — DONE
+    void reap() {
+        for (int i = 0; i < capacity; ++i) {
+            StudentSlot &s = shm->slots[i];
+            uint32_t w = s.word.load(std::memory_order_acquire);
+            pid_t p = __atomic_load_n(&s.pid, __ATOMIC_RELAXED);
+            int st = slot_state_of(w);
+            bool stuck = reserved[i] == w;
+            reserved[i] = st == SLOT_RESERVED ? w : 0;
+            if (closed[i] || p <= 0 || s.word.load(std::memory_order_acquire) != w) continue;
+            if (st != SLOT_WAITING && st != SLOT_DONE && !(st == SLOT_RESERVED && stuck)) continue;
+            if (kill(p, 0) == 0 || errno != ESRCH) continue;
+
+            // CAS по точному слову, а не по состоянию: слот, который освободили и заняли
+            // заново, пока проверялся pid (или после прошлого обхода), не трогается.
+            // Дальше те же шаги, что у room_cancel/slot_release/slot_unreserve после их CAS
+            if (!s.word.compare_exchange_strong(w, slot_next(w, SLOT_RESERVED), std::memory_order_acq_rel)) continue;
+            Room *r = room_of(i);
+            if (st == SLOT_RESERVED) {
+                if (r) room_unreserve(shm, *r, i);
+                else slot_unreserve(shm, i);
+            } else if (r) {
+                if (st == SLOT_WAITING) __atomic_fetch_sub(&r->waiting, 1, __ATOMIC_RELAXED);
+                room_release(shm, *r, i);
+            } else {
+                slot_release(shm, i);
             }
+            log_admin("Reclaimed slot " + to_string(i) + " of exited PID=" + to_string(p)
+                      + (st == SLOT_WAITING ? " (waiting)" : st == SLOT_DONE ? " (graded)" : " (registering)"));
         }
-        sem_post(mutex_sem);
+    }
 
-        if (idx == -1) continue;
+    // Снимок слотов без lock (table_snapshot): регистрация и проверка его не ждут
+    string stats() {
+        TableSnapshot snap;
+        table_snapshot(shm, capacity, snap);
+        int *n = snap.count;
+        for (int i = 0; i < capacity; ++i) n[SLOT_RESERVED] -= closed[i];
+        int gms = admin.grade_ms.load();
+        if (gms == -2) gms = grade_ms;
+        double up = now_sec() - started;
+        uint64_t g = graded_total.load(std::memory_order_relaxed);
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                 "mode=%s transport=%s protocol=%d capacity=%d open=%d\n"
+                 "uptime_s=%.1f graded=%llu rate=%.1f avg_rate=%.1f\n"
+                 "free=%d registering=%d waiting=%d processing=%d graded_unclaimed=%d\n"
+                 "paused=%d draining=%d log=%s grade_ms=%s\n"
+                 "snapshot=%s passes=%d\n",
+                 mode.c_str(), tr->name(), (int)shm->protocol, capacity, limit, up, (unsigned long long)g, rate, up > 0 ? g / up : 0.0,
+                 n[SLOT_EMPTY], n[SLOT_RESERVED], n[SLOT_WAITING], n[SLOT_PROCESSING], n[SLOT_DONE], (int)admin.paused.load(),
+                 (int)draining, admin.quiet ? "quiet" : "normal", gms >= 0 ? to_string(gms).c_str() : "random",
+                 snap.consistent ? "consistent" : "per-slot", snap.passes);
+        return buf;
+    }
 
-        StudentSlot &s = shm->slots[idx];
+    // Студенты в слотах: одна строка на WAITING/PROCESSING из одного снимка
+    string slots() {
+        TableSnapshot snap;
+        table_snapshot(shm, capacity, snap);
+        string out = string("snapshot=") + (snap.consistent ? "consistent" : "per-slot") + " passes="
+                     + to_string(snap.passes) + "\n";
+        for (int i = 0; i < capacity; ++i) {
+            const SlotView &v = snap.slots[i];
+            if (v.state() != SLOT_WAITING && v.state() != SLOT_PROCESSING) continue;
+            out += "slot=" + to_string(i) + " state=" + (v.state() == SLOT_WAITING ? "waiting" : "processing")
+                   + " pid=" + to_string(v.pid) + " ticket=" + to_string(v.ticket) + "\n";
+        }
+        return out;
+    }
+
+    string handle(const string &line) {
+        vector<string> w;
+        size_t p = 0;
+        while (p < line.size()) {
+            size_t q = line.find_first_of(" \t\r", p);
+            if (q == string::npos) q = line.size();
+            if (q > p) w.push_back(line.substr(p, q - p));
+            p = q + 1;
+        }
+        if (w.empty()) return "error: empty command\n";
+        if (!running) return "error: exam is finishing\n";
+
+        if (w[0] == "stats" && w.size() == 1) return stats();
+        if (w[0] == "slots" && w.size() == 1) return slots();
+        if (w[0] == "help") {
+            return "stats\nslots\nset grade-ms N|random|default\nset log quiet|normal\nset capacity N\n"
+                   "pause\nresume\ndrain\n";
+        }
+        if (w[0] == "pause" && w.size() == 1) {
+            admin.paused = true;
+            log_admin("Admin: grading paused");
+            return "ok paused\n";
+        }
+        if (w[0] == "resume" && w.size() == 1) {
+            admin.paused = false;
+            // цикл событий проверяет паузу только по событию: лишний токен очереди будит его
+            tr->post_queue();
+            log_admin("Admin: grading resumed");
+            return "ok resumed\n";
+        }
+        if (w[0] == "drain" && w.size() == 1) {
+            if (draining) return "ok already draining\n";
+            __atomic_store_n(&shm->closed, 1, __ATOMIC_SEQ_CST);
+            draining = true;
+            drain_idle = 0;
+            log_admin("Admin: admission closed, draining");
+            return "ok draining\n";
+        }
+        if (w[0] == "set" && w.size() == 3) {
+            const string &k = w[1], &v = w[2];
+            if (k == "grade-ms") {
+                char *end = nullptr;
+                long ms = v == "default" ? -2 : v == "random" ? -1 : strtol(v.c_str(), &end, 10);
+                if ((end && (*end || end == v.c_str() || ms < 0)) || ms > 600000) {
+                    return "error: grade-ms must be 0..600000, random or default\n";
+                }
+                admin.grade_ms = (int)ms;
+                log_admin("Admin: grade-ms " + v);
+                return "ok grade-ms " + v + "\n";
+            }
+            if (k == "log" && (v == "quiet" || v == "normal")) {
+                admin.quiet = v == "quiet";
+                log_admin("Admin: log " + v);
+                return "ok log " + v + "\n";
+            }
+            if (k == "capacity") {
+                int c = atoi(v.c_str());
+                if (c < 1 || c > capacity) return "error: capacity must be 1.." + to_string(capacity) + "\n";
+                limit = c;
+                for (int i = 0; i < limit; ++i) {
+                    if (!closed[i]) continue;
+                    if (Room *r = room_of(i)) __atomic_fetch_sub(&r->load, 1, __ATOMIC_RELAXED);
+                    slot_unreserve(shm, i);
+                    closed[i] = 0;
+                }
+                tick();
+                int busy = 0;
+                for (int i = limit; i < capacity; ++i) busy += !closed[i];
+                log_admin("Admin: capacity " + to_string(c));
+                return "ok capacity " + to_string(c) + (busy ? ", busy slots close when freed: " + to_string(busy) : string())
+                       + "\n";
+            }
+        }
+        return "error: unknown command (try help)\n";
+    }
 
-        log_msg_both("TEACHER", "Checking PID=" + to_string(s.pid) + " ticket=" + to_string(s.ticket));
+    void finish() {
+        if (fd < 0) return;
+        stop = true;
+        th.join();
+        close(fd);
+        fd = -1;
+        unlink(exam_name(ADMIN_SOCK_NAME).c_str());
+    }
+};
 
-        sleep(1 + rand() % 3);
-        s.grade = 3 + rand() % 3;
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: ./teacher <capacity> [--grade-ms N] [--loop uring|epoll [--overlap N]]"
+                        " [--transport named|unnamed|futex|eventfd|pipe] [--generic]"
+                        " [--spin 0|N|adaptive] [--huge] [--populate] [--cpu LIST] [--numa NODE]"
+                        " [--exam ID] [--rooms M [--route hash|least|fill]] [--trace] [--record] [--protocol 1|2]\n";
+    if (!take_exam_arg(argc, argv) || argc < 2) {
+        cerr << usage;
+        return 1;
+    }
 
-        sem_t *grade = sem_open(s.grade_sem_name, 0);
-        sem_t *ack   = sem_open(s.ack_sem_name, 0);
+    int capacity = atoi(argv[1]);
+    // фиксированное время проверки вместо случайных 1..3 с (для замеров)
+    int grade_ms = -1;
+    bool use_loop = false;
+    LoopBackend backend = LOOP_URING;
+    // --loop: сколько проверок идёт одновременно (таймеры вместо sleep)
+    int overlap = 1;
+    int kind = TR_NAMED_SEM;
+    // виртуальные вызовы транспорта и линейный обход слотов (для сравнения)
+    bool generic = false;
+    // опрос перед уходом в futex при ожидании grade/ack (только --transport futex)
+    int spin = 0;
+    // размещение сегмента и процесса (placement.h)
+    bool huge = false, populate = false;
+    const char *cpus = nullptr;
+    int numa = -1;
+    // комнаты со своими lock/очередью и проверяющим потоком (rooms.h)
+    int rooms = 0;
+    int route = ROUTE_HASH;
+    bool transport_set = false;
+    // интервалы жизненного цикла студентов в TRACE_NAME (trace.h, trace2json)
+    bool tracing = false;
+    // запись нагрузки для ./replay (replay.h)
+    bool recording = false;
+    // передача оценки: 1 — grade/ack через транспорт, 2 — оценка в слове слота (GradeProtocol)
+    int protocol = PROTO_V1;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--grade-ms") == 0 && i + 1 < argc) {
+            grade_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loop") == 0 && i + 1 < argc) {
+            use_loop = true;
+            string b = argv[++i];
+            if (b == "uring") backend = LOOP_URING;
+            else if (b == "epoll") backend = LOOP_EPOLL;
+            else {
+                cerr << usage;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--overlap") == 0 && i + 1 < argc) {
+            overlap = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--transport") == 0 && i + 1 < argc) {
+            kind = transport_from_name(argv[++i]);
+            transport_set = true;
+            if (kind < 0) {
+                cerr << usage;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--spin") == 0 && i + 1 < argc) {
+            string v = argv[++i];
+            spin = v == "adaptive" ? SPIN_ADAPTIVE : atoi(v.c_str());
+            if (spin < SPIN_ADAPTIVE) {
+                cerr << usage;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--huge") == 0) {
+            huge = true;
+        } else if (strcmp(argv[i], "--populate") == 0) {
+            populate = true;
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            cpus = argv[++i];
+        } else if (strcmp(argv[i], "--numa") == 0 && i + 1 < argc) {
+            numa = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rooms") == 0 && i + 1 < argc) {
+            rooms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--route") == 0 && i + 1 < argc) {
+            string r = argv[++i];
+            route = r == "hash" ? ROUTE_HASH : r == "least" ? ROUTE_LEAST : r == "fill" ? ROUTE_FILL : -1;
+            if (route < 0) {
+                cerr << usage;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            tracing = true;
+        } else if (strcmp(argv[i], "--record") == 0) {
+            recording = true;
+        } else if (strcmp(argv[i], "--protocol") == 0 && i + 1 < argc) {
+            protocol = atoi(argv[++i]);
+            if (protocol != PROTO_V1 && protocol != PROTO_V2) {
+                cerr << usage;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--generic") == 0) {
+            generic = true;
+        } else {
+            cerr << usage;
+            return 1;
+        }
+    }
+    if (capacity <= 0 || capacity > SLOT_MASK_BITS) {
+        cerr << "Capacity must be 1.." << SLOT_MASK_BITS << "\n";
+        return 1;
+    }
+    if (rooms < 0 || rooms > capacity || (rooms > 0 && use_loop)) {
+        cerr << "Rooms must be 1..capacity and cannot be combined with --loop\n";
+        return 1;
+    }
+    if (overlap < 1 || overlap > capacity) {
+        cerr << "Overlap must be 1..capacity\n";
+        return 1;
+    }
+    // несколько ack одновременно ждёт только цикл над fd (семафоры ждёт один поток-мост);
+    // в протоколе 2 ack нет, и сессии перекрываются на любом транспорте
+    if (overlap > 1 && (!use_loop || (kind != TR_EVENTFD && kind != TR_PIPE && protocol != PROTO_V2))) {
+        cerr << "--overlap > 1 needs --loop and --transport eventfd or pipe (or --protocol 2)\n";
+        return 1;
+    }
+    // в комнатах потоки ждут ack параллельно; futex не требует открытия семафоров
+    if (rooms > 0 && !transport_set) kind = TR_FUTEX;
 
-        if (grade == SEM_FAILED || ack == SEM_FAILED) {
-            log_msg_both("TEACHER", "Failed to open per-student semaphores for PID=" + to_string(s.pid));
-            if (grade != SEM_FAILED) sem_close(grade);
-            if (ack != SEM_FAILED) sem_close(ack);
+    if (cpus && !pin_cpus(cpus)) {
+        perror("sched_setaffinity");
+        return 1;
+    }
+    if (numa >= 0 && !numa_prefer(numa)) perror("set_mempolicy");
 
-            sem_wait(mutex_sem);
-            s.state = SLOT_EMPTY;
-            shm->active_students--;
-            sem_post(mutex_sem);
-            continue;
+    tr = make_transport(kind);
+
+    // до создания потоков (транспорт, комнаты, мосты цикла): маска наследуется
+    sigset_t stop_set;
+    sigemptyset(&stop_set);
+    sigaddset(&stop_set, SIGINT);
+    sigaddset(&stop_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_set, nullptr);
+    sig_fd = signalfd(-1, &stop_set, SFD_CLOEXEC);
+    if (sig_fd < 0) {
+        perror("signalfd");
+        return 1;
+    }
+    struct sigaction sa{};
+    sa.sa_handler = wake_grader;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, nullptr);
+    srand((unsigned)time(nullptr));
+
+    if (mkfifo(exam_name(FIFO_NAME).c_str(), 0666) == -1 && errno != EEXIST) {
+        perror("mkfifo");
+    } else {
+        fifo_fd = open(exam_name(FIFO_NAME).c_str(), O_WRONLY | O_NONBLOCK);
+        if (fifo_fd < 0) {
+            fifo_fd = -1;
         }
+    }
 
-        sem_post(grade);
+    // объекты упавших teacher — и этого экзамена, и других — до создания своих
+    pid_t busy = 0;
+    vector<string> reclaimed;
+    if (reclaim_stale(exam_id(), busy, reclaimed) < 0) {
+        cerr << "Exam is already served by teacher PID=" << busy << "\n";
+        return 1;
+    }
+    for (const string &s : reclaimed) log_msg_both("TEACHER", s);
 
-        while (true) {
-            if (sem_wait(ack) == -1) {
-                if (errno == EINTR) {
-                    if (!running) break;
-                    else continue;
-                } else break;
-            } else break;
+    // объекты транспорта, живущие в памяти, лежат сразу после слотов
+    size_t sync_offset = sizeof(SharedData) + capacity * sizeof(StudentSlot);
+    sync_offset = (sync_offset + 63) & ~(size_t)63;
+    size_t rooms_offset = (sync_offset + tr->area_size(capacity) + 63) & ~(size_t)63;
+    shm_size = rooms_offset + rooms * sizeof(Room);
+    if (!map_segment(shm_size, huge, populate, numa)) {
+        cleanup();
+        return 1;
+    }
+
+    // init shared data; magic — в самом конце, до него студенты сегмент не принимают
+    shm->version = SEGMENT_VERSION;
+    shm->protocol = (uint16_t)protocol;
+    shm->header_size = sizeof(SharedData);
+    shm->slot_size = sizeof(StudentSlot);
+    shm->owner = getpid();
+    shm->capacity = capacity;
+    shm->shutdown = false;
+    shm->shutdown_gen = 0;
+    shm->transport = kind;
+    shm->spin = spin;
+    shm->sync_offset = sync_offset;
+    shm->rooms = 0;
+    shm->rooms_offset = rooms_offset;
+    shm->trace = 0;
+    shm->record = 0;
+    shm->closed = 0;
+    // слоты не трогаются: сегмент новый (O_EXCL), нулевой слот — пустой
+    slot_table_init(shm, capacity);
+
+    if (!tr->create(shm, (char *)shm + sync_offset, capacity)) {
+        perror("transport");
+        cleanup();
+        return 1;
+    }
+
+    if (rooms > 0) rooms_init(shm, rooms, route);
+
+    if (tracing) {
+        if (trace_create()) {
+            shm->trace = 1;
+            trace.on = true;
+        } else {
+            perror("trace");
+        }
+    }
+    if (recording) {
+        if (record_create(capacity, kind, rooms)) {
+            shm->record = 1;
+            record.on = true;
+        } else {
+            perror("record");
         }
+    }
 
-        sem_close(grade);
-        sem_close(ack);
+    __atomic_store_n(&shm->magic, SEGMENT_MAGIC, __ATOMIC_RELEASE);
+    log_msg_both("TEACHER", "Ready. Capacity=" + to_string(capacity) + " transport=" + tr->name()
+                 + (rooms > 0 ? " rooms=" + to_string(rooms) + " route=" + ROUTE_NAMES[route] : string())
+                 + (protocol == PROTO_V2 ? " protocol=2" : ""));
 
-        log_msg_both("TEACHER", "Grade=" + to_string(s.grade) + " PID=" + to_string(s.pid));
+    AdminServer adm;
+    adm.start(capacity, grade_ms, use_loop ? string("loop ") + (backend == LOOP_URING ? "uring" : "epoll")
+                                  : rooms > 0 ? "rooms " + to_string(rooms) : string("serve"));
 
-        sem_wait(mutex_sem);
-        s.state = SLOT_EMPTY;
-        shm->active_students--;
-        sem_post(mutex_sem);
+    if (use_loop) {
+        int rc = run_loop(backend, capacity, grade_ms, overlap);
+        adm.finish();
+        cleanup();
+        return rc;
     }
 
+    if (rooms > 0) {
+        int rc = run_rooms(kind, grade_ms);
+        adm.finish();
+        log_msg_both("TEACHER", "Exiting.");
+        cleanup();
+        return rc;
+    }
+
+    SignalWatch watch;
+    watch.start();
+    int rc = with_policy(tr, kind, capacity, generic, ServeLoop{capacity, grade_ms, protocol});
+    watch.finish();
+
+    log_msg_both("TEACHER", "SIGINT received, finishing...");
+    notify_all_students();
+    adm.finish();
     log_msg_both("TEACHER", "Exiting.");
     cleanup();
-    return 0;
-}
\ No newline at end of file
+    return rc;
+}
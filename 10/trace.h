@@ -0,0 +1,119 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common.h"
+
+// Трасса жизненного цикла студентов (teacher --trace). Интервалы по CLOCK_MONOTONIC
+// копятся в памяти процесса и дописываются в TRACE_NAME одним write с O_APPEND:
+// студент — один раз при выходе, teacher — по TRACE_BUF_RECORDS записей и при завершении.
+// Файл: TraceHeader, затем записи TraceRecord подряд; trace2json переводит его в JSON
+// формата Chrome trace events (Perfetto, chrome://tracing).
+
+static const char *TRACE_NAME = "/tmp/exam_trace";
+
+static const uint32_t TRACE_MAGIC = 0x43525458;  // "XTRC"
+static const uint32_t TRACE_VERSION = 1;
+static const int TRACE_BUF_RECORDS = 256;
+
+enum TraceSpan {
+    SPAN_PREPARE = 1,   // студент: подготовка
+    SPAN_REGISTER,      // студент: поиск слота и публикация
+    SPAN_WAIT,          // студент: от публикации до оценки (или до завершения экзамена)
+    SPAN_GRADE,         // teacher: от взятия слота до ack студента
+    SPAN_ACK,           // студент: от оценки до отправленного ack
+    SPAN_COUNT
+};
+
+inline constexpr const char *SPAN_NAMES[SPAN_COUNT] = {"?", "prepare", "register", "wait", "graded", "ack"};
+
+struct TraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+struct TraceRecord {
+    uint64_t start;   // нс, CLOCK_MONOTONIC
+    uint64_t end;
+    int32_t pid;      // студент
+    int16_t slot;     // -1 — слот не получен
+    int16_t room;     // комната студента или проверяющего потока, -1 — общая очередь
+    uint8_t kind;     // TraceSpan
+    uint8_t reserved[3];
+    int32_t grade;    // -1 — оценки нет
+};
+
+static_assert(sizeof(TraceRecord) == 32, "trace record layout");
+
+inline uint64_t trace_now() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// teacher: новый файл с заголовком (трасса, запись нагрузки для replay)
+inline bool append_file_create(const char *base, const void *header, size_t size) {
+    int fd = open(exam_name(base).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) return false;
+    bool ok = write(fd, header, size) == (ssize_t)size;
+    close(fd);
+    return ok;
+}
+
+inline bool trace_create() {
+    TraceHeader h{TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord), 0};
+    return append_file_create(TRACE_NAME, &h, sizeof(h));
+}
+
+// Буфер записей одного потока для файла base; пока on == false, push ничего не делает
+template <class Rec>
+struct AppendBuf {
+    const char *base;
+    bool on = false;
+    int n = 0;
+    Rec recs[TRACE_BUF_RECORDS];
+
+    explicit AppendBuf(const char *file) : base(file) {}
+
+    void push(const Rec &r) {
+        if (!on) return;
+        recs[n++] = r;
+        if (n == TRACE_BUF_RECORDS) flush();
+    }
+
+    // файл открывается на каждую запись пачки: студенту нужен один write за всю жизнь
+    void flush() {
+        if (n == 0) return;
+        int fd = open(exam_name(base).c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd >= 0) {
+            write(fd, recs, n * sizeof(Rec));
+            close(fd);
+        }
+        n = 0;
+    }
+};
+
+struct TraceBuf : AppendBuf<TraceRecord> {
+    TraceBuf() : AppendBuf<TraceRecord>(TRACE_NAME) {}
+
+    void add(TraceSpan kind, uint64_t start, uint64_t end, int pid, int slot, int room, int grade) {
+        if (!on) return;
+        TraceRecord r{};
+        r.start = start;
+        r.end = end;
+        r.pid = pid;
+        r.slot = (int16_t)slot;
+        r.room = (int16_t)room;
+        r.kind = (uint8_t)kind;
+        r.grade = grade;
+        push(r);
+    }
+};
+
+#endif // TRACE_H
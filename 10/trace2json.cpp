@@ -0,0 +1,133 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "common.h"
+#include "trace.h"
+
+using namespace std;
+
+// Трасса teacher --trace -> JSON Chrome trace events (открывается в ui.perfetto.dev).
+// Процесс "students": строка на студента с интервалами prepare/register/wait/ack и
+// вложенным в wait интервалом проверки. Процесс "teacher": строка на проверяющий поток.
+// Счётчик "waiting" — сколько студентов ждёт оценку. Сводка по интервалам — в stderr.
+
+static const int PID_STUDENTS = 1;
+static const int PID_TEACHER = 2;
+
+double to_us(uint64_t ns, uint64_t base) {
+    return (ns - base) / 1000.0;
+}
+
+double percentile(vector<double> &v, double p) {
+    if (v.empty()) return 0;
+    sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+void print_span(FILE *out, bool &first, const TraceRecord &r, int pid, int tid, uint64_t base) {
+    fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+                 "\"args\":{\"student\":%d,\"slot\":%d,\"room\":%d,\"grade\":%d}}",
+            first ? "" : ",", SPAN_NAMES[r.kind], r.kind == SPAN_GRADE ? "teacher" : "student",
+            to_us(r.start, base), (r.end - r.start) / 1000.0, pid, tid, r.pid, r.slot, r.room, r.grade);
+    first = false;
+}
+
+void print_name(FILE *out, bool &first, const char *what, int pid, int tid, const string &name) {
+    fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",", what, pid, tid, name.c_str());
+    first = false;
+}
+
+int main(int argc, char *argv[]) {
+    if (!take_exam_arg(argc, argv) || argc > 2) {
+        cerr << "Usage: ./trace2json [--exam ID] [TRACE_FILE] > trace.json\n";
+        return 1;
+    }
+    string path = argc > 1 ? argv[1] : exam_name(TRACE_NAME);
+
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        perror(path.c_str());
+        return 1;
+    }
+    TraceHeader h{};
+    if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != TRACE_MAGIC || h.version != TRACE_VERSION
+        || h.record_size != sizeof(TraceRecord)) {
+        cerr << path << ": not a trace file\n";
+        fclose(f);
+        return 1;
+    }
+    vector<TraceRecord> recs;
+    TraceRecord r;
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+        if (r.kind > 0 && r.kind < SPAN_COUNT && r.end >= r.start) recs.push_back(r);
+    }
+    fclose(f);
+    if (recs.empty()) {
+        cerr << path << ": no records\n";
+        return 1;
+    }
+
+    uint64_t base = recs[0].start;
+    for (const TraceRecord &x : recs) base = min(base, x.start);
+
+    FILE *out = stdout;
+    bool first = true;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    print_name(out, first, "process_name", PID_STUDENTS, 0, "students");
+    print_name(out, first, "process_name", PID_TEACHER, 0, "teacher");
+
+    set<int> students, graders;
+    vector<pair<uint64_t, int>> waiting;   // (время, +1/-1)
+    vector<double> dur_ms[SPAN_COUNT];
+    for (const TraceRecord &x : recs) {
+        dur_ms[x.kind].push_back((x.end - x.start) / 1e6);
+        if (students.insert(x.pid).second) {
+            print_name(out, first, "thread_name", PID_STUDENTS, x.pid, "student " + to_string(x.pid));
+        }
+        // проверка видна и в строке студента (внутри wait), и в строке проверяющего
+        print_span(out, first, x, PID_STUDENTS, x.pid, base);
+        if (x.kind == SPAN_GRADE) {
+            int tid = x.room + 2;
+            if (graders.insert(tid).second) {
+                print_name(out, first, "thread_name", PID_TEACHER, tid,
+                           x.room < 0 ? string("grader") : "room " + to_string(x.room));
+            }
+            print_span(out, first, x, PID_TEACHER, tid, base);
+        }
+        if (x.kind == SPAN_WAIT) {
+            waiting.push_back({x.start, 1});
+            waiting.push_back({x.end, -1});
+        }
+    }
+
+    // при равном времени сначала уход, потом приход: счётчик не завышается
+    sort(waiting.begin(), waiting.end());
+    int now = 0, peak = 0;
+    for (auto &w : waiting) {
+        now += w.second;
+        peak = max(peak, now);
+        fprintf(out, ",\n{\"name\":\"waiting\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%d,\"args\":{\"students\":%d}}",
+                to_us(w.first, base), PID_STUDENTS, now);
+    }
+    fprintf(out, "\n]}\n");
+
+    uint64_t last = base;
+    for (const TraceRecord &x : recs) last = max(last, x.end);
+    fprintf(stderr, "%zu records, %zu students, %.1f ms, peak waiting %d\n", recs.size(), students.size(),
+            (last - base) / 1e6, peak);
+    fprintf(stderr, "%-9s %7s %10s %10s %10s\n", "span", "count", "p50_ms", "p99_ms", "max_ms");
+    for (int k = 1; k < SPAN_COUNT; ++k) {
+        vector<double> &v = dur_ms[k];
+        if (v.empty()) continue;
+        double p50 = percentile(v, 0.5), p99 = percentile(v, 0.99);
+        fprintf(stderr, "%-9s %7zu %10.3f %10.3f %10.3f\n", SPAN_NAMES[k], v.size(), p50, p99, v.back());
+    }
+    return 0;
+}
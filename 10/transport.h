@@ -0,0 +1,815 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <climits>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "common.h"
+
+// Механизм синхронизации teacher <-> student. Выбирается преподавателем при запуске
+// (--transport), номер записывается в SharedData, студент создаёт такой же.
+// Каналы: queue (готовые студенты), grade[slot], ack[slot] и mutex. mutex teacher и student
+// не берут (слоты занимаются CAS, завершение — shm->shutdown и broadcast_shutdown), им
+// пользуются только замеры bench: цена lock/unlock и таблица слотов под lock.
+// Все каналы — счётные семафоры: post увеличивает, wait ждёт > 0 и уменьшает.
+
+enum TransportKind {
+    TR_NAMED_SEM = 0,   // именованные POSIX-семафоры (как в исходной версии)
+    TR_UNNAMED_SEM,     // sem_t с pshared = 1 внутри сегмента
+    TR_FUTEX,           // 32-битные слова в сегменте + futex(2)
+    TR_EVENTFD,         // eventfd(EFD_SEMAPHORE), дескрипторы через SCM_RIGHTS
+    TR_PIPE,            // pipe, один байт = один post, дескрипторы через SCM_RIGHTS
+    TR_COUNT
+};
+
+inline constexpr const char *TRANSPORT_NAMES[TR_COUNT] = {"named", "unnamed", "futex", "eventfd", "pipe"};
+
+inline int transport_from_name(const std::string &s) {
+    for (int i = 0; i < TR_COUNT; ++i) {
+        if (s == TRANSPORT_NAMES[i]) return i;
+    }
+    return -1;
+}
+
+struct Transport {
+    virtual ~Transport() {}
+    virtual const char *name() const = 0;
+
+    // Сколько байт нужно в сегменте после слотов (для объектов внутри памяти)
+    virtual size_t area_size(int) const { return 0; }
+
+    // teacher
+    virtual bool create(SharedData *shm, void *area, int capacity) = 0;
+    virtual void destroy() = 0;
+    virtual bool open_slot(int) { return true; }   // перед post_grade/wait_ack
+    virtual void close_slot(int) {}
+    virtual void wake_slot(int slot) { post_grade(slot); }   // разбудить студента при завершении
+
+    // Разбудить всех ждущих оценку при завершении (shm->shutdown уже выставлен).
+    // По умолчанию — grade = -1 и post в каждый занятый слот; futex и fd-транспорты
+    // будят всех одной операцией
+    virtual void broadcast_shutdown(SharedData *shm) {
+        for (int i = 0; i < shm->capacity; ++i) {
+            int st = slot_state_of(shm->slots[i].word.load());
+            if (st == SLOT_WAITING || st == SLOT_PROCESSING) {
+                shm->slots[i].grade = -1;
+                wake_slot(i);
+            }
+        }
+    }
+
+    // student
+    virtual bool attach(SharedData *shm, void *area) = 0;
+    virtual bool register_slot(int) { return true; }   // слот RESERVED, до публикации WAITING
+    virtual void detach() = 0;
+
+    // общие операции; wait_* возвращают 1 — дождались, 0 — таймаут, -1 — прервано сигналом
+    virtual void lock() = 0;
+    virtual void unlock() = 0;
+    virtual void post_queue() = 0;
+    virtual int wait_queue() = 0;
+    virtual void post_grade(int slot) = 0;
+    virtual int wait_grade(int slot, int timeout_ms) = 0;
+    virtual void post_ack(int slot) = 0;
+    virtual int wait_ack(int slot, int timeout_ms = -1) = 0;
+    virtual bool try_ack(int slot) { return wait_ack(slot, 0) == 1; }   // без ожидания
+};
+
+inline timespec deadline_after(int ms) {
+    timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+inline int sem_wait_ms(sem_t *s, int timeout_ms) {
+    int r;
+    if (timeout_ms < 0) {
+        r = sem_wait(s);
+    } else {
+        timespec ts = deadline_after(timeout_ms);
+        r = sem_timedwait(s, &ts);
+    }
+    if (r == 0) return 1;
+    return errno == ETIMEDOUT ? 0 : -1;
+}
+
+// ---------- именованные семафоры ----------
+
+// Семафоры слотов создаёт teacher при запуске (/exam_grade_<slot>, /exam_ack_<slot>)
+// и держит открытыми; студент только открывает семафоры своего слота по имени из слота.
+struct NamedSemTransport final : Transport {
+    SharedData *shm = nullptr;
+    sem_t *mutex_sem = nullptr;
+    sem_t *queue_sem = nullptr;
+    // студент: семафоры своего слота; teacher: открытые для текущего слота
+    sem_t *my_grade = nullptr, *my_ack = nullptr;
+    int my_slot = -1;
+    int open_idx = -1;
+    sem_t *slot_grade = nullptr, *slot_ack = nullptr;
+    bool owner = false;
+    std::vector<sem_t *> grades, acks;   // teacher: все слоты
+
+    const char *name() const override { return "named"; }
+
+    static std::string slot_sem_name(const char *kind, int slot) {
+        return exam_name((std::string("/exam_") + kind + "_" + std::to_string(slot)).c_str());
+    }
+
+    static sem_t *open_sem(const char *name) {
+        sem_t *s = sem_open(name, 0);
+        return s == SEM_FAILED ? nullptr : s;
+    }
+
+    bool create(SharedData *s, void *, int cap) override {
+        shm = s;
+        owner = true;
+        sem_unlink(exam_name(MUTEX_NAME).c_str());
+        sem_unlink(exam_name(QUEUE_NAME).c_str());
+        mutex_sem = sem_open(exam_name(MUTEX_NAME).c_str(), O_CREAT, 0666, 1);
+        queue_sem = sem_open(exam_name(QUEUE_NAME).c_str(), O_CREAT, 0666, 0);
+        if (mutex_sem == SEM_FAILED || queue_sem == SEM_FAILED) {
+            if (mutex_sem == SEM_FAILED) mutex_sem = nullptr;
+            if (queue_sem == SEM_FAILED) queue_sem = nullptr;
+            return false;
+        }
+        grades.assign(cap, nullptr);
+        acks.assign(cap, nullptr);
+        for (int i = 0; i < cap; ++i) {
+            std::string gn = slot_sem_name("grade", i), an = slot_sem_name("ack", i);
+            sem_unlink(gn.c_str());
+            sem_unlink(an.c_str());
+            sem_t *g = sem_open(gn.c_str(), O_CREAT, 0666, 0);
+            sem_t *k = sem_open(an.c_str(), O_CREAT, 0666, 0);
+            if (g != SEM_FAILED) grades[i] = g;
+            if (k != SEM_FAILED) acks[i] = k;
+            if (!grades[i] || !acks[i]) return false;
+        }
+        return true;
+    }
+
+    // mutex студенту не нужен, он открывается при первом lock (только в bench)
+    bool attach(SharedData *s, void *) override {
+        shm = s;
+        queue_sem = open_sem(exam_name(QUEUE_NAME).c_str());
+        return queue_sem != nullptr;
+    }
+
+    // Семафоры слота могли остаться со значением от прошлого студента, который ушёл,
+    // не забрав оценку: слот сейчас RESERVED, teacher в них не пишет
+    bool register_slot(int slot) override {
+        if (my_slot != slot) {
+            if (my_grade) sem_close(my_grade);
+            if (my_ack) sem_close(my_ack);
+            my_grade = open_sem(slot_sem_name("grade", slot).c_str());
+            my_ack = open_sem(slot_sem_name("ack", slot).c_str());
+            my_slot = slot;
+            if (!my_grade || !my_ack) {
+                if (my_grade) sem_close(my_grade);
+                if (my_ack) sem_close(my_ack);
+                my_grade = my_ack = nullptr;
+                my_slot = -1;
+                return false;
+            }
+        }
+        while (sem_trywait(my_grade) == 0) {}
+        return true;
+    }
+
+    bool open_slot(int slot) override {
+        if (open_idx == slot) return true;
+        close_slot(open_idx);
+        if (owner) {
+            slot_grade = grades[slot];
+            slot_ack = acks[slot];
+        } else {
+            slot_grade = open_sem(slot_sem_name("grade", slot).c_str());
+            slot_ack = open_sem(slot_sem_name("ack", slot).c_str());
+            if (!slot_grade || !slot_ack) {
+                if (slot_grade) sem_close(slot_grade);
+                if (slot_ack) sem_close(slot_ack);
+                slot_grade = slot_ack = nullptr;
+                return false;
+            }
+        }
+        open_idx = slot;
+        return true;
+    }
+
+    void close_slot(int slot) override {
+        if (slot < 0 || slot != open_idx) return;
+        if (!owner) {
+            sem_close(slot_grade);
+            sem_close(slot_ack);
+        }
+        slot_grade = slot_ack = nullptr;
+        open_idx = -1;
+    }
+
+    void wake_slot(int slot) override {
+        if (owner) {
+            sem_post(grades[slot]);
+            return;
+        }
+        if (slot == open_idx) {
+            sem_post(slot_grade);
+            return;
+        }
+        sem_t *g = open_sem(slot_sem_name("grade", slot).c_str());
+        if (g) {
+            sem_post(g);
+            sem_close(g);
+        }
+    }
+
+    void lock() override {
+        if (!mutex_sem) mutex_sem = open_sem(exam_name(MUTEX_NAME).c_str());
+        while (sem_wait(mutex_sem) == -1 && errno == EINTR) {}
+    }
+    void unlock() override { sem_post(mutex_sem); }
+    void post_queue() override { sem_post(queue_sem); }
+    int wait_queue() override { return sem_wait_ms(queue_sem, -1); }
+
+    // teacher пишет в семафоры слота (у владельца открыты все, --overlap держит несколько
+    // слотов сразу), студент ждёт на своих. post_ack у teacher — отмена ожидания по таймауту
+    sem_t *grade_of(int slot) const { return owner ? grades[slot] : slot_grade ? slot_grade : my_grade; }
+    sem_t *ack_of(int slot) const { return owner ? acks[slot] : slot_ack ? slot_ack : my_ack; }
+    void post_grade(int slot) override { sem_post(grade_of(slot)); }
+    int wait_grade(int, int timeout_ms) override { return sem_wait_ms(my_grade, timeout_ms); }
+    void post_ack(int slot) override { sem_post(ack_of(slot)); }
+    int wait_ack(int slot, int timeout_ms = -1) override { return sem_wait_ms(ack_of(slot), timeout_ms); }
+
+    void detach() override {
+        if (my_grade) { sem_close(my_grade); my_grade = nullptr; }
+        if (my_ack)   { sem_close(my_ack);   my_ack = nullptr; }
+        my_slot = -1;
+        if (mutex_sem) { sem_close(mutex_sem); mutex_sem = nullptr; }
+        if (queue_sem) { sem_close(queue_sem); queue_sem = nullptr; }
+    }
+
+    void destroy() override {
+        close_slot(open_idx);
+        detach();
+        if (!owner) return;
+        sem_unlink(exam_name(MUTEX_NAME).c_str());
+        sem_unlink(exam_name(QUEUE_NAME).c_str());
+        for (size_t i = 0; i < grades.size(); ++i) {
+            if (grades[i]) sem_close(grades[i]);
+            if (acks[i]) sem_close(acks[i]);
+            sem_unlink(slot_sem_name("grade", (int)i).c_str());
+            sem_unlink(slot_sem_name("ack", (int)i).c_str());
+        }
+        grades.clear();
+        acks.clear();
+    }
+};
+
+// ---------- неименованные семафоры в сегменте ----------
+
+struct UnnamedSemTransport final : Transport {
+    sem_t *sems = nullptr;   // [mutex, queue, grade[capacity], ack[capacity]]
+    int capacity = 0;
+
+    const char *name() const override { return "unnamed"; }
+    size_t area_size(int cap) const override { return (2 + 2 * (size_t)cap) * sizeof(sem_t); }
+
+    sem_t *grade(int slot) { return &sems[2 + slot]; }
+    sem_t *ack(int slot) { return &sems[2 + capacity + slot]; }
+
+    bool create(SharedData *, void *area, int cap) override {
+        sems = (sem_t *)area;
+        capacity = cap;
+        if (sem_init(&sems[0], 1, 1) < 0 || sem_init(&sems[1], 1, 0) < 0) return false;
+        for (int i = 0; i < cap; ++i) {
+            if (sem_init(grade(i), 1, 0) < 0 || sem_init(ack(i), 1, 0) < 0) return false;
+        }
+        return true;
+    }
+
+    bool attach(SharedData *shm, void *area) override {
+        sems = (sem_t *)area;
+        capacity = shm->capacity;
+        return true;
+    }
+
+    // оценка, не забранная прошлым студентом слота
+    bool register_slot(int slot) override {
+        while (sem_trywait(grade(slot)) == 0) {}
+        return true;
+    }
+
+    void lock() override { while (sem_wait(&sems[0]) == -1 && errno == EINTR) {} }
+    void unlock() override { sem_post(&sems[0]); }
+    void post_queue() override { sem_post(&sems[1]); }
+    int wait_queue() override { return sem_wait_ms(&sems[1], -1); }
+    void post_grade(int slot) override { sem_post(grade(slot)); }
+    int wait_grade(int slot, int timeout_ms) override { return sem_wait_ms(grade(slot), timeout_ms); }
+    void post_ack(int slot) override { sem_post(ack(slot)); }
+    int wait_ack(int slot, int timeout_ms = -1) override { return sem_wait_ms(ack(slot), timeout_ms); }
+
+    void detach() override { sems = nullptr; }
+
+    void destroy() override {
+        if (!sems) return;
+        sem_destroy(&sems[0]);
+        sem_destroy(&sems[1]);
+        for (int i = 0; i < capacity; ++i) {
+            sem_destroy(grade(i));
+            sem_destroy(ack(i));
+        }
+        sems = nullptr;
+    }
+};
+
+// ---------- futex-слова в сегменте ----------
+
+inline long futex_call(uint32_t *addr, int op, uint32_t val, const timespec *ts) {
+    return syscall(SYS_futex, addr, op, val, ts, nullptr, 0);
+}
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Счётный семафор на futex: count — значение, waiters — сколько процессов спят в ядре.
+// post заходит в ядро только при спящих; count и waiters меняются с SEQ_CST, поэтому
+// post не пропустит ожидающего, который успел увеличить waiters.
+struct FSem {
+    uint32_t count;
+    uint32_t waiters;
+};
+
+inline bool fsem_try(FSem *s) {
+    uint32_t v = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+    while (v > 0) {
+        if (__atomic_compare_exchange_n(&s->count, &v, v - 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) return true;
+    }
+    return false;
+}
+
+inline void fsem_post(FSem *s) {
+    __atomic_fetch_add(&s->count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s->waiters, __ATOMIC_SEQ_CST) > 0) futex_call(&s->count, FUTEX_WAKE, 1, nullptr);
+}
+
+inline int fsem_wait(FSem *s, int timeout_ms) {
+    if (fsem_try(s)) return 1;
+    __atomic_fetch_add(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    int r = 1;
+    while (!fsem_try(s)) {
+        timespec ts{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+        if (futex_call(&s->count, FUTEX_WAIT, 0, timeout_ms < 0 ? nullptr : &ts) == -1) {
+            if (errno == ETIMEDOUT) { r = 0; break; }
+            if (errno == EINTR) { r = -1; break; }
+        }
+    }
+    __atomic_fetch_sub(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    return r;
+}
+
+inline int ms_until(const timespec &end) {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ms = (end.tv_sec - now.tv_sec) * 1000 + (end.tv_nsec - now.tv_nsec) / 1000000;
+    return ms > 0 ? (int)ms : 0;
+}
+
+// Как fsem_wait, но ждёт ещё и слово поколения: 0, как только *gen != seen.
+// futex_waitv (Linux 5.16) спит сразу на двух словах, поэтому одного FUTEX_WAKE по gen
+// хватает, чтобы разбудить всех. Без futex_waitv — ожидание на count отрезками по 100 мс.
+inline int fsem_wait_gen(FSem *s, int timeout_ms, uint32_t *gen, uint32_t seen) {
+    if (fsem_try(s)) return 1;
+    timespec end{};
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += timeout_ms / 1000;
+    end.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (end.tv_nsec >= 1000000000L) {
+        end.tv_sec++;
+        end.tv_nsec -= 1000000000L;
+    }
+    static bool no_waitv = false;
+    __atomic_fetch_add(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    int r = 1;
+    while (!fsem_try(s)) {
+        if (__atomic_load_n(gen, __ATOMIC_SEQ_CST) != seen) { r = 0; break; }
+        long rc;
+        if (!no_waitv) {
+            futex_waitv w[2] = {};
+            w[0].uaddr = (uintptr_t)&s->count;
+            w[0].flags = FUTEX_32;
+            w[1].val = seen;
+            w[1].uaddr = (uintptr_t)gen;
+            w[1].flags = FUTEX_32;
+            rc = syscall(SYS_futex_waitv, w, 2, 0, timeout_ms < 0 ? nullptr : &end, CLOCK_MONOTONIC);
+            if (rc == -1 && errno == ENOSYS) {
+                no_waitv = true;
+                continue;
+            }
+        } else {
+            int ms = timeout_ms < 0 ? 100 : std::min(100, ms_until(end));
+            timespec ts{0, ms * 1000000L};
+            rc = futex_call(&s->count, FUTEX_WAIT, 0, &ts);
+            if (rc == -1 && errno == ETIMEDOUT && (timeout_ms < 0 || ms_until(end) > 0)) continue;
+        }
+        if (rc == -1) {
+            if (errno == ETIMEDOUT) { r = 0; break; }
+            if (errno == EINTR) { r = -1; break; }
+        }
+    }
+    __atomic_fetch_sub(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    return r;
+}
+
+// Ожидание с предварительным опросом: до budget итераций pause, затем futex.
+// Адаптивный бюджет (как PTHREAD_MUTEX_ADAPTIVE_NP в glibc): среднее число итераций
+// до успешного опроса, бюджет = 2 * среднее + SPIN_MIN; после ухода в ядро бюджет
+// уменьшается вдвое, чтобы не тратить процессор, когда партнёр отвечает медленно.
+static const int SPIN_ADAPTIVE = -1;
+static const int SPIN_MIN = 16;
+static const int SPIN_MAX = 4000;
+
+struct SpinWait {
+    int mode = 0;           // 0 — сразу futex, > 0 — фиксированный бюджет, SPIN_ADAPTIVE
+    int budget = SPIN_MIN;
+    int avg = 0;
+    uint64_t spun = 0;      // дождались опросом
+    uint64_t blocked = 0;   // ушли в ядро
+
+    // gen != nullptr: вернуть 0 и при смене *gen (завершение экзамена)
+    int wait(FSem *s, int timeout_ms, uint32_t *gen = nullptr, uint32_t seen = 0) {
+        int limit = mode == SPIN_ADAPTIVE ? budget : mode;
+        for (int k = 0; k < limit; ++k) {
+            if (fsem_try(s)) {
+                spun++;
+                if (mode == SPIN_ADAPTIVE) {
+                    avg += (k - avg) / 8;
+                    budget = std::min(SPIN_MAX, 2 * avg + SPIN_MIN);
+                }
+                return 1;
+            }
+            cpu_relax();
+        }
+        blocked++;
+        if (mode == SPIN_ADAPTIVE) budget = std::max(SPIN_MIN, budget / 2);
+        return gen ? fsem_wait_gen(s, timeout_ms, gen, seen) : fsem_wait(s, timeout_ms);
+    }
+};
+
+struct FutexTransport final : Transport {
+    FSem *sems = nullptr;   // [mutex, queue, grade[capacity], ack[capacity]]
+    int capacity = 0;
+    // grade и ack ждут разные стороны, но бюджет у каждого канала свой
+    SpinWait grade_spin, ack_spin;
+    // студент: слово shm->shutdown_gen и его значение при подключении
+    uint32_t *gen = nullptr;
+    uint32_t gen_seen = 0;
+
+    const char *name() const override { return "futex"; }
+    size_t area_size(int cap) const override { return (2 + 2 * (size_t)cap) * sizeof(FSem); }
+
+    FSem *grade(int slot) { return &sems[2 + slot]; }
+    FSem *ack(int slot) { return &sems[2 + capacity + slot]; }
+
+    void set_spin(int mode) { grade_spin.mode = ack_spin.mode = mode; }
+
+    bool create(SharedData *shm, void *area, int cap) override {
+        sems = (FSem *)area;
+        capacity = cap;
+        memset(sems, 0, area_size(cap));
+        sems[0].count = 1;
+        set_spin(shm->spin);
+        return true;
+    }
+
+    bool attach(SharedData *shm, void *area) override {
+        sems = (FSem *)area;
+        capacity = shm->capacity;
+        set_spin(shm->spin);
+        gen = &shm->shutdown_gen;
+        gen_seen = __atomic_load_n(gen, __ATOMIC_SEQ_CST);
+        return true;
+    }
+
+    // одно слово поколения и один FUTEX_WAKE на всех ждущих
+    void broadcast_shutdown(SharedData *shm) override {
+        __atomic_fetch_add(&shm->shutdown_gen, 1, __ATOMIC_SEQ_CST);
+        futex_call(&shm->shutdown_gen, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+
+    bool register_slot(int slot) override {
+        while (fsem_try(grade(slot))) {}
+        return true;
+    }
+
+    void lock() override { while (fsem_wait(&sems[0], -1) != 1) {} }
+    void unlock() override { fsem_post(&sems[0]); }
+    void post_queue() override { fsem_post(&sems[1]); }
+    int wait_queue() override { return fsem_wait(&sems[1], -1); }
+    void post_grade(int slot) override { fsem_post(grade(slot)); }
+    int wait_grade(int slot, int timeout_ms) override {
+        return grade_spin.wait(grade(slot), timeout_ms, gen, gen_seen);
+    }
+    void post_ack(int slot) override { fsem_post(ack(slot)); }
+    int wait_ack(int slot, int timeout_ms = -1) override { return ack_spin.wait(ack(slot), timeout_ms); }
+    bool try_ack(int slot) override { return fsem_try(ack(slot)); }   // мимо бюджета опроса
+
+    void detach() override { sems = nullptr; gen = nullptr; }
+    void destroy() override { sems = nullptr; }
+};
+
+// ---------- передача дескрипторов (eventfd, pipe) ----------
+
+inline bool send_fds(int sock, const std::vector<int> &fds) {
+    char byte = 0;
+    iovec iov{&byte, 1};
+    std::vector<char> ctrl(CMSG_SPACE(fds.size() * sizeof(int)));
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.data();
+    msg.msg_controllen = ctrl.size();
+    cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+    memcpy(CMSG_DATA(c), fds.data(), fds.size() * sizeof(int));
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+inline bool recv_fds(int sock, std::vector<int> &fds, size_t n) {
+    char byte;
+    iovec iov{&byte, 1};
+    std::vector<char> ctrl(CMSG_SPACE(n * sizeof(int)));
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.data();
+    msg.msg_controllen = ctrl.size();
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1) return false;
+    cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    if (!c || c->cmsg_type != SCM_RIGHTS || c->cmsg_len != CMSG_LEN(n * sizeof(int))) return false;
+    fds.resize(n);
+    memcpy(fds.data(), CMSG_DATA(c), n * sizeof(int));
+    return true;
+}
+
+inline void raise_nofile(size_t need) {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < need + 64) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+// Каналы на дескрипторах. Канал — пара (чтение, запись); для eventfd это один fd дважды.
+// Teacher создаёт все каналы и раздаёт их по Unix-сокету FD_SOCK_NAME:
+// запрос k — queue, grade[k], ack[k] и канал завершения (студенту хватает одного подключения),
+// запрос -1 — mutex и queue (lock берёт только bench).
+// Канал завершения общий: teacher пишет в него один раз, студенты его только опрашивают
+// вместе с grade и не вычитывают, поэтому он остаётся готовым для всех.
+struct FdTransport final : Transport {
+    static const int FD_SERVE_TIMEOUT_MS = 200;
+
+    bool use_pipe;
+    int capacity = 0;
+    std::vector<int> rd, wr;   // [mutex, queue, grade[capacity], ack[capacity], shutdown]
+    int listen_fd = -1;
+    std::thread server;
+    std::atomic<bool> stop{false};
+    bool owner = false;
+
+    explicit FdTransport(bool pipe_mode) : use_pipe(pipe_mode) {}
+
+    const char *name() const override { return use_pipe ? "pipe" : "eventfd"; }
+
+    int chan_grade(int slot) const { return 2 + slot; }
+    int chan_ack(int slot) const { return 2 + capacity + slot; }
+    int chan_shutdown() const { return 2 + 2 * capacity; }
+    size_t channel_count() const { return 3 + 2 * (size_t)capacity; }
+
+    bool make_channel(int i, int initial) {
+        if (use_pipe) {
+            int p[2];
+            if (pipe2(p, O_NONBLOCK | O_CLOEXEC) < 0) return false;
+            rd[i] = p[0];
+            wr[i] = p[1];
+            for (int k = 0; k < initial; ++k) write(p[1], "x", 1);
+        } else {
+            int fd = eventfd(initial, EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+            if (fd < 0) return false;
+            rd[i] = wr[i] = fd;
+        }
+        return true;
+    }
+
+    bool create(SharedData *, void *, int cap) override {
+        owner = true;
+        capacity = cap;
+        size_t n = channel_count();
+        raise_nofile(n * (use_pipe ? 2 : 1));
+        rd.assign(n, -1);
+        wr.assign(n, -1);
+        for (size_t i = 0; i < n; ++i) {
+            if (!make_channel((int)i, i == 0 ? 1 : 0)) return false;
+        }
+
+        unlink(exam_name(FD_SOCK_NAME).c_str());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, exam_name(FD_SOCK_NAME).c_str(), sizeof(addr.sun_path) - 1);
+        if (listen_fd < 0 || bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+            return false;
+        }
+        server = std::thread([this] { serve(); });
+        return true;
+    }
+
+    std::vector<int> channels_for(int32_t req) const {
+        if (req < 0) return {0, 1};
+        return {1, chan_grade(req), chan_ack(req), chan_shutdown()};
+    }
+
+    std::vector<int> channel_fds(int i) const {
+        if (use_pipe) return {rd[i], wr[i]};
+        return {rd[i]};
+    }
+
+    void serve() {
+        while (!stop) {
+            pollfd pfd{listen_fd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0) continue;
+            int c = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (c < 0) continue;
+            // клиент, подключившийся и молчащий, не должен задерживать раздачу остальным
+            timeval tv{0, FD_SERVE_TIMEOUT_MS * 1000};
+            setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            int32_t req;
+            if (recv(c, &req, sizeof(req), MSG_WAITALL) == sizeof(req)) {
+                std::vector<int> fds;
+                if (req < capacity) {
+                    for (int ch : channels_for(req)) {
+                        for (int fd : channel_fds(ch)) fds.push_back(fd);
+                    }
+                    send_fds(c, fds);
+                }
+            }
+            close(c);
+        }
+    }
+
+    // Уже полученный канал (queue при втором слоте) не заменяется: лишние fd закрываются
+    bool request(int32_t req) {
+        int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, exam_name(FD_SOCK_NAME).c_str(), sizeof(addr.sun_path) - 1);
+        if (s < 0 || connect(s, (sockaddr *)&addr, sizeof(addr)) < 0) {
+            if (s >= 0) close(s);
+            return false;
+        }
+        std::vector<int> fds, chans = channels_for(req);
+        size_t per = use_pipe ? 2 : 1;
+        bool ok = send(s, &req, sizeof(req), MSG_NOSIGNAL) == sizeof(req) && recv_fds(s, fds, chans.size() * per);
+        close(s);
+        if (!ok) return false;
+        for (size_t j = 0; j < chans.size(); ++j) {
+            int ch = chans[j], r = fds[j * per], w = fds[j * per + per - 1];
+            if (rd[ch] >= 0) {
+                close(r);
+                if (w != r) close(w);
+                continue;
+            }
+            rd[ch] = r;
+            wr[ch] = w;
+        }
+        return true;
+    }
+
+    // подключение к teacher откладывается до регистрации в слоте
+    bool attach(SharedData *shm, void *) override {
+        capacity = shm->capacity;
+        rd.assign(channel_count(), -1);
+        wr.assign(rd.size(), -1);
+        return true;
+    }
+
+    bool fetch_slot(int slot) {
+        return rd[chan_grade(slot)] >= 0 || request(slot);
+    }
+
+    // сбросить оценку, не забранную прошлым студентом слота (каналы неблокирующие)
+    bool register_slot(int slot) override {
+        if (!fetch_slot(slot)) return false;
+        while (wait(chan_grade(slot), 0) == 1) {}
+        return true;
+    }
+
+    // дополнительный экземпляр teacher (поток комнаты) получает каналы слота так же, как студент
+    bool open_slot(int slot) override { return fetch_slot(slot); }
+
+    void post(int i) {
+        if (use_pipe) {
+            while (write(wr[i], "x", 1) == -1 && errno == EINTR) {}
+        } else {
+            uint64_t one = 1;
+            while (write(wr[i], &one, sizeof(one)) == -1 && errno == EINTR) {}
+        }
+    }
+
+    // stop >= 0: вернуть 0, когда готов канал stop (он не вычитывается)
+    int wait(int i, int timeout_ms, int stop = -1) {
+        while (true) {
+            if (use_pipe) {
+                char b;
+                if (read(rd[i], &b, 1) == 1) return 1;
+            } else {
+                uint64_t v;
+                if (read(rd[i], &v, sizeof(v)) == sizeof(v)) return 1;
+            }
+            if (errno != EAGAIN && errno != EINTR) return -1;
+            pollfd pfd[2] = {{rd[i], POLLIN, 0}, {stop >= 0 ? rd[stop] : -1, POLLIN, 0}};
+            int r = poll(pfd, 2, timeout_ms);
+            if (r == 0) return 0;
+            if (r < 0) return -1;
+            if (pfd[1].revents && !pfd[0].revents) return 0;
+        }
+    }
+
+    void lock() override {
+        if (rd[0] < 0) request(-1);
+        while (wait(0, -1) != 1) {}
+    }
+    void unlock() override { post(0); }
+    void post_queue() override { post(1); }
+    int wait_queue() override { return wait(1, -1); }
+    void post_grade(int slot) override { post(chan_grade(slot)); }
+    int wait_grade(int slot, int timeout_ms) override { return wait(chan_grade(slot), timeout_ms, chan_shutdown()); }
+    void post_ack(int slot) override { post(chan_ack(slot)); }
+    int wait_ack(int slot, int timeout_ms = -1) override { return wait(chan_ack(slot), timeout_ms); }
+
+    void broadcast_shutdown(SharedData *) override { post(chan_shutdown()); }
+
+    void close_fds() {
+        for (size_t i = 0; i < rd.size(); ++i) {
+            if (rd[i] >= 0) close(rd[i]);
+            if (wr[i] >= 0 && wr[i] != rd[i]) close(wr[i]);
+            rd[i] = wr[i] = -1;
+        }
+    }
+
+    void detach() override { close_fds(); }
+
+    void destroy() override {
+        stop = true;
+        if (server.joinable()) server.join();
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            listen_fd = -1;
+            if (owner) unlink(exam_name(FD_SOCK_NAME).c_str());
+        }
+        close_fds();
+    }
+};
+
+inline Transport *make_transport(int kind) {
+    switch (kind) {
+        case TR_NAMED_SEM:   return new NamedSemTransport();
+        case TR_UNNAMED_SEM: return new UnnamedSemTransport();
+        case TR_FUTEX:       return new FutexTransport();
+        case TR_EVENTFD:     return new FdTransport(false);
+        case TR_PIPE:        return new FdTransport(true);
+        default:             return nullptr;
+    }
+}
+
+#endif // TRANSPORT_H